@@ -0,0 +1,31 @@
+// Allocates lots of short-lived objects while keeping a large old generation, and writes young
+// objects into old ones.
+var big = [];
+for (var i = 0; i < 20000; i++) {
+  big.push({ id: i, name: "item" + i });
+}
+var table = {};
+var makeCounter = function (start) {
+  var c = start;
+  return function () { c = c + 1; return c; };
+};
+var counters = [];
+var check = 0;
+for (var round = 0; round < 10; round++) {
+  var tmp = [];
+  for (var j = 0; j < 20000; j++) {
+    tmp.push({ a: j, b: "s" + j, c: [j, j + 1] });
+  }
+  for (var k = 0; k < 50; k++) {
+    var idx = (round * 397 + k * 131) % big.length;
+    big[idx] = { id: idx, name: "item" + idx, round: round };
+  }
+  table["key" + round] = { round: round, data: tmp[round] };
+  counters.push(makeCounter(round));
+}
+for (var r = 0; r < 10; r++) {
+  var e = table["key" + r];
+  if (e.round !== r || e.data.a !== r || e.data.c[1] !== r + 1) { console.log("table mismatch", r); }
+  check += counters[r]();
+}
+console.log("done", check, big[0].id, big[big.length - 1].name);
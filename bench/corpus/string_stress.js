@@ -0,0 +1,30 @@
+// Concatenation, slicing, searching and splitting of strings.
+var parts = [];
+for (var i = 0; i < 20000; i++) {
+  parts.push("token" + i);
+}
+var text = parts.join(" ");
+
+var s = "";
+for (var i = 0; i < 3000; i++) {
+  s = s + "abcdefghij" + i;
+}
+
+var found = 0;
+for (var i = 0; i < 2000; i++) {
+  var pos = text.indexOf("token" + (i * 7), i);
+  if (pos >= 0) found += 1;
+  var sub = text.substring(i * 10, i * 10 + 50);
+  if (sub.charCodeAt(0) > 0) found += 1;
+}
+
+var words = text.split(" ");
+var upper = 0;
+for (var i = 0; i < words.length; i += 10) {
+  upper += words[i].toUpperCase().length;
+}
+
+var doubled = "x";
+for (var j = 0; j < 16; j++) doubled = doubled + doubled;
+
+console.log("done", text.length, s.length, found, words.length, upper, doubled.length);
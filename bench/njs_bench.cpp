@@ -0,0 +1,435 @@
+// Runs a corpus of JavaScript programs in-process and reports the time of each phase.
+//
+// Usage: njs_bench [options] [name...]
+//   -n <runs>      measured runs of each program (default 10)
+//   -k <runs>      warmup runs, not measured (default 2)
+//   -w <count>     GC thread count (same as njsmain)
+//   -o             enable the bytecode optimizer (same as njsmain)
+//   -d <dir>       root directory of the repository (default: the source directory)
+//   -s <file>      save the results as JSON
+//   -b <file>      compare with the results saved by -s
+//   -t <percent>   regression threshold for -b (default 5)
+//   name...        only run the programs whose name contains one of these
+//
+// Each run parses, generates and executes the program in a new VM, with the output of the
+// program going to /dev/null. The median, p95, minimum and median absolute deviation (MAD) of
+// each phase are reported. With -b, a program regresses if the median of its total time is more
+// than `threshold` percent slower than the baseline, and the difference is also larger than
+// twice the MAD of both, so that a noisy program is not reported. The exit code is 1 if any
+// program regresses.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <codecvt>
+#include <cstdio>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <locale>
+#include <map>
+#include <string>
+#include <unistd.h>
+#include <vector>
+#include <sys/resource.h>
+
+#include "njs/global_var.h"
+#include "njs/parser/Parser.h"
+#include "njs/codegen/CodegenVisitor.h"
+#include "njs/vm/NjsVM.h"
+
+#ifndef NJS_SOURCE_DIR
+#define NJS_SOURCE_DIR "."
+#endif
+
+using namespace njs;
+using std::string;
+using std::u16string;
+using std::vector;
+
+namespace {
+
+struct Program {
+  const char *name;
+  const char *path;
+};
+
+// The programs whose file is missing are skipped. jquery throws at once because there is no
+// `window`, so it mostly measures the compiler.
+const Program corpus[] = {
+  {"typescript",    "test_files/test_typescript.js"},
+  {"typescript2",   "test_files/test_typescript_2.0.10.js"},
+  {"jquery",        "test_files/jquery-1.4.2.js"},
+  {"quicksort",     "test_files/test_quicksort.js"},
+  {"fibonacci",     "test_files/test_fibonacci.js"},
+  {"hashtable",     "test_files/test_hashtable.js"},
+  {"deep_object",   "test_files/test_deep_object.js"},
+  {"closure",       "test_files/test_closure.js"},
+  {"promise",       "test_files/test_promise.js"},
+  {"gc_stress",     "bench/corpus/gc_stress.js"},
+  {"string_stress", "bench/corpus/string_stress.js"},
+};
+
+enum Phase {
+  PARSE,
+  CODEGEN,
+  SETUP,
+  EXEC,
+  GC,
+  TOTAL,
+  PHASE_COUNT,
+};
+
+const char *phase_names[PHASE_COUNT] = {"parse", "codegen", "setup", "exec", "gc", "total"};
+
+struct Summary {
+  double median {0};
+  double p95 {0};
+  double min {0};
+  double mad {0};
+};
+
+struct Result {
+  string name;
+  bool ok {true};
+  // time of each run in microseconds
+  vector<double> samples[PHASE_COUNT];
+  Summary summary[PHASE_COUNT];
+};
+
+struct Options {
+  int runs {10};
+  int warmup {2};
+  string root {NJS_SOURCE_DIR};
+  string save_path;
+  string baseline_path;
+  double threshold {5};
+  vector<string> filters;
+};
+
+double median_of(vector<double> values) {
+  if (values.empty()) return 0;
+  std::sort(values.begin(), values.end());
+  size_t n = values.size();
+  return n % 2 == 1 ? values[n / 2] : (values[n / 2 - 1] + values[n / 2]) / 2;
+}
+
+Summary summarize(const vector<double>& samples) {
+  Summary s;
+  if (samples.empty()) return s;
+  vector<double> sorted = samples;
+  std::sort(sorted.begin(), sorted.end());
+  s.median = median_of(sorted);
+  s.min = sorted.front();
+  // nearest rank
+  size_t rank = (size_t)std::ceil(0.95 * sorted.size());
+  s.p95 = sorted[std::max<size_t>(rank, 1) - 1];
+
+  vector<double> deviations;
+  for (double v : sorted) deviations.push_back(std::abs(v - s.median));
+  s.mad = median_of(std::move(deviations));
+  return s;
+}
+
+u16string read_file(const string& path) {
+  std::ifstream file(path);
+  if (!file.is_open()) { throw std::ifstream::failure("Cannot open the file: " + path); }
+
+  string content(std::istreambuf_iterator<char>{file}, std::istreambuf_iterator<char>{});
+  return std::wstring_convert<std::codecvt_utf8_utf16<char16_t>, char16_t>().from_bytes(content);
+}
+
+void set_stack_size(size_t size_mb) {
+  const rlim_t stack_size = size_mb * 1024 * 1024;
+  struct rlimit rl;
+  if (getrlimit(RLIMIT_STACK, &rl) == 0 && rl.rlim_cur < stack_size) {
+    rl.rlim_cur = stack_size;
+    if (setrlimit(RLIMIT_STACK, &rl) != 0) {
+      fprintf(stderr, "setrlimit return error\n");
+    }
+  }
+}
+
+// Sends the output of the program to /dev/null during its lifetime.
+class SilenceStdout {
+ public:
+  SilenceStdout() {
+    fflush(stdout);
+    std::cout.flush();
+    saved_fd = dup(STDOUT_FILENO);
+    int null_fd = open("/dev/null", O_WRONLY);
+    dup2(null_fd, STDOUT_FILENO);
+    close(null_fd);
+  }
+
+  ~SilenceStdout() {
+    fflush(stdout);
+    std::cout.flush();
+    dup2(saved_fd, STDOUT_FILENO);
+    close(saved_fd);
+  }
+
+ private:
+  int saved_fd;
+};
+
+double elapsed_us(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Run the program once. Return false if it can not be compiled.
+bool run_once(const u16string& source, double times[PHASE_COUNT]) {
+  using clock = std::chrono::steady_clock;
+  SilenceStdout silence;
+  auto run_start = clock::now();
+
+  auto start = clock::now();
+  Parser parser(source);
+  ASTNode *ast = parser.parse_program();
+  times[PARSE] = elapsed_us(start);
+  if (parser.get_errors().size() > 0 || ast->is_illegal()) {
+    delete ast;
+    return false;
+  }
+
+  start = clock::now();
+  CodegenVisitor visitor;
+  visitor.codegen(static_cast<ProgramOrFunctionBody *>(ast));
+  times[CODEGEN] = elapsed_us(start);
+  if (visitor.get_errors().size() > 0) {
+    delete ast;
+    return false;
+  }
+
+  {
+    start = clock::now();
+    NjsVM vm(visitor);
+    vm.setup();
+    times[SETUP] = elapsed_us(start);
+
+    start = clock::now();
+    vm.run();
+    times[EXEC] = elapsed_us(start);
+    times[GC] = vm.heap.stats.total_time;
+  }
+  delete ast;
+  times[TOTAL] = elapsed_us(run_start);
+  return true;
+}
+
+Result run_program(const Program& program, const Options& options) {
+  Result result;
+  result.name = program.name;
+  u16string source = read_file(options.root + '/' + program.path);
+
+  for (int i = 0; i < options.warmup + options.runs; i++) {
+    double times[PHASE_COUNT] {};
+    if (not run_once(source, times)) {
+      result.ok = false;
+      return result;
+    }
+    if (i < options.warmup) continue;
+    for (int p = 0; p < PHASE_COUNT; p++) {
+      result.samples[p].push_back(times[p]);
+    }
+  }
+
+  for (int p = 0; p < PHASE_COUNT; p++) {
+    result.summary[p] = summarize(result.samples[p]);
+  }
+  return result;
+}
+
+void print_results(const vector<Result>& results) {
+  printf("%-14s %-8s %10s %10s %10s %10s\n", "program", "phase", "median ms", "p95 ms", "min ms",
+         "MAD ms");
+  for (auto& result : results) {
+    if (not result.ok) {
+      printf("%-14s failed to compile\n", result.name.c_str());
+      continue;
+    }
+    for (int p = 0; p < PHASE_COUNT; p++) {
+      const Summary& s = result.summary[p];
+      printf("%-14s %-8s %10.3f %10.3f %10.3f %10.3f\n", p == 0 ? result.name.c_str() : "",
+             phase_names[p], s.median / 1000, s.p95 / 1000, s.min / 1000, s.mad / 1000);
+    }
+  }
+}
+
+// One program on each line, so that the baseline can be read back without a JSON library.
+bool save_results(const vector<Result>& results, const Options& options, const string& path) {
+  std::ofstream out(path);
+  if (not out.is_open()) return false;
+
+  out << "{\"runs\":" << options.runs << ",\"warmup\":" << options.warmup
+      << ",\"optimization\":" << (Global::enable_optimization ? "true" : "false")
+      << ",\"gc_threads\":" << Global::gc_thread_count << ",\"programs\":[\n";
+  bool first = true;
+  for (auto& result : results) {
+    if (not result.ok) continue;
+    if (not first) out << ",\n";
+    first = false;
+    out << "{\"name\":\"" << result.name << "\",\"phases\":{";
+    for (int p = 0; p < PHASE_COUNT; p++) {
+      const Summary& s = result.summary[p];
+      if (p != 0) out << ',';
+      out << '"' << phase_names[p] << "\":{\"median\":" << s.median << ",\"p95\":" << s.p95
+          << ",\"min\":" << s.min << ",\"mad\":" << s.mad << ",\"samples\":[";
+      for (size_t i = 0; i < result.samples[p].size(); i++) {
+        if (i != 0) out << ',';
+        out << result.samples[p][i];
+      }
+      out << "]}";
+    }
+    out << "}}";
+  }
+  out << "\n]}\n";
+  return out.good();
+}
+
+// Read the total time of each program from a file written by `save_results`.
+std::map<string, Summary> load_baseline(const string& path) {
+  std::ifstream file(path);
+  if (!file.is_open()) { throw std::ifstream::failure("Cannot open the file: " + path); }
+
+  auto number_after = [] (const string& line, size_t from, const string& key) {
+    size_t pos = line.find("\"" + key + "\":", from);
+    if (pos == string::npos) return 0.0;
+    return std::strtod(line.c_str() + pos + key.size() + 3, nullptr);
+  };
+
+  std::map<string, Summary> baseline;
+  string line;
+  while (std::getline(file, line)) {
+    size_t name_pos = line.find("{\"name\":\"");
+    if (name_pos == string::npos) continue;
+    size_t name_start = name_pos + 9;
+    string name = line.substr(name_start, line.find('"', name_start) - name_start);
+
+    size_t total_pos = line.find("\"total\":");
+    if (total_pos == string::npos) continue;
+    Summary& s = baseline[name];
+    s.median = number_after(line, total_pos, "median");
+    s.p95 = number_after(line, total_pos, "p95");
+    s.min = number_after(line, total_pos, "min");
+    s.mad = number_after(line, total_pos, "mad");
+  }
+  return baseline;
+}
+
+// Return the number of regressions.
+int compare_with_baseline(const vector<Result>& results, const std::map<string, Summary>& baseline,
+                          double threshold) {
+  printf("\nCompared with the baseline (threshold %.1f%%)\n", threshold);
+  printf("%-14s %12s %12s %9s  %s\n", "program", "base ms", "now ms", "change", "");
+  int regression_cnt = 0;
+  for (auto& result : results) {
+    auto iter = baseline.find(result.name);
+    if (not result.ok || iter == baseline.end() || iter->second.median == 0) continue;
+
+    const Summary& base = iter->second;
+    const Summary& now = result.summary[TOTAL];
+    double change = (now.median - base.median) / base.median * 100;
+    double noise = 2 * std::max(base.mad, now.mad);
+
+    const char *verdict = "";
+    if (change > threshold && now.median - base.median > noise) {
+      verdict = "REGRESSION";
+      regression_cnt += 1;
+    } else if (change < -threshold && base.median - now.median > noise) {
+      verdict = "improvement";
+    }
+    printf("%-14s %12.3f %12.3f %+8.1f%%  %s\n", result.name.c_str(), base.median / 1000,
+           now.median / 1000, change, verdict);
+  }
+  return regression_cnt;
+}
+
+void read_options(int argc, char *argv[], Options& options) {
+  int option;
+  while ((option = getopt(argc, argv, "ow:n:k:d:s:b:t:")) != -1) {
+    switch (option) {
+      case 'o':
+        Global::enable_optimization = true;
+        break;
+      case 'w':
+        Global::gc_thread_count = atoi(optarg);
+        break;
+      case 'n':
+        options.runs = std::max(atoi(optarg), 1);
+        break;
+      case 'k':
+        options.warmup = std::max(atoi(optarg), 0);
+        break;
+      case 'd':
+        options.root = optarg;
+        break;
+      case 's':
+        options.save_path = optarg;
+        break;
+      case 'b':
+        options.baseline_path = optarg;
+        break;
+      case 't':
+        options.threshold = atof(optarg);
+        break;
+      case '?':
+        std::cerr << "Unknown option: " << static_cast<char>(optopt) << '\n';
+        break;
+      default:
+        break;
+    }
+  }
+  for (int i = optind; i < argc; i++) {
+    options.filters.emplace_back(argv[i]);
+  }
+}
+
+bool selected(const Program& program, const Options& options) {
+  if (options.filters.empty()) return true;
+  return std::any_of(options.filters.begin(), options.filters.end(), [&] (const string& filter) {
+    return string(program.name).find(filter) != string::npos;
+  });
+}
+
+}
+
+int main(int argc, char *argv[]) {
+  set_stack_size(48);
+  Options options;
+  read_options(argc, argv, options);
+
+  try {
+    std::map<string, Summary> baseline;
+    if (not options.baseline_path.empty()) {
+      baseline = load_baseline(options.baseline_path);
+    }
+
+    vector<Result> results;
+    for (const Program& program : corpus) {
+      if (not selected(program, options)) continue;
+      if (access((options.root + '/' + program.path).c_str(), R_OK) != 0) {
+        fprintf(stderr, "skipping %s: %s not found\n", program.name, program.path);
+        continue;
+      }
+      fprintf(stderr, "running %s\n", program.name);
+      results.push_back(run_program(program, options));
+    }
+    print_results(results);
+
+    if (not options.save_path.empty() && not save_results(results, options, options.save_path)) {
+      fprintf(stderr, "Cannot write the results to %s\n", options.save_path.c_str());
+      return EXIT_FAILURE;
+    }
+    if (not options.baseline_path.empty()
+        && compare_with_baseline(results, baseline, options.threshold) > 0) {
+      return EXIT_FAILURE;
+    }
+  }
+  catch (const std::ifstream::failure &e) {
+    fprintf(stderr, "%s\n", e.what());
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
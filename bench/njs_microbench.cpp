@@ -0,0 +1,484 @@
+// Measures the primitives of the engine, one operation at a time.
+//
+// Usage: njs_microbench [-r <repeats>] [-m <min ms>] [name...]
+//   -r <repeats>   measured repeats of each case, the median is reported (default 5)
+//   -m <min ms>    minimum time of one repeat, the iteration count is doubled until it is
+//                  reached (default 20)
+//   name...        only run the cases whose name contains one of these
+//
+// The output has one line for each case, in a fixed order: the name of the case, then the time
+// of one operation in nanoseconds. So the output of two builds can be compared with `diff` or
+// `paste`. The time of the setup of a case (building the live set of a GC, creating the strings
+// to atomize) is not counted.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include "njs/global_var.h"
+#include "njs/common/Defer.h"
+#include "njs/parser/Parser.h"
+#include "njs/codegen/CodegenVisitor.h"
+#include "njs/vm/NjsVM.h"
+#include "njs/vm/JSONParser.h"
+#include "njs/basic_types/JSArray.h"
+#include "njs/basic_types/JSObject.h"
+#include "njs/basic_types/PrimitiveString.h"
+#include "njs/common/conversion_helper.h"
+
+using namespace njs;
+using std::string;
+using std::u16string;
+using std::vector;
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+// The functions that the prelude passes to `$export`.
+enum Exported {
+  JS_IDENTITY,
+  NATIVE_FLOOR,
+  EXPORTED_COUNT,
+};
+
+JSValue exported[EXPORTED_COUNT];
+
+const char16_t *prelude = uR"(
+  $export(function (x) { return x; }, Math.floor);
+)";
+
+// Keeps the results alive, so that the compiler does not remove the measured code.
+volatile uint64_t sink;
+
+// Adds up the time between `start` and `stop`.
+class Stopwatch {
+ public:
+  void start() { start_time = clock_type::now(); }
+  void stop() { elapsed += clock_type::now() - start_time; }
+  double ns() const { return std::chrono::duration<double, std::nano>(elapsed).count(); }
+
+ private:
+  clock_type::time_point start_time;
+  clock_type::duration elapsed {0};
+};
+
+// A case runs `iters` operations and returns the time they take in nanoseconds.
+struct Case {
+  string name;
+  std::function<double(uint64_t iters)> run;
+};
+
+struct Options {
+  int repeats {5};
+  double min_ms {20};
+  vector<string> filters;
+};
+
+class MicroBench {
+ public:
+  explicit MicroBench(NjsVM& vm): vm(vm), heap(vm.heap) {}
+
+  void add_cases(vector<Case>& cases);
+
+ private:
+  // A slot that is a GC root. It must always hold a GC object.
+  JSValue& root(JSValue val) {
+    roots.push_back(val);
+    vm.push_temp_root(roots.back());
+    return roots.back();
+  }
+
+  JSObject* new_chain(int depth, u32 key_atom);
+
+  NjsVM& vm;
+  GCHeap& heap;
+  // a deque does not move its elements when it grows
+  std::deque<JSValue> roots;
+  uint64_t miss_counter {0};
+};
+
+JSObject* MicroBench::new_chain(int depth, u32 key_atom) {
+  JSObject *obj = vm.new_object();
+  obj->add_prop_trivial(vm, key_atom, JSValue(1.0));
+  for (int i = 0; i < depth; i++) {
+    obj = vm.new_object(CLS_OBJECT, JSValue(obj));
+  }
+  return obj;
+}
+
+void MicroBench::add_cases(vector<Case>& cases) {
+  // allocation of small objects that die at once, including the minor GCs
+  cases.push_back({"gc.new_object", [this] (uint64_t iters) {
+    Stopwatch sw;
+    sw.start();
+    for (uint64_t i = 0; i < iters; i++) {
+      JSObject *obj = vm.new_object();
+      sink = (uintptr_t)obj;
+      heap.gc_if_needed();
+    }
+    sw.stop();
+    return sw.ns();
+  }});
+
+  // pause of a minor GC with `live` young objects reachable from a root
+  for (u32 live : {0u, 1000u, 10000u, 100000u}) {
+    JSValue& live_set = root(JSValue(heap.new_object<JSArray>(vm, 0)));
+    string name = "gc.minor_gc/live=" + std::to_string(live);
+    cases.push_back({name, [this, live, &live_set] (uint64_t iters) {
+      Stopwatch sw;
+      for (uint64_t i = 0; i < iters; i++) {
+        // start with an empty nursery
+        heap.gc();
+        auto *arr = heap.new_object<JSArray>(vm, live);
+        for (u32 j = 0; j < live; j++) {
+          arr->set_element_fast(vm, j, JSValue(vm.new_object()));
+        }
+        live_set.set_val(arr);
+
+        sw.start();
+        heap.gc();
+        sw.stop();
+      }
+      live_set.set_val(heap.new_object<JSArray>(vm, 0));
+      return sw.ns();
+    }});
+  }
+
+  cases.push_back({"atom.atomize/hit", [this] (uint64_t iters) {
+    vector<u16string> strs;
+    for (int i = 0; i < 1024; i++) {
+      strs.push_back(u"hit_" + to_u16string(i));
+      vm.str_to_atom(strs.back());
+    }
+    Stopwatch sw;
+    sw.start();
+    for (uint64_t i = 0; i < iters; i++) {
+      sink = vm.str_to_atom(strs[i & 1023]);
+    }
+    sw.stop();
+    return sw.ns();
+  }});
+
+  cases.push_back({"atom.atomize/miss", [this] (uint64_t iters) {
+    vector<u16string> strs;
+    strs.reserve(iters);
+    for (uint64_t i = 0; i < iters; i++) {
+      strs.push_back(u"miss_" + to_u16string((u32)miss_counter++));
+    }
+    Stopwatch sw;
+    sw.start();
+    for (auto& str : strs) {
+      sink = vm.str_to_atom(str);
+    }
+    sw.stop();
+    return sw.ns();
+  }});
+
+  // a property that is found `depth` objects up the prototype chain
+  u32 key_atom = vm.str_to_atom(u"key");
+  for (int depth : {0, 1, 4, 16}) {
+    JSValue& leaf = root(JSValue(new_chain(depth, key_atom)));
+    string name = "object.get_prop/depth=" + std::to_string(depth);
+    cases.push_back({name, [this, key_atom, &leaf] (uint64_t iters) {
+      Stopwatch sw;
+      sw.start();
+      for (uint64_t i = 0; i < iters; i++) {
+        Completion res = leaf.as_object->get_prop(vm, key_atom);
+        sink = res.get_value().tag;
+      }
+      sw.stop();
+      return sw.ns();
+    }});
+  }
+
+  // `obj[key]` where `key` is a string made at run time, like the keys of a hash table.
+  u16string long_key = u"a_property_name_of_some_length_0";
+  JSValue& str_key_obj = root(JSValue(new_chain(0, vm.str_to_atom(long_key))));
+  JSValue& str_key = root(vm.new_primitive_string(long_key));
+  cases.push_back({"object.get_prop/string_key", [this, &str_key_obj, &str_key] (uint64_t iters) {
+    Stopwatch sw;
+    sw.start();
+    for (uint64_t i = 0; i < iters; i++) {
+      Completion res = str_key_obj.as_object->get_property(vm, str_key);
+      sink = res.get_value().tag;
+    }
+    sw.stop();
+    return sw.ns();
+  }});
+
+  JSValue& own_obj = root(JSValue(new_chain(0, key_atom)));
+  cases.push_back({"object.set_prop/own", [this, key_atom, &own_obj] (uint64_t iters) {
+    Stopwatch sw;
+    sw.start();
+    for (uint64_t i = 0; i < iters; i++) {
+      sink = own_obj.as_object->set_prop(vm, JSAtom(key_atom), JSValue(double(i))).get_value();
+    }
+    sw.stop();
+    return sw.ns();
+  }});
+
+  // the first assignment of a property that is found `depth` objects up the prototype chain,
+  // which adds an own property.
+  for (int depth : {1, 4, 16}) {
+    JSValue& proto = root(JSValue(new_chain(depth - 1, key_atom)));
+    string name = "object.set_prop/add,depth=" + std::to_string(depth);
+    cases.push_back({name, [this, key_atom, &proto] (uint64_t iters) {
+      constexpr uint64_t BATCH = 4096;
+      vector<JSObject *> objs;
+      Stopwatch sw;
+      for (uint64_t done = 0; done < iters; done += BATCH) {
+        // no GC may happen while the batch is not rooted.
+        objs.clear();
+        for (uint64_t i = 0; i < std::min(BATCH, iters - done); i++) {
+          objs.push_back(vm.new_object(CLS_OBJECT, proto));
+        }
+        sw.start();
+        for (JSObject *obj : objs) {
+          sink = obj->set_prop(vm, JSAtom(key_atom), JSValue(2.0)).get_value();
+        }
+        sw.stop();
+        objs.clear();
+        heap.gc_if_needed();
+      }
+      return sw.ns();
+    }});
+  }
+
+  // `a + b` where `a` is referenced elsewhere, so it is copied.
+  u16string piece(16, u'x');
+  for (u32 length : {16u, 256u, 1024u}) {
+    u16string lhs_str(length, u'a');
+    JSValue& lhs = root(vm.new_primitive_string(lhs_str));
+    lhs.as_prim_string->ref_count_inc();
+    string name = "string.concat/length=" + std::to_string(length);
+    cases.push_back({name, [this, piece, &lhs] (uint64_t iters) {
+      Stopwatch sw;
+      sw.start();
+      for (uint64_t i = 0; i < iters; i++) {
+        PrimitiveString *res = lhs.as_prim_string->concat(heap, piece.data(), piece.size());
+        sink = res->length();
+        heap.gc_if_needed();
+      }
+      sw.stop();
+      return sw.ns();
+    }});
+  }
+
+  // `s = s + b` in a loop, which appends in place while there is room.
+  cases.push_back({"string.concat/append", [this, piece] (uint64_t iters) {
+    constexpr uint64_t PIECES = 1024;
+    Stopwatch sw;
+    sw.start();
+    for (uint64_t done = 0; done < iters; done += PIECES) {
+      // no GC may happen while the string is not rooted.
+      PrimitiveString *str = heap.new_prim_string(0);
+      for (uint64_t i = 0; i < std::min(PIECES, iters - done); i++) {
+        str = str->concat(heap, piece.data(), piece.size());
+      }
+      sink = str->length();
+      heap.gc_if_needed();
+    }
+    sw.stop();
+    return sw.ns();
+  }});
+
+  // `s.substring(1, 1 + length)` of a long string.
+  JSValue& long_str = root(vm.new_primitive_string(u16string(4096, u'a')));
+  for (u32 length : {16u, 256u, 1024u}) {
+    string name = "string.substr/length=" + std::to_string(length);
+    cases.push_back({name, [this, length, &long_str] (uint64_t iters) {
+      Stopwatch sw;
+      sw.start();
+      for (uint64_t i = 0; i < iters; i++) {
+        PrimitiveString *res = long_str.as_prim_string->substr(heap, 1, length);
+        sink = res->length();
+        heap.gc_if_needed();
+      }
+      sw.stop();
+      return sw.ns();
+    }});
+  }
+
+  // `s.indexOf(p)` of a 4096-character string that does not contain `p`, so it is all scanned.
+  u16string haystack;
+  while (haystack.size() < 4096) haystack += u"the quick brown fox jumps over the lazy dog ";
+  haystack.resize(4096);
+  u16string needle = u"dogs";
+  for (bool one_byte : {true, false}) {
+    // a character that is not Latin-1 makes the string two-byte.
+    u16string str = one_byte ? haystack : haystack + u"α";
+    JSValue& str_val = root(vm.new_primitive_string(str));
+    string name = string("string.find/") + (one_byte ? "one_byte" : "two_byte");
+    cases.push_back({name, [needle, &str_val] (uint64_t iters) {
+      Stopwatch sw;
+      sw.start();
+      for (uint64_t i = 0; i < iters; i++) {
+        sink = str_val.as_prim_string->find(needle.data(), needle.size());
+      }
+      sw.stop();
+      return sw.ns();
+    }});
+  }
+
+  // `a < b` of two 1024-character strings that only differ in the last character.
+  for (bool one_byte : {true, false}) {
+    u16string str = one_byte ? haystack.substr(0, 1023) : u"α" + haystack.substr(0, 1022);
+    JSValue& lhs = root(vm.new_primitive_string(str + u"a"));
+    JSValue& rhs = root(vm.new_primitive_string(str + u"b"));
+    string name = string("string.compare/") + (one_byte ? "one_byte" : "two_byte");
+    cases.push_back({name, [&lhs, &rhs] (uint64_t iters) {
+      Stopwatch sw;
+      sw.start();
+      for (uint64_t i = 0; i < iters; i++) {
+        sink = *lhs.as_prim_string < *rhs.as_prim_string;
+      }
+      sw.stop();
+      return sw.ns();
+    }});
+  }
+
+  u16string json = u"[";
+  for (int i = 0; i < 200; i++) {
+    if (i != 0) json += u",";
+    json += u"{\"id\":" + to_u16string(i) + u",\"name\":\"item " + to_u16string(i)
+            + u"\",\"score\":" + double_to_u16string(i * 0.25)
+            + u",\"tags\":[\"a\",\"b\"],\"active\":true,\"next\":null}";
+  }
+  json += u"]";
+  string json_name = "json.parse/bytes=" + std::to_string(json.size());
+  cases.push_back({json_name, [this, json] (uint64_t iters) {
+    Stopwatch sw;
+    sw.start();
+    for (uint64_t i = 0; i < iters; i++) {
+      Completion res = JSONParser(vm, json).parse();
+      sink = res.get_value().tag;
+      heap.gc_if_needed();
+    }
+    sw.stop();
+    return sw.ns();
+  }});
+
+  auto add_double_case = [&] (const string& kind, std::function<double(int)> make) {
+    vector<double> values;
+    for (int i = 0; i < 1024; i++) values.push_back(make(i));
+    cases.push_back({"conversion.double_to_u16string/" + kind, [values] (uint64_t iters) {
+      Stopwatch sw;
+      sw.start();
+      for (uint64_t i = 0; i < iters; i++) {
+        sink = double_to_u16string(values[i & 1023]).size();
+      }
+      sw.stop();
+      return sw.ns();
+    }});
+  };
+  add_double_case("int", [] (int i) { return i * 7919.0; });
+  add_double_case("fraction", [] (int i) { return i / 7.0; });
+  add_double_case("exponent", [] (int i) { return (i + 1) * 1.7e25; });
+
+  for (auto [name, index] : {std::pair {"call_function/js", JS_IDENTITY},
+                             std::pair {"call_function/native", NATIVE_FLOOR}}) {
+    cases.push_back({name, [this, index] (uint64_t iters) {
+      JSValue args[1] {JSValue(-1.0)};
+      Stopwatch sw;
+      sw.start();
+      for (uint64_t i = 0; i < iters; i++) {
+        Completion res = vm.call_function(exported[index], undefined, ArgRef(args, 1));
+        sink = res.get_value().tag;
+        heap.gc_if_needed();
+      }
+      sw.stop();
+      return sw.ns();
+    }});
+  }
+}
+
+// Return the time of one operation in nanoseconds.
+double measure(const Case& c, const Options& options) {
+  // find the iteration count that takes at least `min_ms`
+  uint64_t iters = 1;
+  while (c.run(iters) < options.min_ms * 1e6 && iters < (1ull << 40)) {
+    iters *= 2;
+  }
+
+  vector<double> times;
+  for (int i = 0; i < options.repeats; i++) {
+    times.push_back(c.run(iters) / iters);
+  }
+  std::sort(times.begin(), times.end());
+  return times[times.size() / 2];
+}
+
+void read_options(int argc, char *argv[], Options& options) {
+  int option;
+  while ((option = getopt(argc, argv, "r:m:")) != -1) {
+    switch (option) {
+      case 'r':
+        options.repeats = std::max(atoi(optarg), 1);
+        break;
+      case 'm':
+        options.min_ms = atof(optarg);
+        break;
+      case '?':
+        std::cerr << "Unknown option: " << static_cast<char>(optopt) << '\n';
+        break;
+      default:
+        break;
+    }
+  }
+  for (int i = optind; i < argc; i++) {
+    options.filters.emplace_back(argv[i]);
+  }
+}
+
+bool selected(const Case& c, const Options& options) {
+  if (options.filters.empty()) return true;
+  return std::any_of(options.filters.begin(), options.filters.end(), [&] (const string& filter) {
+    return c.name.find(filter) != string::npos;
+  });
+}
+
+}
+
+int main(int argc, char *argv[]) {
+  Options options;
+  read_options(argc, argv, options);
+
+  Parser parser(prelude);
+  ASTNode *ast = parser.parse_program();
+  defer { delete ast; };
+  CodegenVisitor visitor;
+  visitor.codegen(static_cast<ProgramOrFunctionBody *>(ast));
+
+  NjsVM vm(visitor);
+  vm.setup();
+  vm.add_native_func_impl(u"$export", [] (vm_func_This_args_flags) -> Completion {
+    for (size_t i = 0; i < std::min(args.size(), (size_t)EXPORTED_COUNT); i++) {
+      exported[i] = args[i];
+      vm.push_temp_root(exported[i]);
+    }
+    return undefined;
+  });
+  vm.run();
+  if (vm.terminated_with_throw()) {
+    return EXIT_FAILURE;
+  }
+
+  MicroBench bench(vm);
+  vector<Case> cases;
+  bench.add_cases(cases);
+
+  printf("# ns per operation, median of %d repeats\n", options.repeats);
+  for (const Case& c : cases) {
+    if (not selected(c, options)) continue;
+    printf("%-40s %12.2f\n", c.name.c_str(), measure(c, options));
+    fflush(stdout);
+  }
+  return EXIT_SUCCESS;
+}
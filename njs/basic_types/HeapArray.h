@@ -13,6 +13,8 @@ template <typename T>
 struct HeapArray: public GCObject {
 friend class GCHeap;
 
+  constexpr static bool GC_NEEDS_FINALIZER = false;
+
   HeapArray(const HeapArray& other) = delete;
   HeapArray(HeapArray&& other) = delete;
   HeapArray& operator=(HeapArray&& other) = delete;
@@ -23,6 +25,7 @@ friend class GCHeap;
   }
 
   bool gc_scan_children(GCHeap &heap) override { return false; }
+  bool gc_scan_card(GCHeap &heap, void *card_start, void *card_end) override { return false; }
   void gc_mark_children() override {}
   bool gc_has_young_child(GCObject *oldgen_start) override { return false; }
 
@@ -66,6 +69,30 @@ inline bool HeapArray<JSValue>::gc_scan_children(GCHeap& heap) {
   return child_young;
 }
 
+// Only scan the elements that start inside the card. Writes to the elements should use the
+// write barrier that takes the address of the element.
+template <>
+inline bool HeapArray<JSValue>::gc_scan_card(GCHeap& heap, void *card_start, void *card_end) {
+  auto elements_start = reinterpret_cast<uintptr_t>(storage);
+  auto start = reinterpret_cast<uintptr_t>(card_start);
+  auto end = reinterpret_cast<uintptr_t>(card_end);
+
+  size_t begin_idx = 0;
+  if (start > elements_start) {
+    begin_idx = (start - elements_start + sizeof(JSValue) - 1) / sizeof(JSValue);
+  }
+  size_t end_idx = 0;
+  if (end > elements_start) {
+    end_idx = std::min((size_t)len, (end - elements_start + sizeof(JSValue) - 1) / sizeof(JSValue));
+  }
+
+  bool child_young = false;
+  for (size_t i = begin_idx; i < end_idx; i++) {
+    gc_check_and_visit_object(child_young, storage[i]);
+  }
+  return child_young;
+}
+
 template <>
 inline void HeapArray<JSValue>::gc_mark_children() {
   for (u32 i = 0; i < len; i++) {
@@ -15,6 +15,28 @@ bool JSArray::gc_scan_children(GCHeap& heap) {
   return child_young;
 }
 
+bool JSArray::gc_scan_card(GCHeap& heap, void *card_start, void *card_end) {
+  if ((void *)this < card_start || (void *)this >= card_end) return false;
+
+  bool child_young = JSObject::gc_scan_children(heap);
+
+  size_t card_cnt = (dense_array.size() + ELEMENTS_PER_CARD - 1) / ELEMENTS_PER_CARD;
+  element_cards.resize(card_cnt, GCHeap::CARD_DIRTY);
+
+  for (size_t card = 0; card < card_cnt; card++) {
+    if (element_cards[card] == GCHeap::CARD_CLEAN) continue;
+
+    bool card_young = false;
+    size_t end = std::min(dense_array.size(), (card + 1) * ELEMENTS_PER_CARD);
+    for (size_t i = card * ELEMENTS_PER_CARD; i < end; i++) {
+      gc_check_and_visit_object(card_young, dense_array[i]);
+    }
+    element_cards[card] = card_young ? GCHeap::CARD_DIRTY : GCHeap::CARD_CLEAN;
+    child_young |= card_young;
+  }
+  return child_young;
+}
+
 void JSArray::gc_mark_children() {
   JSObject::gc_mark_children();
   for (auto& val : dense_array) {
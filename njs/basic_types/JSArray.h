@@ -16,6 +16,9 @@ using u32 = uint32_t;
 
 class JSArray: public JSObject {
  public:
+  // number of elements covered by one element card
+  constexpr static size_t ELEMENTS_PER_CARD = GCHeap::CARD_SIZE / sizeof(JSValue);
+
   JSArray(NjsVM& vm, u32 length): JSObject(vm, CLS_ARRAY, vm.array_prototype) {
     PFlag flag {
         .writable = true,
@@ -29,6 +32,7 @@ class JSArray: public JSObject {
   }
 
   bool gc_scan_children(GCHeap& heap) override;
+  bool gc_scan_card(GCHeap& heap, void *card_start, void *card_end) override;
   void gc_mark_children() override;
   bool gc_has_young_child(GCObject *oldgen_start) override;
 
@@ -148,7 +152,7 @@ class JSArray: public JSObject {
       }
       set_length(index + 1);
     }
-    gc_write_barrier(val);
+    write_barrier_element(vm, index, val);
     dense_array[index] = val;
   }
 
@@ -178,7 +182,7 @@ class JSArray: public JSObject {
 
   size_t push(NjsVM& vm, JSValue value) {
 //    set_referenced(value);
-    gc_write_barrier(value);
+    write_barrier_element(vm, dense_array.size(), value);
     dense_array.push_back(value);
     update_length();
     return dense_array.size();
@@ -187,7 +191,7 @@ class JSArray: public JSObject {
   size_t push(NjsVM& vm, ArgRef values) {
     for (size_t i = 0; i < values.size(); i++) {
 //      set_referenced(values[i]);
-      gc_write_barrier(values[i]);
+      write_barrier_element(vm, dense_array.size(), values[i]);
       dense_array.push_back(values[i]);
     }
     update_length();
@@ -212,6 +216,7 @@ class JSArray: public JSObject {
     } else {
       JSValue front = dense_array.front();
       dense_array.erase(dense_array.begin());
+      gc_reset_element_cards();
       update_length();
 
       return unlikely(front.is_uninited()) ? prop_not_found : front;
@@ -238,7 +243,23 @@ class JSArray: public JSObject {
     return dense_array;
   }
 
+  // Should be called after the elements are moved around (e.g., sorted), since the element
+  // cards no longer match the elements.
+  void gc_reset_element_cards() {
+    element_cards.clear();
+  }
+
  private:
+  void write_barrier_element(NjsVM& vm, size_t index, JSValue val) {
+    if (vm.heap.write_barrier(this, val)) {
+      size_t card = index / ELEMENTS_PER_CARD;
+      // cards not in `element_cards` are considered dirty.
+      if (card < element_cards.size()) {
+        element_cards[card] = GCHeap::CARD_DIRTY;
+      }
+    }
+  }
+
   void set_length(double len) {
     storage[JSObjectKey(AtomPool::k_length)].data.value.as_f64 = len;
   }
@@ -248,6 +269,9 @@ class JSArray: public JSObject {
   }
 
   std::vector<JSValue> dense_array;
+  // When the array is in the old generation, each card of elements records whether the
+  // elements in it may reference objects in the new generation.
+  std::vector<uint8_t> element_cards;
   bool is_fast_array {true};
 };
 
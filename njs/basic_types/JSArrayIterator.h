@@ -29,7 +29,7 @@ class JSArrayIterator : public JSObject {
     : JSObject(vm, CLS_ARRAY_ITERATOR, vm.iterator_prototype)
     , array(array), kind(kind) {
     gc_write_barrier(array);
-    add_method(vm, u"next", JSArrayIterator::iter_next);
+    add_method(vm, AtomPool::k_next, JSArrayIterator::iter_next);
   }
 
   u16string_view get_class_name() override {
@@ -5,6 +5,7 @@
 #include "JSObjectPrototype.h"
 #include "njs/vm/NjsVM.h"
 #include "njs/common/Span.h"
+#include "njs/common/Defer.h"
 #include "njs/common/common_def.h"
 #include "JSFunction.h"
 #include "njs/common/Completion.h"
@@ -20,16 +21,16 @@ class JSArrayPrototype : public JSObject {
  public:
   JSArrayPrototype(NjsVM& vm) : JSObject(CLS_ARRAY_PROTO) {
     add_symbol_method(vm, AtomPool::k_sym_iterator,  JSArrayPrototype::get_iter);
-    add_method(vm, u"at", JSArrayPrototype::at);
-    add_method(vm, u"push", JSArrayPrototype::push);
-    add_method(vm, u"pop", JSArrayPrototype::pop);
-    add_method(vm, u"shift", JSArrayPrototype::shift);
-    add_method(vm, u"sort", JSArrayPrototype::sort);
-    add_method(vm, u"toString", JSArrayPrototype::toString);
-    add_method(vm, u"concat", JSArrayPrototype::concat);
-    add_method(vm, u"join", JSArrayPrototype::join);
-    add_method(vm, u"slice", JSArrayPrototype::slice);
-    add_method(vm, u"splice", JSArrayPrototype::splice);
+    add_method(vm, AtomPool::k_at, JSArrayPrototype::at);
+    add_method(vm, AtomPool::k_push, JSArrayPrototype::push);
+    add_method(vm, AtomPool::k_pop, JSArrayPrototype::pop);
+    add_method(vm, AtomPool::k_shift, JSArrayPrototype::shift);
+    add_method(vm, AtomPool::k_sort, JSArrayPrototype::sort);
+    add_method(vm, AtomPool::k_toString, JSArrayPrototype::toString);
+    add_method(vm, AtomPool::k_concat, JSArrayPrototype::concat);
+    add_method(vm, AtomPool::k_join, JSArrayPrototype::join);
+    add_method(vm, AtomPool::k_slice, JSArrayPrototype::slice);
+    add_method(vm, AtomPool::k_splice, JSArrayPrototype::splice);
   }
 
   u16string_view get_class_name() override {
@@ -48,7 +49,7 @@ class JSArrayPrototype : public JSObject {
 
         if (not val.is_nil()) [[likely]] {
           JSValue s = TRYCC(js_to_string(vm, val));
-          output += s.as_prim_string->view();
+          s.as_prim_string->append_to(output);
         }
       }
       return vm.new_primitive_string(output);
@@ -77,7 +78,7 @@ class JSArrayPrototype : public JSObject {
 
       if (not val.is_nil()) [[likely]] {
         JSValue s = TRYCC(js_to_string(vm, val));
-        output += s.as_prim_string->view();
+        s.as_prim_string->append_to(output);
       }
     }
     return vm.new_primitive_string(output);
@@ -102,6 +103,7 @@ class JSArrayPrototype : public JSObject {
   static Completion sort(vm_func_This_args_flags) {
     assert(This.is(JSValue::ARRAY));
     auto& data_array = This.as_array->get_dense_array();
+    defer { This.as_array->gc_reset_element_cards(); };
     Completion comp;
     // no compare function provided. Convert values to strings and do string sorting.
     if (args.empty()) {
@@ -222,6 +224,7 @@ class JSArrayPrototype : public JSObject {
     del_cnt = std::min(del_cnt, old_len - start);
 
     auto *ret_arr = vm.heap.new_object<JSArray>(vm, del_cnt);
+    arr->gc_reset_element_cards();
     // remove elements and add them to the return array
     for (u32 i = start; i < start + del_cnt; i++) {
       ret_arr->set_element_fast(vm, i - start, dense_arr[start]);
@@ -12,8 +12,8 @@ namespace njs {
 class JSBooleanPrototype : public JSObject {
  public:
   explicit JSBooleanPrototype(NjsVM &vm) : JSObject(CLS_BOOLEAN_PROTO) {
-    add_method(vm, u"valueOf", JSBooleanPrototype::valueOf);
-    add_method(vm, u"toString", JSBooleanPrototype::toString);
+    add_method(vm, AtomPool::k_valueOf, JSBooleanPrototype::valueOf);
+    add_method(vm, AtomPool::k_toString, JSBooleanPrototype::toString);
   }
 
   u16string_view get_class_name() override {
@@ -13,10 +13,10 @@ class NjsVM;
 class JSDatePrototype : public JSObject {
  public:
   explicit JSDatePrototype(NjsVM& vm) {
-    add_method(vm, u"valueOf", JSDatePrototype::valueOf);
-    add_method(vm, u"getTime", JSDatePrototype::valueOf);
-    add_method(vm, u"toString", JSDatePrototype::toString);
-    add_method(vm, u"toJSON", JSDatePrototype::toJSON);
+    add_method(vm, AtomPool::k_valueOf, JSDatePrototype::valueOf);
+    add_method(vm, AtomPool::k_getTime, JSDatePrototype::valueOf);
+    add_method(vm, AtomPool::k_toString, JSDatePrototype::toString);
+    add_method(vm, AtomPool::k_toJSON, JSDatePrototype::toJSON);
   }
 
   u16string_view get_class_name() override {
@@ -5,8 +5,8 @@ namespace njs {
 
 JSErrorPrototype::JSErrorPrototype(NjsVM& vm, JSErrorType type)
   : JSObject(CLS_ERROR_PROTO) {
-  set_prop(vm, u"name", vm.new_primitive_string(native_error_name[type]));
-  add_method(vm, u"toString", JSErrorPrototype::toString);
+  set_prop(vm, JSAtom(AtomPool::k_name), vm.new_primitive_string(native_error_name[type]));
+  add_method(vm, AtomPool::k_toString, JSErrorPrototype::toString);
 }
 
 Completion JSErrorPrototype::toString(vm_func_This_args_flags) {
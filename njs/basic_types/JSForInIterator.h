@@ -81,6 +81,10 @@ class JSForInIterator : public JSObject {
     if (object.needs_gc()) [[likely]] {
       gc_mark_object(object.as_GCObject);
     }
+    // the keys that are not visited yet may have been deleted from the object.
+    for (size_t i = index; i < collected_keys.size(); i++) {
+      gc_mark_atom(collected_keys[i]);
+    }
   }
 
   bool gc_has_young_child(GCObject *oldgen_start) override {
@@ -90,9 +94,13 @@ class JSForInIterator : public JSObject {
 
   JSValue next(NjsVM& vm) {
     if (index < collected_keys.size()) [[likely]] {
-      u16string_view key_str = vm.atom_to_str(collected_keys[index]);
+      u32 atom = collected_keys[index];
       index += 1;
-      return vm.new_primitive_string(key_str);
+      JSValue key = atom_is_int(atom) ? vm.u32_to_string(atom_get_int(atom))
+                                      : vm.new_primitive_string(vm.atom_to_str(atom));
+      // the key is likely to be used to get the property.
+      key.as_prim_string->set_atom(atom);
+      return key;
     } else {
       return JSValue::uninited;
     }
@@ -10,6 +10,7 @@
 #include "njs/common/enums.h"
 #include "njs/common/common_def.h"
 #include "njs/codegen/CatchEntry.h"
+#include "njs/codegen/RootMap.h"
 
 namespace njs {
 
@@ -55,6 +56,9 @@ struct JSFunctionMeta {
 
   SmallVector<CaptureEntry, 5> capture_list;
   SmallVector<CatchEntry, 3> catch_table;
+  // built by the codegen. Empty for the global code, whose variables are accessed from
+  // everywhere.
+  RootMap root_map;
 
   NativeFuncType native_func {nullptr};
   int magic;
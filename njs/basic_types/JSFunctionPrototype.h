@@ -17,9 +17,9 @@ class JSFunctionPrototype : public JSObject {
   // We need this to solve the chicken or egg question.
   // see also NjsVM::init_prototypes
   void add_methods(NjsVM& vm) {
-    add_method(vm, u"call", JSFunctionPrototype::call);
-    add_method(vm, u"bind", JSFunctionPrototype::bind);
-    add_method(vm, u"apply", JSFunctionPrototype::apply);
+    add_method(vm, AtomPool::k_call, JSFunctionPrototype::call);
+    add_method(vm, AtomPool::k_bind, JSFunctionPrototype::bind);
+    add_method(vm, AtomPool::k_apply, JSFunctionPrototype::apply);
   }
 
   u16string_view get_class_name() override {
@@ -12,9 +12,9 @@ class JSGeneratorPrototype : public JSObject {
   explicit JSGeneratorPrototype(NjsVM &vm)
       : JSObject(vm, CLS_GENERATOR_PROTO, vm.object_prototype) {
     add_symbol_method(vm, AtomPool::k_sym_iterator,  JSGeneratorPrototype::get_iter);
-    add_method(vm, u"next", JSGeneratorPrototype::next_);
-    add_method(vm, u"return", JSGeneratorPrototype::return_);
-    add_method(vm, u"throw", JSGeneratorPrototype::throw_);
+    add_method(vm, AtomPool::k_next, JSGeneratorPrototype::next_);
+    add_method(vm, AtomPool::k_return, JSGeneratorPrototype::return_);
+    add_method(vm, AtomPool::k_throw, JSGeneratorPrototype::throw_);
   }
 
   u16string_view get_class_name() override {
@@ -8,6 +8,8 @@
 namespace njs {
 
 struct JSHeapValue: public GCObject {
+  constexpr static bool GC_NEEDS_FINALIZER = false;
+
   explicit JSHeapValue(NjsVM& vm, JSValue val): wrapped_val(val) {
     gc_write_barrier(val);
   }
@@ -20,9 +22,7 @@ struct JSHeapValue: public GCObject {
   }
 
   void gc_mark_children() override {
-    if (wrapped_val.needs_gc()) {
-      gc_mark_object(wrapped_val.as_GCObject);
-    }
+    gc_check_and_mark_object(wrapped_val);
   }
 
   bool gc_has_young_child(njs::GCObject *oldgen_start) override {
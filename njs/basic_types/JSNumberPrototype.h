@@ -13,8 +13,8 @@ namespace njs {
 class JSNumberPrototype : public JSObject {
  public:
   explicit JSNumberPrototype(NjsVM &vm) : JSObject(CLS_NUMBER_PROTO) {
-    add_method(vm, u"valueOf", JSNumberPrototype::valueOf);
-    add_method(vm, u"toString", JSNumberPrototype::toString);
+    add_method(vm, AtomPool::k_valueOf, JSNumberPrototype::valueOf);
+    add_method(vm, AtomPool::k_toString, JSNumberPrototype::toString);
   }
 
   u16string_view get_class_name() override {
@@ -41,10 +41,10 @@ class JSNumberPrototype : public JSObject {
     if (This.is_object() && object_class(This) == CLS_NUMBER) [[likely]] {
       assert(dynamic_cast<JSNumber*>(This.as_object));
       auto *num_obj = static_cast<JSNumber*>(This.as_object);
-      return vm.new_primitive_string(double_to_u16string(num_obj->value));
+      return vm.number_to_string(num_obj->value);
     }
     else if (This.is(JSValue::NUM_FLOAT)) {
-      return vm.new_primitive_string(double_to_u16string(This.as_f64));
+      return vm.number_to_string(This.as_f64);
     }
     else {
       return JSObjectPrototype::toString(JS_NATIVE_FUNC_ARGS);
@@ -306,10 +306,13 @@ bool JSObject::add_prop_trivial(NjsVM& vm, JSValue key, JSValue value, PFlag fla
 }
 
 bool JSObject::add_method(NjsVM& vm, u16string_view key_str, NativeFuncType funcImpl, PFlag flag) {
-  u32 name_idx = vm.str_to_atom(key_str);
+  return add_method(vm, vm.str_to_atom(key_str), funcImpl, flag);
+}
+
+bool JSObject::add_method(NjsVM& vm, u32 key_atom, NativeFuncType funcImpl, PFlag flag) {
   JSFunctionMeta *meta = build_func_meta(funcImpl);
   vm.func_meta.emplace_back(meta);
-  return add_prop_trivial(vm, name_idx, JSValue(vm.new_function(meta)), flag);
+  return add_prop_trivial(vm, key_atom, JSValue(vm.new_function(meta)), flag);
 }
 
 bool JSObject::add_symbol_method(NjsVM& vm, u32 symbol, NativeFuncType funcImpl, PFlag flag) {
@@ -488,6 +491,7 @@ bool JSObject::gc_scan_children(GCHeap& heap) {
 
 void JSObject::gc_mark_children() {
   for (auto& [key, prop]: storage) {
+    gc_mark_atom(key.atom);
     if (prop.flag.is_value()) {
       gc_check_and_mark_object(prop.data.value);
     }
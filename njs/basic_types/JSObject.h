@@ -258,6 +258,7 @@ using StorageType = unordered_flat_map<JSObjectKey, JSPropDesc, ObjKeyHasher>;
   bool add_prop_trivial(NjsVM& vm, JSValue key, JSValue value, PFlag flag = PFlag::VCW);
 
   bool add_method(NjsVM& vm, u16string_view key_str, NativeFuncType funcImpl, PFlag flag = PFlag::VCW);
+  bool add_method(NjsVM& vm, u32 key_atom, NativeFuncType funcImpl, PFlag flag = PFlag::VCW);
   bool add_symbol_method(NjsVM& vm, u32 symbol, NativeFuncType funcImpl, PFlag flag = PFlag::VCW);
 
   Completion get_prop(NjsVM& vm, JSValue key);
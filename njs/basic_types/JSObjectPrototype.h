@@ -14,10 +14,10 @@ namespace njs {
 class JSObjectPrototype : public JSObject {
  public:
   JSObjectPrototype(NjsVM& vm) : JSObject(CLS_OBJECT_PROTO) {
-    add_method(vm, u"valueOf", JSObjectPrototype::valueOf);
-    add_method(vm, u"toString", JSObjectPrototype::toString);
-    add_method(vm, u"toLocaleString", JSObjectPrototype::toLocaleString);
-    add_method(vm, u"hasOwnProperty", JSObjectPrototype::hasOwnProperty);
+    add_method(vm, AtomPool::k_valueOf, JSObjectPrototype::valueOf);
+    add_method(vm, AtomPool::k_toString, JSObjectPrototype::toString);
+    add_method(vm, AtomPool::k_toLocaleString, JSObjectPrototype::toLocaleString);
+    add_method(vm, AtomPool::k_hasOwnProperty, JSObjectPrototype::hasOwnProperty);
   }
 
   u16string_view get_class_name() override {
@@ -9,9 +9,9 @@ namespace njs {
 class JSPromisePrototype : public JSObject {
  public:
   explicit JSPromisePrototype(NjsVM &vm) : JSObject(CLS_PROMISE_PROTO) {
-    add_method(vm, u"then", JSPromisePrototype::promise_then);
-    add_method(vm, u"catch", JSPromisePrototype::promise_catch);
-    add_method(vm, u"finally", JSPromisePrototype::promise_finally);
+    add_method(vm, AtomPool::k_then, JSPromisePrototype::promise_then);
+    add_method(vm, AtomPool::k_catch, JSPromisePrototype::promise_catch);
+    add_method(vm, AtomPool::k_finally, JSPromisePrototype::promise_finally);
   }
 
   u16string_view get_class_name() override {
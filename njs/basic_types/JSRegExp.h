@@ -70,8 +70,8 @@ class JSRegExp : public JSObject {
   {
     add_regexp_object_props(vm, flags);
 
-    add_prop_trivial(vm, u"source", JSValue(vm.new_primitive_string(pattern)), PFlag::V);
-    add_prop_trivial(vm, u"flags", JSValue(vm.new_primitive_string(flags_str)), PFlag::V);
+    add_prop_trivial(vm, AtomPool::k_source, JSValue(vm.new_primitive_string(pattern)), PFlag::V);
+    add_prop_trivial(vm, AtomPool::k_flags, JSValue(vm.new_primitive_string(flags_str)), PFlag::V);
   }
 
   JSRegExp(NjsVM& vm, u32 pattern_atom, int flags)
@@ -83,21 +83,21 @@ class JSRegExp : public JSObject {
     add_regexp_object_props(vm, flags);
 
     u16string flag_str = regexp_flags_to_str(flags);
-    add_prop_trivial(vm, u"source", JSValue(vm.new_primitive_string(pattern.view())), PFlag::V);
-    add_prop_trivial(vm, u"flags", JSValue(vm.new_primitive_string(flag_str)), PFlag::V);
+    add_prop_trivial(vm, AtomPool::k_source, JSValue(vm.new_primitive_string(pattern.view())), PFlag::V);
+    add_prop_trivial(vm, AtomPool::k_flags, JSValue(vm.new_primitive_string(flag_str)), PFlag::V);
   }
 
   void add_regexp_object_props(NjsVM& vm, int fl) {
     RegExpFlags flags_struct(fl);
 
-    add_prop_trivial(vm, u"global", JSValue(flags_struct.global), PFlag::V);
-    add_prop_trivial(vm, u"ignoreCase", JSValue(flags_struct.ignoreCase), PFlag::V);
-    add_prop_trivial(vm, u"multiline", JSValue(flags_struct.multiline), PFlag::V);
-    add_prop_trivial(vm, u"dotAll", JSValue(flags_struct.dotAll), PFlag::V);
-    add_prop_trivial(vm, u"unicode", JSValue(flags_struct.unicode), PFlag::V);
-    add_prop_trivial(vm, u"sticky", JSValue(flags_struct.sticky), PFlag::V);
-    add_prop_trivial(vm, u"hasIndices", JSValue(flags_struct.hasIndices), PFlag::V);
-    add_prop_trivial(vm, u"lastIndex", JSFloat0);
+    add_prop_trivial(vm, AtomPool::k_global, JSValue(flags_struct.global), PFlag::V);
+    add_prop_trivial(vm, AtomPool::k_ignoreCase, JSValue(flags_struct.ignoreCase), PFlag::V);
+    add_prop_trivial(vm, AtomPool::k_multiline, JSValue(flags_struct.multiline), PFlag::V);
+    add_prop_trivial(vm, AtomPool::k_dotAll, JSValue(flags_struct.dotAll), PFlag::V);
+    add_prop_trivial(vm, AtomPool::k_unicode, JSValue(flags_struct.unicode), PFlag::V);
+    add_prop_trivial(vm, AtomPool::k_sticky, JSValue(flags_struct.sticky), PFlag::V);
+    add_prop_trivial(vm, AtomPool::k_hasIndices, JSValue(flags_struct.hasIndices), PFlag::V);
+    add_prop_trivial(vm, AtomPool::k_lastIndex, JSFloat0);
   }
 
   Completion compile_bytecode_internal(NjsVM& vm) {
@@ -131,8 +131,10 @@ class JSRegExp : public JSObject {
     return undefined;
   }
 
+  // The long captures are slices of `input`, which is the string being matched.
   template<typename ItemCB>
-  ErrorOr<JSObject *> build_group_object(NjsVM& vm, LREWrapper& lre, ItemCB callback) {
+  ErrorOr<JSObject *> build_group_object(NjsVM& vm, LREWrapper& lre, PrimitiveString *input,
+                                         ItemCB callback) {
     JSObject *groups = nullptr;
     const char *group_name_ptr = lre.get_groupnames();
     int capture_cnt = lre.get_capture_cnt();
@@ -143,7 +145,8 @@ class JSRegExp : public JSObject {
     for (int i = 0; i < capture_cnt; i++) {
       JSValue item;
       if (lre.captured_at_group_index(i)) {
-        item = vm.new_primitive_string(lre.get_group_match_result(i));
+        auto [start, end] = lre.capture_group_get_start_end(i);
+        item = JSValue(input->substr(vm.heap, start, end - start));
       }
 
       if (group_name_ptr && i > 0) {
@@ -191,14 +194,15 @@ class JSRegExp : public JSObject {
 
       auto *arr = vm.heap.new_object<JSArray>(vm, lre.get_capture_cnt());
 
-      JSObject *groups = TRY_COMP(build_group_object(vm, lre, [&vm, arr] (int i, JSValue item) {
+      auto set_item = [&vm, arr] (int i, JSValue item) {
         arr->set_property_impl(vm, JSFloat(i), item);
-      }));
+      };
+      JSObject *groups = TRY_COMP(build_group_object(vm, lre, arg.as_prim_string, set_item));
 
-      TRY_COMP(arr->set_prop(vm, u"groups", groups ? JSValue(groups) : undefined));
+      TRY_COMP(arr->set_prop(vm, JSAtom(AtomPool::k_groups), groups ? JSValue(groups) : undefined));
       size_t index = lre.get_matched_start();
-      TRY_COMP(arr->set_prop(vm, u"index", JSFloat(index)));
-      TRY_COMP(arr->set_prop(vm, u"input", arg));
+      TRY_COMP(arr->set_prop(vm, JSAtom(AtomPool::k_index), JSFloat(index)));
+      TRY_COMP(arr->set_prop(vm, JSAtom(AtomPool::k_input), arg));
 
       return JSValue(arr);
     }
@@ -274,9 +278,10 @@ class JSRegExp : public JSObject {
           // match, p1, p2, /* …, */ pN, offset, full string, groups
           vector<JSValue> func_args(lre.get_capture_cnt());
 
-          JSObject *groups = TRY_COMP(build_group_object(vm, lre, [&] (int i, JSValue item) {
+          auto set_arg = [&] (int i, JSValue item) {
             func_args[i] = item;
-          }));
+          };
+          JSObject *groups = TRY_COMP(build_group_object(vm, lre, str.as_prim_string, set_arg));
 
           func_args.push_back(JSFloat(first_index));                  // offset
           func_args.push_back(str);                                   // full string
@@ -309,7 +314,7 @@ class JSRegExp : public JSObject {
   }
 
   Completion prototype_to_string(NjsVM& vm) {
-    auto flags_str = TRYCC(get_prop(vm, u"flags")).as_prim_string->view();
+    auto flags_str = TRYCC(get_prop(vm, AtomPool::k_flags)).as_prim_string->view();
     u16string regexp_str;
     regexp_str.reserve(pattern.size() + 2 + flags_str.length());
     regexp_str = u'/';
@@ -323,6 +328,12 @@ class JSRegExp : public JSObject {
     return u"RegExp";
   }
 
+  void gc_mark_children() override {
+    JSObject::gc_mark_children();
+    // keeps the compiled bytecode in `vm.regexp_bytecode`
+    gc_mark_atom(pattern_atom);
+  }
+
   std::string to_string(njs::NjsVM &vm) const override {
     return to_u8string(pattern.view());
   }
@@ -14,25 +14,25 @@ namespace njs {
 class JSRegExpPrototype : public JSObject {
  public:
   explicit JSRegExpPrototype(NjsVM &vm) : JSObject(CLS_REGEXP_PROTO) {
-    add_method(vm, u"toString", JSRegExpPrototype::toString);
-    add_method(vm, u"test", JSRegExpPrototype::re_test);
-    add_method(vm, u"exec", JSRegExpPrototype::re_exec);
+    add_method(vm, AtomPool::k_toString, JSRegExpPrototype::toString);
+    add_method(vm, AtomPool::k_test, JSRegExpPrototype::re_test);
+    add_method(vm, AtomPool::k_exec, JSRegExpPrototype::re_exec);
     add_symbol_method(vm, AtomPool::k_sym_match, JSRegExpPrototype::re_exec);
     add_symbol_method(vm, AtomPool::k_sym_matchAll, JSRegExpPrototype::re_match_all);
     add_symbol_method(vm, AtomPool::k_sym_replace, JSRegExpPrototype::re_replace);
     add_symbol_method(vm, AtomPool::k_sym_search, JSRegExpPrototype::re_search);
     add_symbol_method(vm, AtomPool::k_sym_split, JSRegExpPrototype::re_split);
 
-    add_prop_trivial(vm, u"global", undefined, PFlag::V);
-    add_prop_trivial(vm, u"ignoreCase", undefined, PFlag::V);
-    add_prop_trivial(vm, u"multiline", undefined, PFlag::V);
-    add_prop_trivial(vm, u"dotAll", undefined, PFlag::V);
-    add_prop_trivial(vm, u"unicode", undefined, PFlag::V);
-    add_prop_trivial(vm, u"sticky", undefined, PFlag::V);
-    add_prop_trivial(vm, u"hasIndices", undefined, PFlag::V);
+    add_prop_trivial(vm, AtomPool::k_global, undefined, PFlag::V);
+    add_prop_trivial(vm, AtomPool::k_ignoreCase, undefined, PFlag::V);
+    add_prop_trivial(vm, AtomPool::k_multiline, undefined, PFlag::V);
+    add_prop_trivial(vm, AtomPool::k_dotAll, undefined, PFlag::V);
+    add_prop_trivial(vm, AtomPool::k_unicode, undefined, PFlag::V);
+    add_prop_trivial(vm, AtomPool::k_sticky, undefined, PFlag::V);
+    add_prop_trivial(vm, AtomPool::k_hasIndices, undefined, PFlag::V);
 
-    set_prop(vm, u"source", JSValue(vm.new_primitive_string(u"(?:)")));
-    set_prop(vm, u"flags", JSValue(vm.new_primitive_string(u"")));
+    set_prop(vm, JSAtom(AtomPool::k_source), JSValue(vm.new_primitive_string(u"(?:)")));
+    set_prop(vm, JSAtom(AtomPool::k_flags), JSValue(vm.new_primitive_string(u"")));
   }
 
   u16string_view get_class_name() override {
@@ -29,7 +29,7 @@ class JSString : public JSObject {
 
   void gc_mark_children() override {
     JSObject::gc_mark_children();
-    value->set_visited();
+    gc_mark_object(value);
   }
 
   bool gc_has_young_child(GCObject *oldgen_start) override {
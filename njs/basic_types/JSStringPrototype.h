@@ -25,22 +25,22 @@ using std::u16string;
 class JSStringPrototype : public JSObject {
  public:
   explicit JSStringPrototype(NjsVM &vm) : JSObject(CLS_STRING_PROTO) {
-    add_method(vm, u"valueOf", JSStringPrototype::valueOf);
-    add_method(vm, u"toString", JSStringPrototype::valueOf);
-    add_method(vm, u"charAt", JSStringPrototype::charAt);
-    add_method(vm, u"charCodeAt", JSStringPrototype::charCodeAt);
-    add_method(vm, u"toLowerCase", JSStringPrototype::toLowerCase);
-    add_method(vm, u"toUpperCase", JSStringPrototype::toUpperCase);
-    add_method(vm, u"toLocaleLowerCase", JSStringPrototype::toLowerCase);
-    add_method(vm, u"toLocaleUpperCase", JSStringPrototype::toUpperCase);
-    add_method(vm, u"substring", JSStringPrototype::substring);
-    add_method(vm, u"substr", JSStringPrototype::substr);
-    add_method(vm, u"concat", JSStringPrototype::concat);
-    add_method(vm, u"indexOf", JSStringPrototype::indexOf);
-    add_method(vm, u"lastIndexOf", JSStringPrototype::lastIndexOf);
-    add_method(vm, u"split", JSStringPrototype::split);
-    add_method(vm, u"match", JSStringPrototype::match);
-    add_method(vm, u"replace", JSStringPrototype::replace);
+    add_method(vm, AtomPool::k_valueOf, JSStringPrototype::valueOf);
+    add_method(vm, AtomPool::k_toString, JSStringPrototype::valueOf);
+    add_method(vm, AtomPool::k_charAt, JSStringPrototype::charAt);
+    add_method(vm, AtomPool::k_charCodeAt, JSStringPrototype::charCodeAt);
+    add_method(vm, AtomPool::k_toLowerCase, JSStringPrototype::toLowerCase);
+    add_method(vm, AtomPool::k_toUpperCase, JSStringPrototype::toUpperCase);
+    add_method(vm, AtomPool::k_toLocaleLowerCase, JSStringPrototype::toLowerCase);
+    add_method(vm, AtomPool::k_toLocaleUpperCase, JSStringPrototype::toUpperCase);
+    add_method(vm, AtomPool::k_substring, JSStringPrototype::substring);
+    add_method(vm, AtomPool::k_substr, JSStringPrototype::substr);
+    add_method(vm, AtomPool::k_concat, JSStringPrototype::concat);
+    add_method(vm, AtomPool::k_indexOf, JSStringPrototype::indexOf);
+    add_method(vm, AtomPool::k_lastIndexOf, JSStringPrototype::lastIndexOf);
+    add_method(vm, AtomPool::k_split, JSStringPrototype::split);
+    add_method(vm, AtomPool::k_match, JSStringPrototype::match);
+    add_method(vm, AtomPool::k_replace, JSStringPrototype::replace);
   }
 
   u16string_view get_class_name() override {
@@ -83,21 +83,21 @@ class JSStringPrototype : public JSObject {
   static Completion indexOf(vm_func_This_args_flags) {
     assert(args.size() > 0);
     REQUIRE_COERCIBLE(This);
-    u16string_view str = TRY_COMP(get_string_from_value(vm, This));
+    PrimitiveString *str = TRY_COMP(get_prim_string_from_value(vm, This));
     u16string_view pattern = TRYCC(js_to_string(vm, args[0])).as_prim_string->view();
 
     int64_t start = 0;
     if (args.size() > 1) {
       start = std::max(TRY_COMP(js_to_int64sat(vm, args[1])), int64_t(0));
     }
+    u32 pos = std::min(start, int64_t(str->length()));
 
     if (pattern.length() == 0) [[unlikely]] {
-      size_t res = std::min(str.size(), (size_t)start);
-      return JSFloat(res);
+      return JSFloat(pos);
     }
 
-    size_t find_res = str.find(pattern, start);
-    if (find_res != u16string::npos) {
+    u32 find_res = str->find(pattern.data(), pattern.size(), pos);
+    if (find_res != PrimitiveString::npos) {
       return JSFloat(find_res);
     } else {
       return JSFloat(-1);
@@ -107,66 +107,56 @@ class JSStringPrototype : public JSObject {
   static Completion lastIndexOf(vm_func_This_args_flags) {
     assert(args.size() > 0);
     REQUIRE_COERCIBLE(This);
-    u16string_view str = TRY_COMP(get_string_from_value(vm, This));
+    PrimitiveString *str = TRY_COMP(get_prim_string_from_value(vm, This));
     u16string_view pattern = TRYCC(js_to_string(vm, args[0])).as_prim_string->view();
 
     int64_t end = INT64_MAX;
     if (args.size() > 1) {
       end = std::min(TRY_COMP(js_to_int64sat(vm, args[1])), INT64_MAX);
     }
+    u32 pos = std::min((size_t)end, (size_t)str->length());
 
     if (pattern.length() == 0) [[unlikely]] {
-      size_t res = std::min(str.size(), (size_t)end);
-      return JSFloat(res);
+      return JSFloat(pos);
     }
 
-    size_t find_res = str.rfind(pattern, end);
-    if (find_res != u16string::npos) {
+    u32 find_res = str->rfind(pattern.data(), pattern.size(), pos);
+    if (find_res != PrimitiveString::npos) {
       return JSFloat(find_res);
     } else {
       return JSFloat(-1);
     }
   }
 
-  static vector<u16string_view> cpp_split(u16string_view str, u16string_view delimiter) {
-    vector<u16string_view> tokens;
-    if (delimiter.empty()) [[unlikely]] {
-      for (size_t i = 0; i < str.size(); i++) {
-        tokens.emplace_back(str.data() + i, 1);
-      }
-      return tokens;
-    }
-    size_t start = 0;
-    size_t end = str.find(delimiter);
-
-    while (end != u16string::npos) {
-      tokens.push_back(str.substr(start, end - start));
-      start = end + delimiter.length();
-      end = str.find(delimiter, start);
-    }
-
-    // Add the last token
-    tokens.emplace_back(str.substr(start));
-
-    return tokens;
-  }
-
   // TODO: should also support regexp.
   static Completion split(vm_func_This_args_flags) {
     REQUIRE_COERCIBLE(This);
-    u16string_view str = TRY_COMP(get_string_from_value(vm, This));
+    PrimitiveString *prim_str = TRY_COMP(get_prim_string_from_value(vm, This));
     auto *arr = vm.heap.new_object<JSArray>(vm, 0);
 
     if (args.empty() || args[0].is_undefined()) [[unlikely]] {
-      arr->push(vm, vm.new_primitive_string(str));
+      arr->push(vm, JSValue(prim_str));
     }
     else {
       auto *pattern = TRYCC(js_to_string(vm, args[0])).as_prim_string;
-      vector<u16string_view> split_res = cpp_split(str, pattern->view());
+      u16string_view delimiter = pattern->view();
+      u32 str_len = prim_str->length();
 
-      for (auto& substr : split_res) {
-        arr->push(vm, vm.new_primitive_string(substr));
+      // the long pieces are slices of the string.
+      if (delimiter.empty()) [[unlikely]] {
+        for (u32 i = 0; i < str_len; i++) {
+          arr->push(vm, JSValue(prim_str->substr(vm.heap, i, 1)));
+        }
+        return JSValue(arr);
       }
+      u32 start = 0;
+      u32 end = prim_str->find(delimiter.data(), delimiter.size());
+      while (end != PrimitiveString::npos) {
+        arr->push(vm, JSValue(prim_str->substr(vm.heap, start, end - start)));
+        start = end + delimiter.size();
+        end = prim_str->find(delimiter.data(), delimiter.size(), start);
+      }
+      arr->push(vm, JSValue(prim_str->substr(vm.heap, start)));
     }
     return JSValue(arr);
   }
@@ -217,30 +207,32 @@ class JSStringPrototype : public JSObject {
       }
     } else {
     arg0_is_string:
-      u16string_view str = TRYCC(js_to_string(vm, This)).as_prim_string->view();
+      PrimitiveString *prim_str = TRYCC(js_to_string(vm, This)).as_prim_string;
       JSValue pattern_val = TRYCC(js_to_string(vm, args[0]));
       u16string_view pattern = pattern_val.as_prim_string->view();
-      u16string res(str);
-
-      auto start_pos = res.find(pattern);
+      u32 start_pos = prim_str->find(pattern.data(), pattern.size());
+      // nothing replaced
+      if (start_pos == PrimitiveString::npos) {
+        return JSValue(prim_str);
+      }
 
-      if (start_pos != u16string::npos) {
-        // call a function to get the replacement
-        if (args[1].is_function()) {
-          JSValue argv[2] {pattern_val, JSFloat(start_pos)};
-          JSValue rep = TRYCC(vm.call_function(args[1], undefined, undefined, {argv, 2}));
-          u16string_view replacement = TRYCC(js_to_string(vm, rep)).as_prim_string->view();
+      u16string_view str = prim_str->view();
+      u16string res(str);
+      // call a function to get the replacement
+      if (args[1].is_function()) {
+        JSValue argv[2] {pattern_val, JSFloat(start_pos)};
+        JSValue rep = TRYCC(vm.call_function(args[1], undefined, undefined, {argv, 2}));
+        u16string_view replacement = TRYCC(js_to_string(vm, rep)).as_prim_string->view();
 
-          res.replace(start_pos, pattern.size(), replacement);
-        }
-        else {
-          u16string_view replacement = TRYCC(js_to_string(vm, args[1])).as_prim_string->view();
-          u16string_view matched(str.begin() + start_pos,
-                                 str.begin() + start_pos + pattern.size());
-          u16string populated = prepare_replacer_string(str, replacement, matched,
-                                                        start_pos, start_pos + pattern.size());
-          res.replace(start_pos, pattern.size(), populated);
-        }
+        res.replace(start_pos, pattern.size(), replacement);
+      }
+      else {
+        u16string_view replacement = TRYCC(js_to_string(vm, args[1])).as_prim_string->view();
+        u16string_view matched(str.begin() + start_pos,
+                               str.begin() + start_pos + pattern.size());
+        u16string populated = prepare_replacer_string(str, replacement, matched,
+                                                      start_pos, start_pos + pattern.size());
+        res.replace(start_pos, pattern.size(), populated);
       }
 
       return vm.new_primitive_string(res);
@@ -262,18 +254,14 @@ class JSStringPrototype : public JSObject {
 
   static Completion toLowerCase(vm_func_This_args_flags) {
     REQUIRE_COERCIBLE(This);
-    u16string_view str = TRY_COMP(get_string_from_value(vm, This));
-    u16string res(str);
-    std::transform(res.begin(), res.end(), res.begin(), character::to_lower_case);
-    return vm.new_primitive_string(res);
+    PrimitiveString *str = TRY_COMP(get_prim_string_from_value(vm, This));
+    return JSValue(str->change_case<false>(vm.heap, character::to_lower_case));
   }
 
   static Completion toUpperCase(vm_func_This_args_flags) {
     REQUIRE_COERCIBLE(This);
-    u16string_view str = TRY_COMP(get_string_from_value(vm, This));
-    u16string res(str);
-    std::transform(res.begin(), res.end(), res.begin(), character::to_upper_case);
-    return vm.new_primitive_string(res);
+    PrimitiveString *str = TRY_COMP(get_prim_string_from_value(vm, This));
+    return JSValue(str->change_case<true>(vm.heap, character::to_upper_case));
   }
 
   static Completion substring(vm_func_This_args_flags) {
@@ -112,7 +112,11 @@ void JSValue::to_json(u16string& output, NjsVM& vm) const {
       break;
     case STRING:
       output += u'"';
-      output += to_escaped_u16string(as_prim_string->view());
+      if (as_prim_string->is_one_byte()) {
+        append_escaped(output, as_prim_string->latin1_view());
+      } else {
+        append_escaped(output, as_prim_string->view());
+      }
       output += u'"';
       break;
     case ARRAY:
@@ -219,6 +219,11 @@ friend class NjsVM;
     return tag > NEED_GC_BEGIN;
   }
 
+  // Whether this value is an atom or a symbol, which must be marked by the major GC.
+  bool holds_atom() const {
+    return tag == JS_ATOM || tag == SYMBOL;
+  }
+
   template <class T>
   T *as_Object() const {
     return static_cast<T *>(as_object);
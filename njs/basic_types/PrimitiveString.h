@@ -1,116 +1,296 @@
 #ifndef NJS_PRIMITIVE_STRING_H
 #define NJS_PRIMITIVE_STRING_H
 
+#include <functional>
+#include <memory>
 #include <string>
+#include <string_view>
+#include <vector>
 #include "njs/gc/GCObject.h"
 #include "njs/gc/GCHeap.h"
 #include "njs/common/conversion_helper.h"
 #include "njs/common/common_def.h"
+#include "njs/basic_types/atom.h"
+#include "njs/utils/string_kernels.h"
 
 namespace njs {
 
 using std::u16string;
 using char16_traits = std::char_traits<char16_t>;
 
+// A string is flat (the characters are in `storage`), one-byte, a reference (the characters are
+// in memory owned by others, like the atom pool), a rope, or a slice.
+//
+// A one-byte string is a flat string whose characters are all Latin-1, stored in one byte each.
+// Most strings are ASCII, so this halves their memory and the bandwidth of copying and comparing
+// them. The operations on strings work on the bytes directly where they can, and a string is
+// only two-byte if one of its characters is not Latin-1. `view` widens a one-byte string into a
+// buffer that is valid as long as the view of a flat string is, that is, until the next
+// safepoint (where the GC may move the flat strings).
+//
+// A rope is the concatenation of two strings, which are kept in `storage` instead of being
+// copied, so that building a long string piece by piece does not copy it again and again. The
+// characters of a rope are copied into a buffer the first time they are needed (`view`), and
+// the rope then lets go of its two halves. The buffer is freed when the rope dies, so the ropes
+// are finalized by the GC.
+//
+// A slice is a substring that refers to the characters of its parent instead of copying them.
+// The parent is kept alive by the slice, so the short substrings are still copied, lest they
+// retain a long parent. The parent of a slice is never a rope or another slice.
+//
+// A string remembers its atom once it has been atomized (`NjsVM::str_to_atom`), so that using the
+// same string as a property key again (`obj[key]`) does not hash it again.
 struct PrimitiveString: public GCObject {
 
 friend class GCHeap;
 
+  constexpr static bool GC_NEEDS_FINALIZER = false;
+  // The concatenations shorter than this are copied.
+  constexpr static u32 ROPE_MIN_LENGTH = 256;
+  // The ropes deeper than this are flattened before being concatenated, so that a rope can be
+  // marked by the GC (which recurses into the children) without overflowing the stack.
+  constexpr static u32 MAX_ROPE_DEPTH = 512;
+  // The substrings shorter than this are copied.
+  constexpr static u32 SLICE_MIN_LENGTH = 32;
+  // The widened views are released at the next safepoint once they take more than this.
+  constexpr static size_t MAX_WIDE_VIEW_USAGE = 4 * 1024 * 1024;
+
   static inline uint64_t concat_count {0};
   static inline uint64_t append_count {0};
   static inline uint64_t fast_concat_count {0};
   static inline uint64_t fast_append_count {0};
   static inline uint64_t alloc_count {0};
   static inline uint64_t concat_length {0};
+  static inline uint64_t rope_count {0};
+  static inline uint64_t flatten_count {0};
+  static inline uint64_t slice_count {0};
+  static inline uint64_t one_byte_count {0};
+  static inline uint64_t widen_count {0};
+  static inline uint64_t atom_hit_count {0};
+
+  // memory used by the widened views of the one-byte strings, in bytes.
+  static inline size_t wide_view_usage {0};
 
   static constexpr u32 npos = UINT32_MAX;
+  // No string atom has this value (see `AtomPool::atomize`), and it is not an integer atom.
+  static constexpr u32 NO_ATOM = ATOM_STR_SYM_MAX;
 
   PrimitiveString(const PrimitiveString& other) = delete;
   PrimitiveString(PrimitiveString&& other) = delete;
   PrimitiveString& operator=(PrimitiveString&& other) = delete;
   PrimitiveString& operator=(const PrimitiveString& other) = delete;
 
+  ~PrimitiveString() override {
+    if (kind == Kind::FLAT_ROPE) delete[] str_ref;
+  }
+
+  // Return true if all the characters are Latin-1.
+  static bool is_latin1(const char16_t *str, size_t length) {
+    return string_kernels::is_latin1(str, length);
+  }
+
+  // Free the widened views of the one-byte strings. The views must not be in use.
+  static void release_wide_views() {
+    wide_views.clear();
+    wide_view_usage = 0;
+    wide_view_epoch += 1;
+  }
+
   std::string description() override {
     return "PrimitiveString(" + to_std_string() + ")";
   }
 
+  bool gc_scan_children(GCHeap& heap) override {
+    if (kind == Kind::SLICE) {
+      return heap.gc_visit_object(slice_parent()->parent);
+    }
+    if (kind != Kind::ROPE) return false;
+    bool child_young = false;
+    child_young |= heap.gc_visit_object(rope_children()->left);
+    child_young |= heap.gc_visit_object(rope_children()->right);
+    return child_young;
+  }
+
+  void gc_mark_children() override {
+    gc_mark_atom(atom);
+    if (kind == Kind::SLICE) {
+      gc_mark_object(slice_parent()->parent);
+      return;
+    }
+    if (kind != Kind::ROPE) return;
+    gc_mark_object(rope_children()->left);
+    gc_mark_object(rope_children()->right);
+  }
+
+  bool gc_has_young_child(GCObject *oldgen_start) override {
+    if (kind == Kind::SLICE) return slice_parent()->parent < oldgen_start;
+    if (kind != Kind::ROPE) return false;
+    return rope_children()->left < oldgen_start || rope_children()->right < oldgen_start;
+  }
+
   u16string_view view() const {
-    if (str_ref != nullptr) {
-      return {str_ref, (size_t)len};
-    } else {
-      return {storage, (size_t)len};
+    switch (kind) {
+      case Kind::FLAT:
+        return {storage, (size_t)len};
+      case Kind::ONE_BYTE:
+        if (wide_epoch != wide_view_epoch) {
+          const_cast<PrimitiveString *>(this)->widen();
+        }
+        return {str_ref, (size_t)len};
+      case Kind::SLICE:
+        // the parent may have been moved by the GC, so its address is not kept.
+        return slice_parent()->parent->view().substr(slice_parent()->offset, len);
+      case Kind::ROPE:
+        const_cast<PrimitiveString *>(this)->flatten();
+        return {str_ref, (size_t)len};
+      default:
+        return {str_ref, (size_t)len};
+    }
+  }
+
+  // Whether the characters are stored in one byte each (a one-byte string or a slice of it).
+  bool is_one_byte() const {
+    return kind == Kind::ONE_BYTE
+           || (kind == Kind::SLICE && slice_parent()->parent->kind == Kind::ONE_BYTE);
+  }
+
+  // The characters of a string for which `is_one_byte` is true.
+  std::string_view latin1_view() const {
+    assert(is_one_byte());
+    if (kind == Kind::ONE_BYTE) {
+      return {latin1_storage(), (size_t)len};
     }
+    return slice_parent()->parent->latin1_view().substr(slice_parent()->offset, len);
+  }
+
+  // StringToNumber, reading a one-byte string without widening it.
+  double to_number() const {
+    return is_one_byte() ? parse_double(latin1_view()) : parse_double(view());
+  }
+
+  bool is_rope() const {
+    return kind == Kind::ROPE;
+  }
+
+  // The atom of this string, or `NO_ATOM` if it has not been atomized.
+  u32 get_atom() const {
+    return atom;
+  }
+
+  void set_atom(u32 atom_of_str) {
+    atom = atom_of_str;
+  }
+
+  // The string is shared (by the caches of the VM), so it must not be appended to in place.
+  void disallow_reuse() {
+    cap = len + 1;
   }
 
   u16string to_std_u16string() const {
-    return u16string(view());
+    u16string res(len, 0);
+    write_to(res.data());
+    return res;
   }
 
   string to_std_string() const {
     return to_u8string(view());
   }
 
+  // Append the characters to `output` without widening a one-byte string into a view.
+  void append_to(u16string& output) const {
+    size_t old_size = output.size();
+    output.resize(old_size + len);
+    write_to(output.data() + old_size);
+  }
+
+  // Return a rope if the result is long, unless `str` can be appended in place.
   PrimitiveString* concat(GCHeap& heap, PrimitiveString *str) {
-    return concat(heap, str->data(), str->length());
+    u32 new_length = len + str->len;
+    bool may_reuse = get_ref_count() == 0 && new_length < cap;
+    if (new_length >= ROPE_MIN_LENGTH && not may_reuse) {
+      concat_count += 1;
+      concat_length += new_length;
+      if (rope_depth >= MAX_ROPE_DEPTH) flatten();
+      if (str->rope_depth >= MAX_ROPE_DEPTH) str->flatten();
+      return heap.new_rope_string(this, str);
+    }
+
+    concat_count += 1;
+    concat_length += new_length;
+    PrimitiveString *new_str = concat_impl(heap, may_reuse, str->len, str->latin1,
+      [str] (char *dest) { str->write_latin1_to(dest); },
+      [str] (char16_t *dest) { str->write_to(dest); });
+    fast_concat_count += new_str == this;
+    return new_str;
   }
 
   PrimitiveString* concat(GCHeap& heap, const char16_t* str, u32 length) {
     u32 new_length = len + length;
-    assert(new_length < UINT32_MAX);
-
     concat_count += 1;
     concat_length += new_length;
-    
-    PrimitiveString *new_str;
-    if (get_ref_count() == 0 && new_length < cap) {
-      fast_concat_count += 1;
-      new_str = this;
-    } else {
-      new_str = heap.new_prim_string(new_length);
-      std::memcpy(new_str->storage, view().data(), len * CHAR_SIZE);
-    }
-
-    std::memcpy(new_str->storage + len, str, length * CHAR_SIZE);
 
-    new_str->storage[new_length] = 0;
-    new_str->len = new_length;
+    bool may_reuse = get_ref_count() == 0 && new_length < cap;
+    PrimitiveString *new_str = concat_impl(heap, may_reuse, length, is_latin1(str, length),
+      [str, length] (char *dest) { narrow(str, length, dest); },
+      [str, length] (char16_t *dest) { std::memcpy(dest, str, length * CHAR_SIZE); });
+    fast_concat_count += new_str == this;
     return new_str;
   }
 
   PrimitiveString* append(GCHeap& heap, PrimitiveString *str) {
-    return append(heap, str->data(), str->length());
+    assert(get_ref_count() <= 1);
+    append_count += 1;
+
+    PrimitiveString *new_str = concat_impl(heap, true, str->len, str->latin1,
+      [str] (char *dest) { str->write_latin1_to(dest); },
+      [str] (char16_t *dest) { str->write_to(dest); });
+    fast_append_count += new_str == this;
+    return new_str;
   }
 
   PrimitiveString* append(GCHeap& heap, const char16_t* str, u32 length) {
-    u32 new_length = len + length;
-    assert(new_length < UINT32_MAX);
     assert(get_ref_count() <= 1);
     append_count += 1;
 
-    PrimitiveString *new_str;
-    if (new_length < cap) {
-      fast_append_count += 1;
-      new_str = this;
-    } else {
-      new_str = heap.new_prim_string(new_length);
-      std::memcpy(new_str->storage, view().data(), len * CHAR_SIZE);
-    }
-
-    std::memcpy(new_str->storage + len, str, length * CHAR_SIZE);
-
-    new_str->storage[new_length] = 0;
-    new_str->len = new_length;
+    PrimitiveString *new_str = concat_impl(heap, true, length, is_latin1(str, length),
+      [str, length] (char *dest) { narrow(str, length, dest); },
+      [str, length] (char16_t *dest) { std::memcpy(dest, str, length * CHAR_SIZE); });
+    fast_append_count += new_str == this;
     return new_str;
   }
 
-  PrimitiveString* substr(GCHeap& heap, u32 pos, u32 length = npos) const {
-    u16string_view this_str = view();
+  // Return a slice of this string if the substring is long.
+  PrimitiveString* substr(GCHeap& heap, u32 pos, u32 length = npos) {
+    if (kind == Kind::ROPE) flatten();
 
     pos = std::min(pos, len);
     length = std::min(length, len - pos);
 
+    if (length >= SLICE_MIN_LENGTH && length != len) {
+      if (kind == Kind::SLICE) {
+        return heap.new_slice_string(slice_parent()->parent, slice_parent()->offset + pos, length);
+      }
+      return heap.new_slice_string(this, pos, length);
+    }
+
+    if (is_one_byte()) {
+      PrimitiveString *sub_str = heap.new_one_byte_string(length);
+      std::memcpy(sub_str->latin1_storage(), latin1_view().data() + pos, length);
+      sub_str->latin1_storage()[length] = 0;
+      sub_str->len = length;
+      return sub_str;
+    }
+
+    u16string_view sub_view = view().substr(pos, length);
+    if (latin1) {
+      PrimitiveString *sub_str = heap.new_one_byte_string(length);
+      narrow(sub_view.data(), length, sub_str->latin1_storage());
+      sub_str->latin1_storage()[length] = 0;
+      sub_str->len = length;
+      return sub_str;
+    }
     PrimitiveString *sub_str = heap.new_prim_string(length);
-    std::memcpy(sub_str->storage, this_str.data() + pos, length * CHAR_SIZE);
+    std::memcpy(sub_str->storage, sub_view.data(), length * CHAR_SIZE);
 
     sub_str->storage[length] = 0;
     sub_str->len = length;
@@ -118,44 +298,80 @@ friend class GCHeap;
   }
 
   u32 find(char16_t ch, u32 pos = 0) const {
-    u16string_view this_str = view();
-
     if (pos >= len) return npos;
-    auto res = char16_traits::find(this_str.data() + pos, len - pos, ch);
-    return res ? res - this_str.data() : npos;
-  }
 
-  u32 find(const char16_t* str, u32 length, u32 pos = 0) const {
+    if (is_one_byte()) {
+      if (ch > 0xFF) return npos;
+      return to_pos(latin1_view().find(char(ch), pos));
+    }
+
     u16string_view this_str = view();
+    return to_pos(string_kernels::find_char(this_str.data() + pos, len - pos, ch), pos);
+  }
 
-    if (!str || pos >= len || length > len - pos) [[unlikely]] {
+  u32 find(const char16_t* str, u32 length, u32 pos = 0) const {
+    if (!str || pos > len || length > len - pos) [[unlikely]] {
       return npos;
     }
     if (length == 0) [[unlikely]] {
       return pos;
     }
 
-    const char16_t* data_start = this_str.data() + pos;
-    const char16_t* data_end = this_str.end();
-    const std::boyer_moore_searcher searcher(str, str + length);
-    const auto it = std::search(data_start, data_end, searcher);
+    if (is_one_byte()) {
+      if (not is_latin1(str, length)) return npos;
+      std::string pattern(length, 0);
+      narrow(str, length, pattern.data());
+      std::string_view this_str = latin1_view();
+      return to_pos(string_kernels::find(this_str.data() + pos, len - pos, pattern.data(), length),
+                    pos);
+    }
 
-    return it != data_end ? it - this_str.data() : npos;
+    u16string_view this_str = view();
+    return to_pos(string_kernels::find(this_str.data() + pos, len - pos, str, length), pos);
   }
 
   u32 rfind(const char16_t* str, u32 length, u32 pos = 0) const {
     if (!str) [[unlikely]] return npos;
 
-    u16string_view this_str = view();
-
     pos = std::min(pos, len);
     if (length == 0) [[unlikely]] return pos;
+    // the occurrence must start at `pos` at the latest.
+    size_t end = std::min(size_t(pos) + length, size_t(len));
+
+    if (is_one_byte()) {
+      if (not is_latin1(str, length)) return npos;
+      std::string pattern(length, 0);
+      narrow(str, length, pattern.data());
+      return to_pos(string_kernels::rfind(latin1_view().data(), end, pattern.data(), length));
+    }
+
+    return to_pos(string_kernels::rfind(view().data(), end, str, length));
+  }
 
-    const char16_t* data_start = this_str.data();
-    const char16_t* data_end = data_start + std::min(pos + length, len);
-    const auto it = std::find_end(data_start, data_end, str, str + length);
+  // Map the characters with `map_char` (`character::to_upper_case` or `to_lower_case`), except
+  // the runs of ASCII characters, which are mapped by a kernel. The result of a one-byte string is
+  // one-byte unless a character is mapped out of Latin-1.
+  template <bool UPPER>
+  PrimitiveString* change_case(GCHeap& heap, char16_t (*map_char)(char16_t)) {
+    if (is_one_byte()) {
+      PrimitiveString *new_str = heap.new_one_byte_string(len);
+      bool res_latin1 = true;
+      string_kernels::map_case<UPPER>(latin1_view().data(), len, new_str->latin1_storage(),
+        [map_char, &res_latin1] (char ch) {
+          char16_t res = map_char((uint8_t)ch);
+          res_latin1 &= res <= 0xFF;
+          return char(res);
+        });
+      if (res_latin1) {
+        new_str->latin1_storage()[len] = 0;
+        new_str->len = len;
+        return new_str;
+      }
+    }
 
-    return it != data_end ? it - data_start : npos;
+    u16string res = to_std_u16string();
+    string_kernels::map_case<UPPER>(res.data(), len, res.data(), map_char);
+    return heap.new_prim_string(res.data(), len);
   }
 
   PrimitiveString* replace(GCHeap& heap, u32 pos, u32 length, u16string_view replacement) {
@@ -189,14 +405,23 @@ friend class GCHeap;
   }
 
   char16_t operator[](size_t index) const {
+    if (kind == Kind::ONE_BYTE) {
+      return (uint8_t)latin1_storage()[index];
+    }
+    if (is_one_byte()) {
+      return (uint8_t)latin1_view()[index];
+    }
     return view()[index];
   }
 
   bool operator==(const PrimitiveString& other) const {
-    if (this->str_ref != nullptr && this->str_ref == other.str_ref) {
+    if (len != other.len) return false;
+    if (kind == Kind::REF && other.kind == Kind::REF && str_ref == other.str_ref) {
       return true;
     }
-    return this->view() == other.view();
+    return with_chars(other, [] (auto a, auto b) {
+      return string_kernels::equals(a.data(), a.size(), b.data(), b.size());
+    });
   }
 
   bool operator!=(const PrimitiveString& other) const {
@@ -204,19 +429,19 @@ friend class GCHeap;
   }
 
   bool operator<(const PrimitiveString& other) const {
-    return view() < other.view();
+    return compare(other) < 0;
   }
 
   bool operator>(const PrimitiveString& other) const {
-    return view() > other.view();
+    return compare(other) > 0;
   }
 
   bool operator<=(const PrimitiveString& other) const {
-    return view() <= other.view();
+    return compare(other) <= 0;
   }
 
   bool operator>=(const PrimitiveString& other) const {
-    return view() >= other.view();
+    return compare(other) >= 0;
   }
 
    u32 length() const {
@@ -224,7 +449,7 @@ friend class GCHeap;
    }
 
    const char16_t* data() const {
-     return str_ref == nullptr ? storage : str_ref;
+     return view().data();
    }
 
   bool empty() {
@@ -232,15 +457,224 @@ friend class GCHeap;
   }
 
  private:
+  enum class Kind: uint8_t {
+    FLAT,
+    // the characters are in `storage`, one byte each
+    ONE_BYTE,
+    REF,
+    // the characters are in `rope_children()`
+    ROPE,
+    // a rope that has been flattened into a buffer it owns (`str_ref`)
+    FLAT_ROPE,
+    // the characters are in the parent (`slice_parent()`)
+    SLICE,
+  };
+
+  struct RopeChildren {
+    PrimitiveString *left;
+    PrimitiveString *right;
+  };
+
+  struct SliceParent {
+    PrimitiveString *parent;
+    u32 offset;
+  };
+
+  static inline std::vector<std::unique_ptr<char16_t[]>> wide_views;
+  // The widened view of a one-byte string is valid if it was made in the current epoch.
+  static inline u32 wide_view_epoch {1};
+
   explicit PrimitiveString(u32 capacity) : cap(capacity) {
     alloc_count += 1;
   }
 
+  static void narrow(const char16_t *str, size_t length, char *dest) {
+    string_kernels::narrow(str, length, dest);
+  }
+
+  static void widen(std::string_view str, char16_t *dest) {
+    string_kernels::widen(str.data(), str.size(), dest);
+  }
+
+  // `start` is the position from which the search started.
+  static u32 to_pos(size_t pos, u32 start = 0) {
+    return pos == std::string_view::npos ? npos : start + pos;
+  }
+
+  char *latin1_storage() const {
+    return reinterpret_cast<char *>(const_cast<char16_t *>(storage));
+  }
+
+  RopeChildren *rope_children() const {
+    return reinterpret_cast<RopeChildren *>(const_cast<char16_t *>(storage));
+  }
+
+  SliceParent *slice_parent() const {
+    return reinterpret_cast<SliceParent *>(const_cast<char16_t *>(storage));
+  }
+
+  int compare(const PrimitiveString& other) const {
+    return with_chars(other, [] (auto a, auto b) {
+      return string_kernels::compare(a.data(), a.size(), b.data(), b.size());
+    });
+  }
+
+  // Call `func` with the characters of this string and `other`, in their own width, so that a
+  // one-byte string is not widened.
+  template <typename Func>
+  auto with_chars(const PrimitiveString& other, Func func) const
+      -> decltype(func(std::string_view(), std::string_view())) {
+    if (is_one_byte() && other.is_one_byte()) {
+      return func(latin1_view(), other.latin1_view());
+    } else if (is_one_byte()) {
+      return func(latin1_view(), other.view());
+    } else if (other.is_one_byte()) {
+      return func(view(), other.latin1_view());
+    }
+    return func(view(), other.view());
+  }
+
+  // Concatenate this string and `length` more characters, which are written by `write_latin1`
+  // or `write_wide`. The result is one-byte if both parts are Latin-1. This string is reused
+  // if `may_reuse` is true and it has room.
+  template <typename WriteLatin1, typename WriteWide>
+  PrimitiveString* concat_impl(GCHeap& heap, bool may_reuse, u32 length, bool rest_latin1,
+                               WriteLatin1 write_latin1, WriteWide write_wide) {
+    u32 new_length = len + length;
+    assert(new_length < UINT32_MAX);
+
+    PrimitiveString *new_str;
+    if (latin1 && rest_latin1) {
+      if (may_reuse && kind == Kind::ONE_BYTE && new_length < cap) {
+        new_str = this;
+        // the widened view and the atom are out of date.
+        wide_epoch = 0;
+        atom = NO_ATOM;
+      } else {
+        new_str = heap.new_one_byte_string(new_length);
+        write_latin1_to(new_str->latin1_storage());
+      }
+      write_latin1(new_str->latin1_storage() + len);
+      new_str->latin1_storage()[new_length] = 0;
+    } else {
+      if (may_reuse && kind == Kind::FLAT && new_length < cap) {
+        new_str = this;
+        atom = NO_ATOM;
+      } else {
+        // a rope is copied into a flat string that has room for the next appends.
+        new_str = heap.new_prim_string(new_length);
+        write_to(new_str->storage);
+      }
+      write_wide(new_str->storage + len);
+      new_str->storage[new_length] = 0;
+      new_str->latin1 = false;
+    }
+
+    new_str->len = new_length;
+    return new_str;
+  }
+
+  void init_rope(PrimitiveString *left, PrimitiveString *right) {
+    assert(left->len + right->len < UINT32_MAX);
+    rope_count += 1;
+    kind = Kind::ROPE;
+    latin1 = left->latin1 && right->latin1;
+    len = left->len + right->len;
+    rope_depth = std::max(left->rope_depth, right->rope_depth) + 1;
+    *rope_children() = RopeChildren { .left = left, .right = right };
+  }
+
+  void init_slice(PrimitiveString *parent, u32 offset, u32 length) {
+    assert(parent->kind != Kind::ROPE && parent->kind != Kind::SLICE);
+    assert(offset + length <= parent->len);
+    slice_count += 1;
+    kind = Kind::SLICE;
+    latin1 = parent->latin1;
+    len = length;
+    *slice_parent() = SliceParent { .parent = parent, .offset = offset };
+  }
+
+  // Copy the characters of the rope into a buffer, and drop the children.
+  void flatten() {
+    if (kind != Kind::ROPE) return;
+    flatten_count += 1;
+    auto *buffer = new char16_t[len + 1];
+    write_to(buffer);
+    buffer[len] = 0;
+    str_ref = buffer;
+    kind = Kind::FLAT_ROPE;
+    rope_depth = 0;
+    *rope_children() = RopeChildren { .left = nullptr, .right = nullptr };
+  }
+
+  // Make the UTF-16 view of a one-byte string.
+  void widen() {
+    widen_count += 1;
+    auto& buffer = wide_views.emplace_back(new char16_t[len + 1]);
+    widen(latin1_view(), buffer.get());
+    buffer[len] = 0;
+    wide_view_usage += (len + 1) * CHAR_SIZE;
+    str_ref = buffer.get();
+    wide_epoch = wide_view_epoch;
+  }
+
+  // Copy the characters of a string that is not a rope to `dest`.
+  void write_leaf_to(char16_t *dest) const {
+    if (is_one_byte()) {
+      widen(latin1_view(), dest);
+    } else {
+      std::memcpy(dest, view().data(), len * CHAR_SIZE);
+    }
+  }
+
+  void write_leaf_latin1_to(char *dest) const {
+    if (is_one_byte()) {
+      std::memcpy(dest, latin1_view().data(), len);
+    } else {
+      narrow(view().data(), len, dest);
+    }
+  }
+
+  // Copy the characters to `dest` without flattening the ropes, from left to right.
+  void write_to(char16_t *dest) const {
+    write_to_impl(dest, [] (const PrimitiveString *leaf, char16_t *dest) {
+      leaf->write_leaf_to(dest);
+    });
+  }
+
+  // Copy the characters, which must be Latin-1, to `dest` one byte each.
+  void write_latin1_to(char *dest) const {
+    assert(latin1);
+    write_to_impl(dest, [] (const PrimitiveString *leaf, char *dest) {
+      leaf->write_leaf_latin1_to(dest);
+    });
+  }
+
+  template <typename CharT, typename WriteLeaf>
+  void write_to_impl(CharT *dest, WriteLeaf write_leaf) const {
+    if (kind != Kind::ROPE) {
+      write_leaf(this, dest);
+      return;
+    }
+    // The right child is pushed first, so that the left one is popped first. The stack is at
+    // most as deep as the rope.
+    const PrimitiveString *stack[MAX_ROPE_DEPTH + 1];
+    u32 stack_size = 0;
+    stack[stack_size++] = this;
+    while (stack_size != 0) {
+      const PrimitiveString *node = stack[--stack_size];
+      if (node->kind == Kind::ROPE) {
+        stack[stack_size++] = node->rope_children()->right;
+        stack[stack_size++] = node->rope_children()->left;
+      } else {
+        write_leaf(node, dest);
+        dest += node->len;
+      }
+    }
+  }
+
   void init(u16string_view str) {
-    assert(str.size() < UINT32_MAX);
-    len = str.size();
-    std::memcpy(storage, str.data(), len * CHAR_SIZE);
-    storage[len] = 0;
+    init(str.data(), str.size());
   }
 
   void init(const char16_t *str, size_t length) {
@@ -250,14 +684,33 @@ friend class GCHeap;
     storage[len] = 0;
   }
 
-  void init_with_ref(const char16_t *str, size_t length) {
+  void init_latin1(const char16_t *str, size_t length) {
+    assert(kind == Kind::ONE_BYTE);
+    assert(length < UINT32_MAX);
+    len = length;
+    narrow(str, length, latin1_storage());
+    latin1_storage()[len] = 0;
+  }
+
+  void init_with_ref(const char16_t *str, size_t length, bool is_latin1) {
     assert(length < UINT32_MAX);
+    kind = Kind::REF;
+    latin1 = is_latin1;
     len = length;
     str_ref = str;
   }
 
-  u32 len;
+  u32 len {0};
   u32 cap;
+  Kind kind {Kind::FLAT};
+  // Whether all the characters are Latin-1. This is always true for the one-byte strings, and
+  // is false when unknown.
+  bool latin1 {false};
+  // 0 if this is not a rope
+  u16 rope_depth {0};
+  // the epoch of the widened view in `str_ref` of a one-byte string.
+  u32 wide_epoch {0};
+  u32 atom {NO_ATOM};
   const char16_t *str_ref {nullptr};
   char16_t storage[0];
 };
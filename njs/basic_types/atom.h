@@ -26,6 +26,18 @@ inline bool atom_is_str_sym(u32 atom) {
   return !atom_is_int(atom);
 }
 
+// The marks of the atoms while a major GC is marking, one byte for each atom (see
+// `AtomPool::begin_mark`). Null at other times, so that marking an atom outside of a major GC
+// does nothing.
+inline uint8_t *gc_atom_marks {nullptr};
+inline u32 gc_atom_mark_count {0};
+
+// Mark an atom as reachable, so that it is not freed by `AtomPool::sweep`. Every object, string
+// and value that holds an atom must mark it in its `gc_mark_children`.
+inline void gc_mark_atom(u32 atom) {
+  if (atom < gc_atom_mark_count) gc_atom_marks[atom] = 1;
+}
+
 }
 
 #endif
\ No newline at end of file
@@ -30,13 +30,11 @@ Completion js_to_string(NjsVM &vm, JSValue val, bool to_prop_key) {
     case JSValue::BOOLEAN:
       return vm.get_string_const(val.as_bool ? AtomPool::k_true : AtomPool::k_false);
     case JSValue::NUM_UINT32:
-      return vm.new_primitive_string(to_u16string(val.as_u32));
+      return vm.u32_to_string(val.as_u32);
     case JSValue::NUM_INT32:
-      return vm.new_primitive_string(to_u16string(val.as_i32));
-    case JSValue::NUM_FLOAT: {
-      u16string str = double_to_u16string(val.as_f64);
-      return vm.new_primitive_string(str);
-    }
+      return val.as_i32 >= 0 ? vm.u32_to_string(val.as_i32) : vm.number_to_string(val.as_i32);
+    case JSValue::NUM_FLOAT:
+      return vm.number_to_string(val.as_f64);
     case JSValue::STRING:
       return val;
     default:
@@ -142,11 +140,11 @@ Completion js_to_property_key(NjsVM &vm, JSValue val) {
       }
     }
     case JSValue::STRING:
-      return JSAtom(vm.str_to_atom(val.as_prim_string->view()));
+      return JSAtom(vm.str_to_atom(val.as_prim_string));
     default: {
       JSValue str = TRYCC(js_to_string(vm, val, true));
       assert(str.is_prim_string());
-      return JSAtom(vm.str_to_atom(str.as_prim_string->view()));
+      return JSAtom(vm.str_to_atom(str.as_prim_string));
     }
   }
 }
@@ -176,7 +174,7 @@ ErrorOr<double> js_to_number(NjsVM &vm, JSValue val) {
     case JSValue::SYMBOL:
       return vm.build_error(JS_TYPE_ERROR, u"TypeError");
     case JSValue::STRING:
-      return parse_double(val.as_prim_string->view());
+      return val.as_prim_string->to_number();
     default:
       if (val.is_object()) {
         JSValue prim = TRY_ERR(val.as_object->to_primitive(vm, HINT_NUMBER));
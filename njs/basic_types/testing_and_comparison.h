@@ -45,10 +45,10 @@ inline ErrorOr<bool> abstract_equals(NjsVM& vm, JSValue lhs, JSValue rhs) {
     return strict_equals(vm, lhs, rhs);
   }
   if (lhs.is_float64() && rhs.is_prim_string()) {
-    return lhs.as_f64 == parse_double(rhs.as_prim_string->view());
+    return lhs.as_f64 == rhs.as_prim_string->to_number();
   }
   else if (lhs.is_prim_string() && rhs.is_float64()) {
-    return rhs.as_f64 == parse_double(lhs.as_prim_string->view());
+    return rhs.as_f64 == lhs.as_prim_string->to_number();
   }
   else if (lhs.is_nil() && rhs.is_nil()) {
     return true;
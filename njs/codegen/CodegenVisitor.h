@@ -7,6 +7,7 @@
 #include <string>
 #include <functional>
 #include "Scope.h"
+#include "RootMapBuilder.h"
 #include "njs/global_var.h"
 #include "njs/basic_types/JSFunction.h"
 #include "njs/common/AtomPool.h"
@@ -19,6 +20,7 @@
 #include "njs/include/libregexp/lre_helper.h"
 #include "njs/parser/ast.h"
 #include "njs/utils/Timer.h"
+#include "njs/utils/Tracer.h"
 #include "njs/utils/helper.h"
 #include "njs/vm/Instruction.h"
 
@@ -51,14 +53,20 @@ class CodegenVisitor {
     push_scope(prog->scope.get());
     emit(OpType::init);
     visit_program_or_function_body(*prog);
+    fix_noderef_pushes();
 
     if (Global::enable_optimization) {
       Timer timer("optimized");
+      TraceScope trace("compile", "optimize");
       optimize();
       timer.end();
     }
 
     check_bytecode();
+    {
+      TraceScope trace("compile", "build root maps");
+      build_root_maps();
+    }
 
     if (!Global::show_codegen_result) return;
     std::cout << "================ codegen result ================\n\n";
@@ -81,6 +89,7 @@ class CodegenVisitor {
                 << " stack_size: " << std::setw(3) << meta.stack_size
                 << " bc_begin: " << meta.bytecode_start
                 << " bc_end: " << meta.bytecode_end
+                << " safepoints: " << meta.root_map.pcs.size()
                 << '\n';
 
       std::cout << "catch table:\n";
@@ -197,6 +206,7 @@ class CodegenVisitor {
           inst.operand.two[0] += pos_moved[inst.operand.two[0]];
         }
         bytecode[new_inst_ptr] = inst;
+        bytecode_line[new_inst_ptr] = bytecode_line[i];
         new_inst_ptr += 1;
       }
     }
@@ -205,6 +215,8 @@ class CodegenVisitor {
       auto &meta = *m;
       if (meta.is_native) continue;
       meta.bytecode_start += pos_moved[meta.bytecode_start];
+      meta.bytecode_end += meta.bytecode_end < len ? pos_moved[meta.bytecode_end]
+                                                   : -removed_inst_cnt;
 
       for (auto& entry : meta.catch_table) {
         entry.start_pos += pos_moved[entry.start_pos];
@@ -220,6 +232,16 @@ class CodegenVisitor {
     }
 
     bytecode.resize(new_inst_ptr);
+    bytecode_line.resize(new_inst_ptr);
+  }
+
+  // Must be done after the bytecode is optimized.
+  void build_root_maps() {
+    RootMapBuilder builder(bytecode, func_meta);
+    for (auto& meta : func_meta) {
+      if (meta->is_native) continue;
+      builder.build(*meta);
+    }
   }
 
   void check_bytecode() {
@@ -236,6 +258,12 @@ class CodegenVisitor {
   }
 
   void visit(ASTNode *node) {
+    // the instructions get the line of the innermost node that has one.
+    u32 outer_line = curr_line;
+    if (node->source_start().line != 0) {
+      curr_line = node->source_start().line;
+    }
+
     switch (node->type) {
       case ASTNode::PROGRAM:
       case ASTNode::FUNC_BODY:
@@ -353,9 +381,14 @@ class CodegenVisitor {
       default:
         std::cout << node->description() << " not supported yet" << '\n';
     }
+    curr_line = outer_line;
   }
 
   void visit_single_statement(ASTNode *stmt) {
+    u32 outer_line = curr_line;
+    if (stmt->source_start().line != 0) {
+      curr_line = stmt->source_start().line;
+    }
     if (stmt->is(ASTNode::EXPR_ASSIGN)) {
       visit_assignment_expr(*stmt->as<AssignmentExpr>(), false, false);
     } else if (stmt->is(ASTNode::EXPR_UNARY)) {
@@ -367,6 +400,7 @@ class CodegenVisitor {
         emit(OpType::pop_drop);
       }
     }
+    curr_line = outer_line;
   }
 
   void visit_program_or_function_body(ProgramOrFunctionBody& program) {
@@ -429,6 +463,7 @@ class CodegenVisitor {
 
     ProgramOrFunctionBody *body = func.body->as_func_body();
     u32 func_start_pos = bytecode_pos();
+    u32 outer_line = std::exchange(curr_line, func.source_start().line);
     push_scope(body->scope.get());
     scope().function_ast = &func;
 
@@ -478,6 +513,7 @@ class CodegenVisitor {
 
     func.meta_index = add_function_meta(meta);
     pop_scope();
+    curr_line = outer_line;
   }
 
   void visit_comma_expr(Expression& expr) {
@@ -489,11 +525,12 @@ class CodegenVisitor {
 
     // don't pop the result of the last element. It's the result of the comma expression.
     bytecode.pop_back();
+    bytecode_line.pop_back();
     scope().update_stack_usage(1);
   }
 
   void visit_function(Function& func) {
-    emit(OpType::make_func, (int)func.meta_index);
+    emit(OpType::make_func, (int)func.meta_index, new_alloc_site());
   }
 
   void visit_unary_expr(UnaryExpr& expr, bool need_value = true) {
@@ -623,7 +660,7 @@ class CodegenVisitor {
       visit(expr.lhs);
       visit(expr.rhs);
       switch (expr.op.type) {
-        case Token::ADD: emit(OpType::add); break;
+        case Token::ADD: emit(OpType::add, new_alloc_site()); break;
         case Token::SUB: emit(OpType::sub); break;
         case Token::MUL: emit(OpType::mul); break;
         case Token::DIV: emit(OpType::div); break;
@@ -744,7 +781,11 @@ class CodegenVisitor {
           case Token::MOD_ASSIGN: {
             auto diff = assign_op - Token::ADD_ASSIGN;
             auto op = static_cast<OpType>(static_cast<int>(OpType::add) + diff);
-            emit(op);
+            if (op == OpType::add) {
+              emit(op, new_alloc_site());
+            } else {
+              emit(op);
+            }
             break;
           }
           case Token::LSH_ASSIGN:
@@ -782,8 +823,7 @@ class CodegenVisitor {
           OpType op = assign_op == Token::ADD_ASSIGN ? OpType::inc : OpType::dec;
           emit(op, scope_type_int(lhs_sym.storage_scope), lhs_sym.get_index());
           if (need_value) {
-            emit_push(lhs_sym.storage_scope, lhs_sym.get_index(),
-                      false, lhs_sym.original_symbol->is_captured);
+            emit_push(lhs_sym.storage_scope, lhs_sym.get_index(), false, lhs_sym.original_symbol);
           }
         }
         else if (assign_op == Token::ADD_ASSIGN) {
@@ -838,7 +878,7 @@ class CodegenVisitor {
   }
 
   void visit_object_literal(ObjectLiteral& obj_lit) {
-    emit(OpType::make_obj);
+    emit(OpType::make_obj, new_alloc_site());
     for (auto& prop : obj_lit.properties) {
       // push the key into the stack
       emit(OpType::push_atom, (int)add_const(prop.key));
@@ -854,7 +894,7 @@ class CodegenVisitor {
   }
 
   void visit_array_literal(ArrayLiteral& array_lit) {
-    emit(OpType::make_array, (int)array_lit.len);
+    emit(OpType::make_array, (int)array_lit.len, new_alloc_site());
 
     for (auto& [idx, element] : array_lit.elements) {
       if (element) {
@@ -953,7 +993,7 @@ class CodegenVisitor {
         symbol.not_found() || (symbol.def_scope == ScopeType::GLOBAL && !symbol.is_let_or_const());
     if (not use_dynamic) {
       emit_push(symbol.storage_scope, symbol.get_index(),
-                symbol.is_let_or_const(), symbol.original_symbol->is_captured);
+                symbol.is_let_or_const(), symbol.original_symbol);
     } else {
       u32 atom = atom_pool.atomize(id.get_source());
       emit(no_throw ? OpType::dyn_get_var_undef : OpType::dyn_get_var, atom);
@@ -1915,7 +1955,7 @@ class CodegenVisitor {
     if (expr.callee->is_identifier()) {
       visit_identifier(*expr.callee);
       scope().update_stack_usage(1);
-      emit(OpType::js_new, 0);
+      emit(OpType::js_new, 0, new_alloc_site());
       scope().update_stack_usage(-1);
     }
     else if (expr.callee->is_lhs_expr()) {
@@ -1926,7 +1966,7 @@ class CodegenVisitor {
         arg_count = lhs_expr.postfixs.back().subtree.args_expr->arg_count();
       }
       scope().update_stack_usage(1);
-      emit(OpType::js_new, arg_count);
+      emit(OpType::js_new, arg_count, new_alloc_site());
       scope().update_stack_usage(-arg_count - 1);
     }
     else {
@@ -1959,22 +1999,25 @@ class CodegenVisitor {
   u32 emit(OpType inst_type, Args&&...args) {
     update_stack_usage_common(inst_type);
     bytecode.emplace_back(inst_type, std::forward<Args>(args)...);
+    bytecode_line.push_back(curr_line);
     return bytecode.size() - 1;
   }
 
   template <typename... Args>
   u32 emit_keep_stack(OpType inst_type, Args&&...args) {
     bytecode.emplace_back(inst_type, std::forward<Args>(args)...);
+    bytecode_line.push_back(curr_line);
     return bytecode.size() - 1;
   }
 
   u32 emit(Instruction inst) {
     update_stack_usage_common(inst.op_type);
     bytecode.push_back(inst);
+    bytecode_line.push_back(curr_line);
     return bytecode.size() - 1;
   }
 
-  u32 emit_push(ScopeType scope_type, u32 index, bool check, bool captured) {
+  u32 emit_push(ScopeType scope_type, u32 index, bool check, SymbolRecord *symbol) {
     scope().update_stack_usage(1);
     OpType op;
     switch (scope_type) {
@@ -1982,7 +2025,10 @@ class CodegenVisitor {
         op =  OpType::push_global;
         break;
       case ScopeType::FUNC:
-        op = captured ? OpType::push_local : OpType::push_local_noderef;
+        op = symbol->is_captured ? OpType::push_local : OpType::push_local_noderef;
+        if (not symbol->is_captured) {
+          noderef_pushes.emplace_back(bytecode_pos(), symbol);
+        }
         break;
       case ScopeType::FUNC_PARAM:
         op = OpType::push_arg;
@@ -1995,9 +2041,23 @@ class CodegenVisitor {
     }
     op = static_cast<OpType>(static_cast<int>(op) + (int)check);
     bytecode.emplace_back(op, index);
+    bytecode_line.push_back(curr_line);
     return bytecode.size() - 1;
   }
 
+  // A variable is only known to be captured when the closure that captures it is generated, which
+  // may be after some of the pushes of the variable (e.g. in a loop condition). These pushes must
+  // dereference the variable too.
+  void fix_noderef_pushes() {
+    for (auto [pos, symbol] : noderef_pushes) {
+      if (not symbol->is_captured) continue;
+      Instruction& inst = bytecode[pos];
+      inst.op_type = inst.op_type == OpType::push_local_noderef ? OpType::push_local
+                                                                : OpType::push_local_check;
+    }
+    noderef_pushes.clear();
+  }
+
   void update_stack_usage_common(OpType inst_type) {
     int diff = Instruction::get_stack_usage(inst_type);
     scope().update_stack_usage(diff);
@@ -2034,14 +2094,28 @@ class CodegenVisitor {
 
   u32 bytecode_pos() { return bytecode.size(); }
 
+  // Allocation sites are used by the GC to find the objects that tend to live long.
+  // Return 0 (unknown site) when the ids run out.
+  int new_alloc_site() {
+    if (alloc_site_count == UINT16_MAX) return 0;
+    alloc_site_count += 1;
+    return alloc_site_count;
+  }
+
   std::vector<Scope *> scope_chain;
   std::vector<Instruction> bytecode;
+  // the source line of each instruction
+  std::vector<u32> bytecode_line;
+  u32 curr_line {0};
+  // (position, variable) of the pushes of the variables not captured yet
+  std::vector<std::pair<u32, SymbolRecord *>> noderef_pushes;
   SmallVector<CodegenError, 10> errors;
 
   // for constant
   AtomPool atom_pool;
   SmallVector<double, 10> num_list;
   vector<unique_ptr<JSFunctionMeta>> func_meta;
+  u32 alloc_site_count {0};
 
   inline static auto _ = [] {};
 };
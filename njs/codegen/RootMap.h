@@ -0,0 +1,38 @@
+#ifndef NJS_ROOT_MAP_H
+#define NJS_ROOT_MAP_H
+
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+
+namespace njs {
+
+using u32 = uint32_t;
+
+// The live slots of a function frame at its safepoints, which are the instructions that may
+// be executing while a GC runs. Slot `i` is the argument `i` if `i < param_count`, otherwise the
+// local variable `i - param_count`. The operand stack is not covered: all the values below `sp`
+// are live.
+struct RootMap {
+  // Return the bitmap of the live slots at the instruction `pc`, or nullptr if `pc` is not
+  // a safepoint.
+  const uint64_t *find(u32 pc) const {
+    auto iter = std::lower_bound(pcs.begin(), pcs.end(), pc);
+    if (iter == pcs.end() || *iter != pc) return nullptr;
+    return bits.data() + (iter - pcs.begin()) * word_cnt;
+  }
+
+  static bool slot_live(const uint64_t *map, u32 slot) {
+    return map[slot / 64] & (uint64_t(1) << (slot % 64));
+  }
+
+  // in increasing order
+  std::vector<u32> pcs;
+  // `word_cnt` words for each safepoint
+  std::vector<uint64_t> bits;
+  u32 word_cnt {0};
+};
+
+} // namespace njs
+
+#endif // NJS_ROOT_MAP_H
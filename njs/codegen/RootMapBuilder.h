@@ -0,0 +1,347 @@
+#ifndef NJS_ROOT_MAP_BUILDER_H
+#define NJS_ROOT_MAP_BUILDER_H
+
+#include <cstdint>
+#include <vector>
+#include <memory>
+#include "RootMap.h"
+#include "njs/basic_types/JSFunctionMeta.h"
+#include "njs/common/enums.h"
+#include "njs/vm/Instruction.h"
+
+namespace njs {
+
+using std::vector;
+using std::unique_ptr;
+
+// Builds the root map of a function with a backward liveness analysis over its bytecode.
+//
+// A slot is live at an instruction if it may be read before it is overwritten. The analysis is
+// conservative: the `catch` handlers are successors of every instruction in their ranges, and
+// a `proc_ret` may return after any `proc_call`. Slots captured by closures hold a heap value
+// that is written through, so writing them counts as a read.
+class RootMapBuilder {
+ public:
+  RootMapBuilder(const vector<Instruction>& bytecode,
+                 const vector<unique_ptr<JSFunctionMeta>>& func_meta)
+      : bytecode(bytecode), func_meta(func_meta), index_of_pc(bytecode.size(), NOT_VISITED) {}
+
+  void build(JSFunctionMeta& meta) {
+    param_cnt = meta.param_count;
+    slot_cnt = param_cnt + meta.local_var_count;
+    word_cnt = (slot_cnt + 63) / 64;
+    if (slot_cnt == 0) return;
+
+    find_instructions(meta);
+    find_captured_slots();
+    compute_use_def();
+    solve();
+    emit_root_map(meta.root_map);
+
+    for (u32 pc : pcs) {
+      index_of_pc[pc] = NOT_VISITED;
+    }
+  }
+
+  // Return true if `op` may call into JavaScript code (or the GC) while its frame is on the stack.
+  static bool is_safepoint(OpType op) {
+    switch (op) {
+      case OpType::call:
+      case OpType::js_new:
+      case OpType::get_prop_atom:
+      case OpType::get_prop_atom2:
+      case OpType::get_prop_index:
+      case OpType::get_prop_index2:
+      case OpType::set_prop_atom:
+      case OpType::set_prop_index:
+      case OpType::dyn_get_var:
+      case OpType::dyn_get_var_undef:
+      case OpType::dyn_set_var:
+      case OpType::add:
+      case OpType::sub:
+      case OpType::mul:
+      case OpType::div:
+      case OpType::mod:
+      case OpType::neg:
+      case OpType::bits_and:
+      case OpType::bits_or:
+      case OpType::bits_xor:
+      case OpType::bits_not:
+      case OpType::lsh:
+      case OpType::lshi:
+      case OpType::rsh:
+      case OpType::rshi:
+      case OpType::ursh:
+      case OpType::urshi:
+      case OpType::gt:
+      case OpType::lt:
+      case OpType::ge:
+      case OpType::le:
+      case OpType::ne:
+      case OpType::eq:
+      case OpType::add_assign:
+      case OpType::add_assign_keep:
+      case OpType::add_to_left:
+      case OpType::add_props:
+      case OpType::add_elements:
+      case OpType::for_in_init:
+      case OpType::for_of_init:
+      case OpType::for_of_next:
+      case OpType::js_in:
+      case OpType::js_instanceof:
+      case OpType::js_delete:
+      case OpType::js_to_number:
+        return true;
+      default:
+        return false;
+    }
+  }
+
+ private:
+  constexpr static u32 NOT_VISITED = UINT32_MAX;
+
+  // Collect the instructions reachable from the start of the function, and their successors.
+  void find_instructions(JSFunctionMeta& meta) {
+    pcs.clear();
+    succ.clear();
+    proc_call_pcs.clear();
+
+    vector<u32> work {meta.bytecode_start};
+    index_of_pc[meta.bytecode_start] = 0;
+    pcs.push_back(meta.bytecode_start);
+    succ.emplace_back();
+
+    auto add_succ = [&, this] (u32 index, u32 pc) {
+      if (index_of_pc[pc] == NOT_VISITED) {
+        index_of_pc[pc] = pcs.size();
+        pcs.push_back(pc);
+        succ.emplace_back();
+        work.push_back(pc);
+      }
+      succ[index].push_back(pc);
+    };
+
+    while (not work.empty()) {
+      u32 pc = work.back();
+      work.pop_back();
+      u32 index = index_of_pc[pc];
+      Instruction inst = bytecode[pc];
+
+      switch (inst.op_type) {
+        case OpType::ret:
+        case OpType::ret_undef:
+        case OpType::ret_err:
+        case OpType::halt:
+        case OpType::halt_err:
+        case OpType::proc_ret:
+          break;
+        case OpType::jmp:
+          add_succ(index, inst.operand.two[0]);
+          break;
+        case OpType::jmp_cond:
+        case OpType::jmp_cond_pop:
+          add_succ(index, inst.operand.two[0]);
+          add_succ(index, inst.operand.two[1]);
+          break;
+        case OpType::proc_call:
+          proc_call_pcs.push_back(pc);
+          add_succ(index, inst.operand.two[0]);
+          add_succ(index, pc + 1);
+          break;
+        default:
+          if (inst.is_jump_single_target()) {
+            add_succ(index, inst.operand.two[0]);
+          }
+          add_succ(index, pc + 1);
+      }
+
+      // any instruction may throw
+      for (auto& entry : meta.catch_table) {
+        if (entry.range_include(pc)) {
+          add_succ(index, entry.goto_pos);
+        }
+      }
+    }
+
+    // a procedure returns to the instruction after the one that calls it.
+    for (u32 pc : pcs) {
+      if (bytecode[pc].op_type != OpType::proc_ret) continue;
+      for (u32 call_pc : proc_call_pcs) {
+        succ[index_of_pc[pc]].push_back(call_pc + 1);
+      }
+    }
+  }
+
+  // Return the slot of a variable, or -1 if it's not in the frame.
+  int slot_of(ScopeType scope, int index) {
+    if (scope == ScopeType::FUNC) {
+      return param_cnt + index;
+    } else if (scope == ScopeType::FUNC_PARAM && index < int(param_cnt)) {
+      return index;
+    }
+    return -1;
+  }
+
+  void find_captured_slots() {
+    captured.assign(slot_cnt, false);
+    for (u32 pc : pcs) {
+      const Instruction& inst = bytecode[pc];
+      if (inst.op_type != OpType::make_func) continue;
+      for (auto& entry : func_meta[inst.operand.two[0]]->capture_list) {
+        int slot = slot_of(entry.scope_type, entry.index);
+        if (slot >= 0) captured[slot] = true;
+      }
+    }
+  }
+
+  void compute_use_def() {
+    size_t size = pcs.size() * word_cnt;
+    use.assign(size, 0);
+    def.assign(size, 0);
+
+    for (u32 i = 0; i < pcs.size(); i++) {
+      const Instruction& inst = bytecode[pcs[i]];
+      int opr1 = inst.operand.two[0];
+      int opr2 = inst.operand.two[1];
+
+      auto read = [&, this] (ScopeType scope, int index) {
+        int slot = slot_of(scope, index);
+        if (slot >= 0) set_bit(use, i, slot);
+      };
+      // writes through the heap value if the variable is captured.
+      auto write = [&, this] (ScopeType scope, int index) {
+        int slot = slot_of(scope, index);
+        if (slot < 0) return;
+        set_bit(captured[slot] ? use : def, i, slot);
+      };
+      // overwrites the slot itself.
+      auto overwrite = [&, this] (int begin, int end) {
+        for (int index = begin; index < end; index++) {
+          int slot = slot_of(ScopeType::FUNC, index);
+          if (slot >= 0) set_bit(def, i, slot);
+        }
+      };
+
+      switch (inst.op_type) {
+        case OpType::push_local_noderef:
+        case OpType::push_local_noderef_check:
+        case OpType::push_local:
+        case OpType::push_local_check:
+        case OpType::loop_var_renew:
+          read(ScopeType::FUNC, opr1);
+          break;
+        case OpType::push_arg:
+        case OpType::push_arg_check:
+          read(ScopeType::FUNC_PARAM, opr1);
+          break;
+        case OpType::inc:
+        case OpType::dec:
+        case OpType::add_assign:
+        case OpType::add_assign_keep:
+          read(scope_type_from_int(opr1), opr2);
+          break;
+        case OpType::pop:
+        case OpType::pop_check:
+        case OpType::store:
+        case OpType::store_check:
+          write(scope_type_from_int(opr1), opr2);
+          break;
+        case OpType::var_undef:
+          write(ScopeType::FUNC, opr1);
+          break;
+        case OpType::store_curr_func:
+        case OpType::var_deinit:
+        case OpType::var_dispose:
+          overwrite(opr1, opr1 + 1);
+          break;
+        case OpType::var_deinit_range:
+        case OpType::var_dispose_range:
+          overwrite(opr1, opr2);
+          break;
+        case OpType::make_func:
+          for (auto& entry : func_meta[opr1]->capture_list) {
+            read(entry.scope_type, entry.index);
+          }
+          break;
+        default:
+          break;
+      }
+    }
+  }
+
+  void solve() {
+    live_in.assign(pcs.size() * word_cnt, 0);
+    live_out.assign(pcs.size() * word_cnt, 0);
+
+    bool changed = true;
+    while (changed) {
+      changed = false;
+      // the successors mostly come later, so go backward.
+      for (u32 i = pcs.size(); i-- > 0;) {
+        uint64_t *out = &live_out[i * word_cnt];
+        for (u32 succ_pc : succ[i]) {
+          uint64_t *succ_in = &live_in[index_of_pc[succ_pc] * word_cnt];
+          for (u32 w = 0; w < word_cnt; w++) {
+            out[w] |= succ_in[w];
+          }
+        }
+        uint64_t *in = &live_in[i * word_cnt];
+        for (u32 w = 0; w < word_cnt; w++) {
+          uint64_t new_in = use[i * word_cnt + w] | (out[w] & ~def[i * word_cnt + w]);
+          if (new_in != in[w]) {
+            in[w] = new_in;
+            changed = true;
+          }
+        }
+      }
+    }
+  }
+
+  void emit_root_map(RootMap& root_map) {
+    vector<u32> order;
+    for (u32 i = 0; i < pcs.size(); i++) {
+      if (is_safepoint(bytecode[pcs[i]].op_type)) order.push_back(i);
+    }
+    std::sort(order.begin(), order.end(), [this] (u32 a, u32 b) { return pcs[a] < pcs[b]; });
+
+    root_map.word_cnt = word_cnt;
+    root_map.pcs.clear();
+    root_map.bits.clear();
+    for (u32 i : order) {
+      root_map.pcs.push_back(pcs[i]);
+      // The frame may be suspended in the middle of the instruction, before it reads its
+      // operands.
+      for (u32 w = 0; w < word_cnt; w++) {
+        root_map.bits.push_back(live_out[i * word_cnt + w] | use[i * word_cnt + w]);
+      }
+    }
+  }
+
+  void set_bit(vector<uint64_t>& bits, u32 index, u32 slot) {
+    bits[index * word_cnt + slot / 64] |= uint64_t(1) << (slot % 64);
+  }
+
+  const vector<Instruction>& bytecode;
+  const vector<unique_ptr<JSFunctionMeta>>& func_meta;
+
+  u32 param_cnt;
+  u32 slot_cnt;
+  u32 word_cnt;
+
+  // the reachable instructions of the current function
+  vector<u32> pcs;
+  vector<vector<u32>> succ;
+  vector<u32> proc_call_pcs;
+  // pc -> index in `pcs`
+  vector<u32> index_of_pc;
+  vector<char> captured;
+
+  vector<uint64_t> use;
+  vector<uint64_t> def;
+  vector<uint64_t> live_in;
+  vector<uint64_t> live_out;
+};
+
+} // namespace njs
+
+#endif // NJS_ROOT_MAP_BUILDER_H
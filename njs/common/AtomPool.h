@@ -3,11 +3,14 @@
 
 #include <cassert>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include "njs/basic_types/atom.h"
 #include "njs/include/robin_hood.h"
 #include "njs/parser/lexing_helper.h"
 #include "njs/common/conversion_helper.h"
+#include "njs/common/static_atoms.h"
+#include "njs/utils/string_kernels.h"
 
 namespace njs {
 
@@ -21,142 +24,72 @@ using std::optional;
 struct AtomStats {
   size_t atomize_str_count {0};
   size_t static_atomize_str_count {0};
+  size_t freed_atom_count {0};
 };
 
+// The atoms of `static_atoms.h` have fixed ids below `static_atoms::COUNT`, and are not stored in
+// the pool. The ones after them are made as needed. Those recorded by `record_static_atom_count`
+// (the rest of the program and the builtins) live as long as the VM. The others, made at runtime
+// for the property keys and the symbols, are freed by the major GC when nothing marks them (see
+// `gc_mark_atom`), and their ids are reused.
 class AtomPool {
  public:
-  AtomPool() {
-    k_ = atomize(u"");
-    k_undefined = atomize(u"undefined");
-    k_null = atomize(u"null");
-    k_true = atomize(u"true");
-    k_false = atomize(u"false");
-    k_number = atomize(u"number");
-    k_boolean = atomize(u"boolean");
-    k_string = atomize(u"string");
-    k_object = atomize(u"object");
-    k_symbol = atomize(u"symbol");
-    k_function = atomize(u"function");
-    k_length = atomize(u"length");
-    k_prototype = atomize(u"prototype");
-    k_charAt = atomize(u"charAt");
-    k_constructor = atomize(u"constructor");
-    k___proto__ = atomize(u"__proto__");
-    k_toString = atomize(u"toString");
-    k_valueOf = atomize(u"valueOf");
-    k_toPrimitive = atomize(u"toPrimitive");
-    k_iterator = atomize(u"iterator");
-    k_match = atomize(u"match");
-    k_matchAll = atomize(u"matchAll");
-    k_replace = atomize(u"replace");
-    k_search = atomize(u"search");
-    k_split = atomize(u"split");
-    k_sym_iterator = atomize_symbol_desc(u"iterator");
-    k_sym_match = atomize_symbol_desc(u"match");
-    k_sym_matchAll = atomize_symbol_desc(u"matchAll");
-    k_sym_replace = atomize_symbol_desc(u"replace");
-    k_sym_search = atomize_symbol_desc(u"search");
-    k_sym_split = atomize_symbol_desc(u"split");
-    k_next = atomize(u"next");
-    k_done = atomize(u"done");
-    k_value = atomize(u"value");
-    k_enumerable = atomize(u"enumerable");
-    k_configurable = atomize(u"configurable");
-    k_writable = atomize(u"writable");
-    k_get = atomize(u"get");
-    k_set = atomize(u"set");
-    k_lastIndex = atomize(u"lastIndex");
-    k_name = atomize(u"name");
-    k_then = atomize(u"then");
-  }
-
+  AtomPool() = default;
   AtomPool(const AtomPool& other) = delete;
   AtomPool(AtomPool&& other);
   ~AtomPool();
 
   u32 atomize(u16string_view str_view);
+  // atomize a string whose characters are Latin-1, one byte each.
+  u32 atomize_latin1(std::string_view str_view);
   u32 atomize_no_uint(u16string_view str_view);
   u32 atomize_u32(u32 num);
   u32 atomize_symbol();
   u32 atomize_symbol_desc(u16string_view desc);
   u16string_view get_string(u32 atom);
+  // Whether all the characters of the string are Latin-1.
+  bool is_latin1(u32 atom);
   optional<u16string_view> get_symbol_desc(u32 symbol);
   bool has_string(u16string_view str_view);
   void record_static_atom_count();
 
-  inline static u32 k_;
-  inline static u32 k_undefined;
-  inline static u32 k_null;
-  inline static u32 k_true;
-  inline static u32 k_false;
-  inline static u32 k_number;
-  inline static u32 k_boolean;
-  inline static u32 k_string;
-  inline static u32 k_object;
-  inline static u32 k_symbol;
-  inline static u32 k_function;
-  // atoms above are also in VM's string_const pool.
-  inline static u32 k_length;
-  inline static u32 k_prototype;
-  inline static u32 k_charAt;
-  inline static u32 k_constructor;
-  inline static u32 k___proto__;
-  inline static u32 k_toString;
-  inline static u32 k_valueOf;
-  inline static u32 k_toPrimitive;
-
-  inline static u32 k_iterator;
-  inline static u32 k_match;
-  inline static u32 k_matchAll;
-  inline static u32 k_replace;
-  inline static u32 k_search;
-  inline static u32 k_split;
-
-  inline static u32 k_sym_iterator;
-  inline static u32 k_sym_match;
-  inline static u32 k_sym_matchAll;
-  inline static u32 k_sym_replace;
-  inline static u32 k_sym_search;
-  inline static u32 k_sym_split;
-  
-  inline static u32 k_next;
-  inline static u32 k_done;
-  inline static u32 k_value;
-  inline static u32 k_enumerable;
-  inline static u32 k_configurable;
-  inline static u32 k_writable;
-  inline static u32 k_get;
-  inline static u32 k_set;
-  inline static u32 k_lastIndex;
-  inline static u32 k_name;
-  inline static u32 k_then;
+  // Start marking the atoms for a major GC.
+  void begin_mark();
+  // Free the dynamic atoms that are not marked, calling `on_free(atom)` for each, and end the
+  // marking.
+  template <typename F>
+  void sweep(F&& on_free);
+
+#define NJS_STATIC_ATOM_CONSTANT(ident, str) \
+  static constexpr u32 k_##ident = static_atoms::ID_##ident;
+#define NJS_STATIC_SYMBOL_CONSTANT(ident, str) \
+  static constexpr u32 k_sym_##ident = static_atoms::ID_sym_##ident;
+  NJS_STATIC_STRING_ATOMS(NJS_STATIC_ATOM_CONSTANT)
+  NJS_STATIC_SYMBOL_ATOMS(NJS_STATIC_SYMBOL_CONSTANT)
+#undef NJS_STATIC_ATOM_CONSTANT
+#undef NJS_STATIC_SYMBOL_CONSTANT
 
   AtomStats stats;
  private:
   struct Slot {
-    bool is_symbol;
-    bool symbol_has_desc;
-    bool gc_mark {false};
+    bool is_symbol {false};
+    bool symbol_has_desc {false};
+    // the atom has been freed, and its id is in `free_ids`.
+    bool is_free {false};
+    bool is_latin1 {false};
     struct {
       char16_t *data {nullptr};
       size_t len {0};
     } str;
 
-    Slot() = default;
-
-    explicit Slot(const u16string& str): is_symbol(false) {
-      init_str(str.data(), str.size());
-    }
-
-    explicit Slot(u16string_view str_view): is_symbol(false) {
-      init_str(str_view.data(), str_view.size());
-    }
-
     void init_str(const char16_t *data, size_t length) {
       str.len = length;
       str.data = new char16_t[length + 1];
       memcpy(str.data, data, length * sizeof(char16_t));
       str.data[length] = 0;
+      char16_t bits = 0;
+      for (size_t i = 0; i < length; i++) bits |= data[i];
+      is_latin1 = bits <= 0xFF;
     }
 
     void dispose() {
@@ -171,31 +104,72 @@ class AtomPool {
     }
   };
 
+  // The strings may also be looked up by their Latin-1 bytes, which hash to the same value.
   struct KeyHasher {
+    using is_transparent = void;
+
     std::size_t operator()(const u16string_view& sv) const {
+      return hash(sv.data(), sv.size());
+    }
+
+    std::size_t operator()(const std::string_view& sv) const {
+      return hash(reinterpret_cast<const uint8_t *>(sv.data()), sv.size());
+    }
+
+    template <typename CharT>
+    static std::size_t hash(const CharT *data, size_t size) {
       const uint64_t fnv_prime = 1099511628211u;
       const uint64_t offset_basis = 14695981039346656037u;
 
       uint64_t hash = offset_basis;
-      for (char16_t c : sv) {
-        hash ^= static_cast<uint64_t>(c);
+      for (size_t i = 0; i < size; i++) {
+        hash ^= static_cast<uint64_t>(data[i]);
         hash *= fnv_prime;
       }
       return hash;
     }
   };
 
-  u32 next_id {0};
-  u32 static_atom_count {0};
-  unordered_flat_map<u16string_view, u32, KeyHasher> pool;
+  struct KeyEqual {
+    using is_transparent = void;
+
+    bool operator()(const u16string_view& a, const u16string_view& b) const {
+      return string_kernels::equals(a.data(), a.size(), b.data(), b.size());
+    }
+
+    bool operator()(const std::string_view& a, const u16string_view& b) const {
+      return string_kernels::equals(a.data(), a.size(), b.data(), b.size());
+    }
+
+    bool operator()(const u16string_view& a, const std::string_view& b) const {
+      return (*this)(b, a);
+    }
+  };
+
+  // Take a free id, or a new one, and return it with its slot reset.
+  u32 new_atom_id();
+  u32 new_string_atom(u16string_view str_view);
+  // the slot of an atom that is not static.
+  Slot& slot_of(u32 atom) {
+    assert(atom >= static_atoms::COUNT && atom < next_id);
+    return string_list[atom - static_atoms::COUNT];
+  }
+
+  u32 next_id {static_atoms::COUNT};
+  u32 static_atom_count {static_atoms::COUNT};
+  unordered_flat_map<u16string_view, u32, KeyHasher, KeyEqual> pool;
   vector<Slot> string_list;
+  vector<u32> free_ids;
+  // see `gc_atom_marks`
+  vector<uint8_t> marks;
 };
 
 inline AtomPool::AtomPool(AtomPool&& other)
     : next_id(other.next_id),
       static_atom_count(other.static_atom_count),
       pool(std::move(other.pool)),
-      string_list(std::move(other.string_list))
+      string_list(std::move(other.string_list)),
+      free_ids(std::move(other.free_ids))
 {
   other.string_list.clear();
 }
@@ -208,37 +182,48 @@ inline AtomPool::~AtomPool() {
 
 inline u32 AtomPool::atomize(u16string_view str_view) {
   stats.atomize_str_count += 1;
-  if (pool.contains(str_view)) {
-    return pool[str_view];
+  if (u32 atom = static_atoms::find(str_view.data(), str_view.size()); atom != static_atoms::COUNT) {
+    return atom;
+  }
+  if (auto iter = pool.find(str_view); iter != pool.end()) {
+    return iter->second;
   }
   else {
     uint64_t idx = scan_index_literal(str_view);
     if (idx != -1 && idx <= ATOM_INT_MAX) [[unlikely]] {
       return ATOM_INT_TAG | (u32)idx;
     } else {
-      // copy this string and put it in the list.
-      string_list.emplace_back(str_view);
-      // now the string_view in the pool is viewing the string in the list.
-      pool.emplace(string_list.back().str_view(), next_id);
-      next_id += 1;
-      // TODO: in this case, throw an error (although this is not likely to happen)
-      assert(next_id <= ATOM_STR_SYM_MAX);
-      return next_id - 1;
+      return new_string_atom(str_view);
     }
   }
 }
 
+inline u32 AtomPool::atomize_latin1(std::string_view str_view) {
+  if (u32 atom = static_atoms::find(str_view.data(), str_view.size()); atom != static_atoms::COUNT) {
+    stats.atomize_str_count += 1;
+    return atom;
+  }
+  if (auto iter = pool.find(str_view); iter != pool.end()) {
+    stats.atomize_str_count += 1;
+    return iter->second;
+  }
+  u16string str(str_view.size(), 0);
+  for (size_t i = 0; i < str_view.size(); i++) {
+    str[i] = (uint8_t)str_view[i];
+  }
+  return atomize(str);
+}
+
 inline u32 AtomPool::atomize_no_uint(u16string_view str_view) {
   stats.atomize_str_count += 1;
-  if (pool.contains(str_view)) {
-    return pool[str_view];
+  if (u32 atom = static_atoms::find(str_view.data(), str_view.size()); atom != static_atoms::COUNT) {
+    return atom;
+  }
+  if (auto iter = pool.find(str_view); iter != pool.end()) {
+    return iter->second;
   }
   else {
-    string_list.emplace_back(str_view);
-    pool.emplace(string_list.back().str_view(), next_id);
-    next_id += 1;
-    assert(next_id <= ATOM_STR_SYM_MAX);
-    return next_id - 1;
+    return new_string_atom(str_view);
   }
 }
 
@@ -252,31 +237,68 @@ inline u32 AtomPool::atomize_u32(njs::u32 num) {
 }
 
 inline u32 AtomPool::atomize_symbol() {
-  auto& new_slot = string_list.emplace_back();
-  new_slot.is_symbol = true;
-  new_slot.symbol_has_desc = false;
-  next_id += 1;
-  return next_id - 1;
+  u32 id = new_atom_id();
+  slot_of(id).is_symbol = true;
+  return id;
 }
 
 inline u32 AtomPool::atomize_symbol_desc(u16string_view desc) {
-  auto& new_slot = string_list.emplace_back();
-  new_slot.is_symbol = true;
-  new_slot.symbol_has_desc = true;
-  new_slot.init_str(desc.data(), desc.size());
+  u32 id = new_atom_id();
+  auto& slot = slot_of(id);
+  slot.is_symbol = true;
+  slot.symbol_has_desc = true;
+  slot.init_str(desc.data(), desc.size());
+  return id;
+}
+
+inline u32 AtomPool::new_atom_id() {
+  if (not free_ids.empty()) {
+    u32 id = free_ids.back();
+    free_ids.pop_back();
+    slot_of(id) = Slot();
+    return id;
+  }
+  string_list.emplace_back();
   next_id += 1;
+  // TODO: in this case, throw an error (although this is not likely to happen)
+  assert(next_id <= ATOM_STR_SYM_MAX);
   return next_id - 1;
 }
 
+inline u32 AtomPool::new_string_atom(u16string_view str_view) {
+  u32 id = new_atom_id();
+  // copy this string into the slot.
+  auto& slot = slot_of(id);
+  slot.init_str(str_view.data(), str_view.size());
+  // now the string_view in the pool is viewing the string in the slot.
+  pool.emplace(slot.str_view(), id);
+  return id;
+}
+
 inline u16string_view AtomPool::get_string(u32 atom) {
   assert(atom_is_str_sym(atom));
-  assert(!string_list[atom].is_symbol);
-  return string_list[atom].str_view();
+  if (atom < static_atoms::COUNT) {
+    assert(atom < static_atoms::STRING_COUNT);
+    return static_atoms::strings[atom];
+  }
+  auto& slot = slot_of(atom);
+  assert(!slot.is_symbol);
+  assert(!slot.is_free);
+  return slot.str_view();
+}
+
+inline bool AtomPool::is_latin1(u32 atom) {
+  assert(atom_is_str_sym(atom));
+  return atom < static_atoms::COUNT || slot_of(atom).is_latin1;
 }
 
 inline optional<u16string_view> AtomPool::get_symbol_desc(u32 symbol) {
   assert(atom_is_str_sym(symbol));
-  auto& slot = string_list[symbol];
+  if (symbol < static_atoms::COUNT) {
+    assert(symbol >= static_atoms::STRING_COUNT);
+    return static_atoms::strings[symbol];
+  }
+  auto& slot = slot_of(symbol);
   assert(slot.is_symbol);
   if (slot.symbol_has_desc) {
     return slot.str_view();
@@ -286,7 +308,9 @@ inline optional<u16string_view> AtomPool::get_symbol_desc(u32 symbol) {
 }
 
 inline bool AtomPool::has_string(u16string_view str_view) {
-  if (pool.contains(str_view)) {
+  if (static_atoms::find(str_view.data(), str_view.size()) != static_atoms::COUNT) {
+    return true;
+  } else if (pool.contains(str_view)) {
     return true;
   } else if (auto idx = scan_index_literal(str_view);
               idx != -1 && idx <= ATOM_INT_MAX) {
@@ -297,10 +321,35 @@ inline bool AtomPool::has_string(u16string_view str_view) {
 }
 
 inline void AtomPool::record_static_atom_count() {
-  static_atom_count = string_list.size();
+  // the ids below are never freed.
+  assert(free_ids.empty());
+  static_atom_count = next_id;
   stats.static_atomize_str_count = stats.atomize_str_count;
 }
 
+inline void AtomPool::begin_mark() {
+  marks.assign(next_id, 0);
+  gc_atom_marks = marks.data();
+  gc_atom_mark_count = next_id;
+}
+
+template <typename F>
+void AtomPool::sweep(F&& on_free) {
+  for (u32 id = static_atom_count; id < next_id; id++) {
+    auto& slot = slot_of(id);
+    if (marks[id] || slot.is_free) continue;
+    // the key in the pool views the string in the slot, so it is erased first.
+    if (not slot.is_symbol) pool.erase(slot.str_view());
+    slot.dispose();
+    slot.is_free = true;
+    free_ids.push_back(id);
+    stats.freed_atom_count += 1;
+    on_free(id);
+  }
+  gc_atom_marks = nullptr;
+  gc_atom_mark_count = 0;
+}
+
 } // namespace njs
 
 #endif // NJS_ATOM_POOL_H
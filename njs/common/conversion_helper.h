@@ -8,6 +8,7 @@
 #include <iostream>
 #include <string>
 #include <string_view>
+#include <type_traits>
 #include "njs/parser/character.h"
 #include "double_to_str.h"
 #include "njs/utils/helper.h"
@@ -106,11 +107,14 @@ inline u16string str_cat(const std::vector<u16string>& vals) {
   return res;
 }
 
-inline u16string to_escaped_u16string(u16string_view str_view) {
-  u16string escaped;
+// Append `str` to `output`, escaped for JSON. `CharT` is `char16_t`, or `char` for the Latin-1
+// characters of a one-byte string.
+template <typename CharT>
+inline void append_escaped(u16string& output, std::basic_string_view<CharT> str_view) {
+  using UChar = std::make_unsigned_t<CharT>;
   size_t escape_char_cnt = 0;
 
-  for (auto ch : str_view) {
+  for (UChar ch : str_view) {
     switch (ch) {
       case '\"':
       case '\\':
@@ -130,87 +134,92 @@ inline u16string to_escaped_u16string(u16string_view str_view) {
     }
   }
 
-  if (escape_char_cnt == 0) return u16string(str_view);
+  size_t output_ptr = output.size();
+  output.resize(output.size() + str_view.size() + escape_char_cnt);
 
-  escaped.resize(str_view.size() + escape_char_cnt);
+  if (escape_char_cnt == 0) {
+    for (UChar ch : str_view) {
+      output[output_ptr++] = ch;
+    }
+    return;
+  }
 
-  size_t output_ptr = 0;
-  for (auto ch : str_view) {
+  for (UChar ch : str_view) {
     if (ch > 31 && ch != '\"' && ch != '\\') {
-      escaped[output_ptr++] = ch;
+      output[output_ptr++] = ch;
     }
     else {
-      escaped[output_ptr++] = '\\';
+      output[output_ptr++] = '\\';
       switch (ch) {
         case '\\':
-          escaped[output_ptr++] = '\\';
+          output[output_ptr++] = '\\';
           break;
         case '\"':
-          escaped[output_ptr++] = '\"';
+          output[output_ptr++] = '\"';
           break;
         case '\b':
-          escaped[output_ptr++] = 'b';
+          output[output_ptr++] = 'b';
           break;
         case '\f':
-          escaped[output_ptr++] = 'f';
+          output[output_ptr++] = 'f';
           break;
         case '\n':
-          escaped[output_ptr++] = 'n';
+          output[output_ptr++] = 'n';
           break;
         case '\r':
-          escaped[output_ptr++] = 'r';
+          output[output_ptr++] = 'r';
           break;
         case '\t':
-          escaped[output_ptr++] = 't';
+          output[output_ptr++] = 't';
           break;
         default:
           // escape and print as unicode codepoint
           char buf[10];
           sprintf(buf, "u%04x", (char)ch);
           for (int i = 0; i < 4; i++) {
-            escaped[output_ptr++] = buf[i];
+            output[output_ptr++] = buf[i];
           }
           break;
       }
     }
   }
+}
 
+inline u16string to_escaped_u16string(u16string_view str_view) {
+  u16string escaped;
+  append_escaped(escaped, str_view);
   return escaped;
 }
 
+// `str` has room for `DOUBLE_TO_CHARS_MAX + 1` characters.
 inline void print_double_string(double n, char *str) {
-  js_dtoa(str, n, 10, 0, JS_DTOA_VAR_FORMAT);
+  str[double_to_chars(n, str)] = 0;
 }
 
 // for json stringify
 inline void print_double_u16string(double n, char16_t *str) {
-  char buf[JS_DTOA_BUF_SIZE];
-  js_dtoa(buf, n, 10, 0, JS_DTOA_VAR_FORMAT);
-  u8_to_u16_buffer(buf, str);
+  str[double_to_chars(n, str)] = 0;
 }
 
 inline void json_double_u16string(double n, char16_t *str) {
-  char buf[JS_DTOA_BUF_SIZE];
   if (std::isnan(n) || std::isinf(n)) [[unlikely]] {
-    sprintf(buf, "null");
+    std::char_traits<char16_t>::copy(str, u"null", 5);
   } else {
-    js_dtoa(buf, n, 10, 0, JS_DTOA_VAR_FORMAT);
+    print_double_u16string(n, str);
   }
-  u8_to_u16_buffer(buf, str);
 }
 
 inline u16string double_to_u16string(double n) {
-  char buf[JS_DTOA_BUF_SIZE];
-  js_dtoa(buf, n, 10, 0, JS_DTOA_VAR_FORMAT);
-  
-  char16_t u16buf[JS_DTOA_BUF_SIZE];
-  u8_to_u16_buffer(buf, u16buf);
-  return u16string(u16buf);
+  char16_t buf[DOUBLE_TO_CHARS_MAX];
+  return u16string(buf, double_to_chars(n, buf));
 }
 
-inline double parse_double(u16string_view str) {
-  auto predicate = [] (char16_t ch) {
-    return character::is_white_space(ch) || character::is_line_terminator(ch);
+// StringToNumber for the decimal literals and `Infinity`. `CharT` is `char` (Latin-1) or
+// `char16_t`.
+template <typename CharT>
+inline double parse_double(std::basic_string_view<CharT> str) {
+  auto predicate = [] (CharT ch) {
+    return character::is_white_space(char_unit(ch)) || character::is_line_terminator(char_unit(ch));
   };
   auto start = std::find_if_not(str.begin(), str.end(), predicate);
   auto end = std::find_if_not(str.rbegin(), str.rend(), predicate).base();
@@ -219,29 +228,43 @@ inline double parse_double(u16string_view str) {
 
   bool positive = true;
 
-  if (*start == u'-') {
+  if (*start == '-') {
     positive = false;
     start += 1;
-  } else if (*start == u'+') {
+  } else if (*start == '+') {
     start += 1;
   }
 
   if (start >= end) return NAN;
+  // unlike a NumericLiteral, the string may have leading zeros.
+  while (end - start > 1 && *start == '0' && character::is_decimal_digit(char_unit(start[1]))) {
+    start += 1;
+  }
 
-  if (u16string(start, end) == u"Infinity") {
+  constexpr std::string_view infinity = "Infinity";
+  if (std::equal(start, end, infinity.begin(), infinity.end())) {
     return positive ? std::numeric_limits<double>::infinity()
                     : -std::numeric_limits<double>::infinity();
   }
 
   u32 cursor = start - str.begin();
-  auto res = scan_numeric_literal(str.data(), str.size(), cursor);
-  if (res.has_value() && cursor == str.size()) {
+  u32 length = end - str.begin();
+  auto res = scan_numeric_literal(str.data(), length, cursor);
+  if (res.has_value() && cursor == length) {
     return positive ? res.value() : -res.value();
   } else {
     return NAN;
   }
 }
 
+inline double parse_double(u16string_view str) {
+  return parse_double<char16_t>(str);
+}
+
+inline double parse_double(std::string_view str) {
+  return parse_double<char>(str);
+}
+
 inline double parse_int(u16string_view str) {
   auto predicate = [] (char16_t ch) {
     return character::is_white_space(ch) || character::is_line_terminator(ch);
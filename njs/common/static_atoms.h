@@ -0,0 +1,300 @@
+#ifndef NJS_STATIC_ATOMS_H
+#define NJS_STATIC_ATOMS_H
+
+#include <array>
+#include <cstdint>
+#include <string_view>
+#include <type_traits>
+#include "njs/utils/string_kernels.h"
+
+// The atoms known at compile time: the names used by the VM and the builtins. Their ids are fixed
+// (the order of the lists below), so the atom pool starts with them without doing any work, and
+// they are looked up by a perfect hash that is also built at compile time.
+
+// X(identifier, string). `AtomPool::k_<identifier>` is the atom of the string.
+// The first 11 are also in the VM's `string_const` pool, in this order.
+#define NJS_STATIC_STRING_ATOMS(X) \
+  X(, u"") \
+  X(undefined, u"undefined") \
+  X(null, u"null") \
+  X(true, u"true") \
+  X(false, u"false") \
+  X(number, u"number") \
+  X(boolean, u"boolean") \
+  X(string, u"string") \
+  X(object, u"object") \
+  X(symbol, u"symbol") \
+  X(function, u"function") \
+  /* properties used by the VM */ \
+  X(length, u"length") \
+  X(prototype, u"prototype") \
+  X(constructor, u"constructor") \
+  X(__proto__, u"__proto__") \
+  X(toString, u"toString") \
+  X(valueOf, u"valueOf") \
+  X(toPrimitive, u"toPrimitive") \
+  X(iterator, u"iterator") \
+  X(next, u"next") \
+  X(done, u"done") \
+  X(value, u"value") \
+  X(enumerable, u"enumerable") \
+  X(configurable, u"configurable") \
+  X(writable, u"writable") \
+  X(get, u"get") \
+  X(set, u"set") \
+  X(name, u"name") \
+  X(message, u"message") \
+  X(stack, u"stack") \
+  X(then, u"then") \
+  X(catch, u"catch") \
+  X(finally, u"finally") \
+  X(return, u"return") \
+  X(throw, u"throw") \
+  X(global_code, u"(global)") \
+  /* Object */ \
+  X(Object, u"Object") \
+  X(defineProperty, u"defineProperty") \
+  X(hasOwn, u"hasOwn") \
+  X(getPrototypeOf, u"getPrototypeOf") \
+  X(setPrototypeOf, u"setPrototypeOf") \
+  X(preventExtensions, u"preventExtensions") \
+  X(isExtensible, u"isExtensible") \
+  X(create, u"create") \
+  X(assign, u"assign") \
+  X(hasOwnProperty, u"hasOwnProperty") \
+  X(toLocaleString, u"toLocaleString") \
+  /* Function */ \
+  X(Function, u"Function") \
+  X(call, u"call") \
+  X(bind, u"bind") \
+  X(apply, u"apply") \
+  /* Number and String */ \
+  X(Number, u"Number") \
+  X(String, u"String") \
+  X(fromCharCode, u"fromCharCode") \
+  X(charAt, u"charAt") \
+  X(charCodeAt, u"charCodeAt") \
+  X(toLowerCase, u"toLowerCase") \
+  X(toUpperCase, u"toUpperCase") \
+  X(toLocaleLowerCase, u"toLocaleLowerCase") \
+  X(toLocaleUpperCase, u"toLocaleUpperCase") \
+  X(substring, u"substring") \
+  X(substr, u"substr") \
+  X(concat, u"concat") \
+  X(indexOf, u"indexOf") \
+  X(lastIndexOf, u"lastIndexOf") \
+  X(at, u"at") \
+  X(match, u"match") \
+  X(matchAll, u"matchAll") \
+  X(replace, u"replace") \
+  X(search, u"search") \
+  X(split, u"split") \
+  /* Array */ \
+  X(Array, u"Array") \
+  X(push, u"push") \
+  X(pop, u"pop") \
+  X(shift, u"shift") \
+  X(sort, u"sort") \
+  X(join, u"join") \
+  X(slice, u"slice") \
+  X(splice, u"splice") \
+  /* RegExp */ \
+  X(RegExp, u"RegExp") \
+  X(test, u"test") \
+  X(exec, u"exec") \
+  X(global, u"global") \
+  X(ignoreCase, u"ignoreCase") \
+  X(multiline, u"multiline") \
+  X(dotAll, u"dotAll") \
+  X(unicode, u"unicode") \
+  X(sticky, u"sticky") \
+  X(hasIndices, u"hasIndices") \
+  X(source, u"source") \
+  X(flags, u"flags") \
+  X(lastIndex, u"lastIndex") \
+  X(index, u"index") \
+  X(input, u"input") \
+  X(groups, u"groups") \
+  /* Date, Symbol, Promise */ \
+  X(Date, u"Date") \
+  X(getTime, u"getTime") \
+  X(toJSON, u"toJSON") \
+  X(Symbol, u"Symbol") \
+  X(Promise, u"Promise") \
+  /* errors */ \
+  X(Error, u"Error") \
+  X(EvalError, u"EvalError") \
+  X(RangeError, u"RangeError") \
+  X(ReferenceError, u"ReferenceError") \
+  X(SyntaxError, u"SyntaxError") \
+  X(TypeError, u"TypeError") \
+  X(URIError, u"URIError") \
+  X(InternalError, u"InternalError") \
+  X(AggregateError, u"AggregateError") \
+  /* the other globals */ \
+  X(console, u"console") \
+  X(log, u"log") \
+  X(Math, u"Math") \
+  X(min, u"min") \
+  X(max, u"max") \
+  X(floor, u"floor") \
+  X(random, u"random") \
+  X(JSON, u"JSON") \
+  X(stringify, u"stringify") \
+  X(parse, u"parse") \
+  X(NaN, u"NaN") \
+  X(Infinity, u"Infinity") \
+  X(isFinite, u"isFinite") \
+  X(parseFloat, u"parseFloat") \
+  X(parseInt, u"parseInt") \
+  X(setTimeout, u"setTimeout") \
+  X(setInterval, u"setInterval") \
+  X(clearTimeout, u"clearTimeout") \
+  X(clearInterval, u"clearInterval") \
+  X(fetch, u"fetch") \
+  X(_gc, u"$gc") \
+  X(_heapSnapshot, u"$heapSnapshot") \
+  X(___trap, u"___trap") \
+  X(___dummy, u"___dummy") \
+  X(___test, u"___test")
+
+// X(identifier, description). The well-known symbols, `AtomPool::k_sym_<identifier>`.
+#define NJS_STATIC_SYMBOL_ATOMS(X) \
+  X(iterator, u"iterator") \
+  X(match, u"match") \
+  X(matchAll, u"matchAll") \
+  X(replace, u"replace") \
+  X(search, u"search") \
+  X(split, u"split")
+
+namespace njs::static_atoms {
+
+using u32 = uint32_t;
+
+enum : u32 {
+#define NJS_STATIC_ATOM_ID(ident, str) ID_##ident,
+#define NJS_STATIC_SYMBOL_ID(ident, str) ID_sym_##ident,
+  NJS_STATIC_STRING_ATOMS(NJS_STATIC_ATOM_ID)
+  NJS_STATIC_SYMBOL_ATOMS(NJS_STATIC_SYMBOL_ID)
+#undef NJS_STATIC_ATOM_ID
+#undef NJS_STATIC_SYMBOL_ID
+  COUNT,
+};
+
+// The strings of the string atoms, followed by the descriptions of the symbols, indexed by id.
+inline constexpr std::u16string_view strings[] = {
+#define NJS_STATIC_ATOM_STRING(ident, str) str,
+  NJS_STATIC_STRING_ATOMS(NJS_STATIC_ATOM_STRING)
+  NJS_STATIC_SYMBOL_ATOMS(NJS_STATIC_ATOM_STRING)
+#undef NJS_STATIC_ATOM_STRING
+};
+
+// The ids below this are strings, and the others up to `COUNT` are symbols.
+inline constexpr u32 STRING_COUNT = ID_sym_iterator;
+
+static_assert(std::size(strings) == COUNT);
+
+// FNV-1a, the same as the atom pool's hash, so that the Latin-1 bytes of a string hash to the
+// same value as its two-byte characters.
+template <typename CharT>
+constexpr uint64_t hash(const CharT *data, size_t size) {
+  uint64_t h = 14695981039346656037u;
+  for (size_t i = 0; i < size; i++) {
+    h ^= static_cast<uint64_t>(std::make_unsigned_t<CharT>(data[i]));
+    h *= 1099511628211u;
+  }
+  return h;
+}
+
+// The perfect hash, by "hash and displace": the strings are first put in buckets by their hash,
+// and each bucket is given a seed with which its strings land in distinct free slots.
+constexpr size_t ceil_pow2(size_t n) {
+  size_t res = 1;
+  while (res < n) res *= 2;
+  return res;
+}
+
+// at most a quarter of the slots are used, so that a seed is found quickly for each bucket.
+constexpr size_t BUCKET_COUNT = ceil_pow2(STRING_COUNT / 2);
+constexpr size_t SLOT_COUNT = ceil_pow2(STRING_COUNT * 4);
+constexpr uint16_t EMPTY_SLOT = UINT16_MAX;
+
+constexpr size_t slot_of(uint64_t h, uint16_t seed) {
+  h ^= (seed + 1) * 0x9E3779B97F4A7C15u;
+  h ^= h >> 33;
+  h *= 0xFF51AFD7ED558CCDu;
+  h ^= h >> 33;
+  return h & (SLOT_COUNT - 1);
+}
+
+struct PerfectHash {
+  std::array<uint16_t, BUCKET_COUNT> seeds {};
+  std::array<uint16_t, SLOT_COUNT> slots {};
+};
+
+consteval PerfectHash build_perfect_hash() {
+  PerfectHash res;
+  res.slots.fill(EMPTY_SLOT);
+
+  std::array<uint64_t, STRING_COUNT> hashes {};
+  std::array<size_t, BUCKET_COUNT> bucket_sizes {};
+  size_t max_bucket_size = 0;
+  for (u32 id = 0; id < STRING_COUNT; id++) {
+    auto str = strings[id];
+    for (char16_t ch : str) {
+      // the static atoms are taken to be Latin-1 by `AtomPool::is_latin1`.
+      if (ch > 0xFF) throw "a static atom is not Latin-1";
+    }
+    hashes[id] = hash(str.data(), str.size());
+    size_t size = ++bucket_sizes[hashes[id] % BUCKET_COUNT];
+    if (size > max_bucket_size) max_bucket_size = size;
+  }
+
+  // place the largest buckets first, while there are many free slots.
+  for (size_t size = max_bucket_size; size > 0; size--) {
+    for (size_t bucket = 0; bucket < BUCKET_COUNT; bucket++) {
+      if (bucket_sizes[bucket] != size) continue;
+
+      for (u32 seed = 0; ; seed++) {
+        if (seed == EMPTY_SLOT) throw "no seed found for a bucket of the static atoms";
+        std::array<size_t, STRING_COUNT> taken {};
+        size_t taken_count = 0;
+        bool fits = true;
+        for (u32 id = 0; id < STRING_COUNT && fits; id++) {
+          if (hashes[id] % BUCKET_COUNT != bucket) continue;
+          size_t slot = slot_of(hashes[id], seed);
+          fits = res.slots[slot] == EMPTY_SLOT;
+          for (size_t i = 0; i < taken_count && fits; i++) {
+            fits = taken[i] != slot;
+          }
+          taken[taken_count++] = slot;
+        }
+        if (not fits) continue;
+
+        res.seeds[bucket] = seed;
+        for (u32 id = 0; id < STRING_COUNT; id++) {
+          if (hashes[id] % BUCKET_COUNT != bucket) continue;
+          res.slots[slot_of(hashes[id], seed)] = id;
+        }
+        break;
+      }
+    }
+  }
+  return res;
+}
+
+inline constexpr PerfectHash perfect_hash = build_perfect_hash();
+
+// Return the id of the static string atom of the characters, or `COUNT` if there is none.
+template <typename CharT>
+inline u32 find(const CharT *data, size_t size) {
+  uint64_t h = hash(data, size);
+  uint16_t id = perfect_hash.slots[slot_of(h, perfect_hash.seeds[h % BUCKET_COUNT])];
+  if (id == EMPTY_SLOT) return COUNT;
+  auto str = strings[id];
+  return string_kernels::equals(data, size, str.data(), str.size()) ? id : COUNT;
+}
+
+} // namespace njs::static_atoms
+
+#endif // NJS_STATIC_ATOMS_H
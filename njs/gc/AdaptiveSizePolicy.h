@@ -0,0 +1,112 @@
+#ifndef NJS_ADAPTIVE_SIZE_POLICY_H
+#define NJS_ADAPTIVE_SIZE_POLICY_H
+
+#include <cstdint>
+#include <cstddef>
+#include <array>
+#include <algorithm>
+#include <cmath>
+
+namespace njs {
+
+// Decides the size of the nursery (the part of the new generation where the objects are
+// allocated) and the tenuring age after each minor GC, from the pause times and the survivors
+// observed. This class only deals with numbers; resizing the nursery is up to the heap.
+//
+// - If there is a pause goal and the minor GC pauses are longer, the nursery shrinks and the
+//   objects are tenured younger, so that less is copied in each GC.
+// - Otherwise, if the GC takes more than its share of the time allowed by the throughput goal,
+//   the nursery grows, so that the GCs are less frequent.
+// - The tenuring age is the lowest age at which the survivors would fill more than
+//   `TARGET_SURVIVOR_RATIO` of the to-space.
+class AdaptiveSizePolicy {
+ public:
+  // `GCObject::gc_age` has 4 bits.
+  constexpr static uint32_t AGE_LIMIT = 15;
+  // ages after a minor GC are in [1, AGE_LIMIT]
+  using AgeTable = std::array<size_t, AGE_LIMIT + 1>;
+
+  // `pause_goal_ms` is 0 if there is no pause goal.
+  void init(size_t min_nursery, size_t max_nursery, size_t survivor_size,
+            double pause_goal_ms, double throughput_goal) {
+    min_nursery_size = min_nursery;
+    max_nursery_size = max_nursery;
+    survivor_space_size = survivor_size;
+    pause_goal_us = pause_goal_ms > 0 ? pause_goal_ms * 1000 : INFINITY;
+    gc_time_goal = 1 - throughput_goal;
+    nursery_size = std::clamp(max_nursery / 8, min_nursery, max_nursery);
+  }
+
+  // `pause_us`: time of the minor GC without the major GC in it.
+  // `gc_us`: time the mutator was stopped, including the major GC.
+  // `mutator_us`: time the mutator ran since the last GC.
+  // `age_table[age]`: bytes copied into the to-space that now have this age.
+  // `overflowed`: some objects were promoted because the to-space was full.
+  void update(size_t pause_us, size_t gc_us, size_t mutator_us,
+              const AgeTable& age_table, bool overflowed) {
+    double gc_time_ratio = double(gc_us) / std::max<size_t>(gc_us + mutator_us, 1);
+    if (gc_cnt == 0) {
+      avg_pause_us = pause_us;
+      avg_gc_time_ratio = gc_time_ratio;
+    } else {
+      avg_pause_us += AVG_WEIGHT * (pause_us - avg_pause_us);
+      avg_gc_time_ratio += AVG_WEIGHT * (gc_time_ratio - avg_gc_time_ratio);
+    }
+    gc_cnt += 1;
+
+    if (avg_pause_us > pause_goal_us) {
+      nursery_size = size_t(nursery_size * (1 - RESIZE_STEP));
+      age_cap = std::max(age_cap - 1, 1u);
+    } else {
+      if (avg_gc_time_ratio > gc_time_goal) {
+        nursery_size = size_t(nursery_size * (1 + RESIZE_STEP));
+      }
+      if (avg_pause_us < pause_goal_us / 2) {
+        age_cap = std::min(age_cap + 1, AGE_LIMIT);
+      }
+    }
+    nursery_size = std::clamp(nursery_size, min_nursery_size, max_nursery_size);
+
+    size_t desired = size_t(survivor_space_size * TARGET_SURVIVOR_RATIO);
+    size_t total = 0;
+    uint32_t age = 1;
+    for (; age < AGE_LIMIT; age++) {
+      total += age_table[age];
+      if (total > desired) break;
+    }
+    if (overflowed) {
+      age = std::min(age, std::max(tenure_age - 1, 1u));
+    }
+    tenure_age = std::min(age, age_cap);
+  }
+
+  size_t get_nursery_size() const { return nursery_size; }
+  uint32_t get_tenure_age() const { return tenure_age; }
+  double get_avg_pause_us() const { return avg_pause_us; }
+  double get_avg_gc_time_ratio() const { return avg_gc_time_ratio; }
+
+ private:
+  constexpr static double AVG_WEIGHT = 0.3;
+  constexpr static double RESIZE_STEP = 0.2;
+  constexpr static double TARGET_SURVIVOR_RATIO = 0.5;
+
+  size_t min_nursery_size {0};
+  size_t max_nursery_size {0};
+  size_t survivor_space_size {0};
+  double pause_goal_us {0};
+  double gc_time_goal {0};
+
+  size_t nursery_size {0};
+  // Objects that have survived this many minor GCs are promoted.
+  uint32_t tenure_age {1};
+  // upper bound of the tenuring age, lowered when the pauses are too long.
+  uint32_t age_cap {AGE_LIMIT};
+
+  size_t gc_cnt {0};
+  double avg_pause_us {0};
+  double avg_gc_time_ratio {0};
+};
+
+} // namespace njs
+
+#endif // NJS_ADAPTIVE_SIZE_POLICY_H
@@ -1,15 +1,21 @@
 #include <cstring>
 #include <iostream>
 #include <cstdint>
+#include <algorithm>
+#include <unistd.h>
+#include <sys/mman.h>
 
 #include "GCHeap.h"
 #include "njs/vm/NjsVM.h"
 #include "njs/vm/JSStackFrame.h"
 #include "njs/global_var.h"
 #include "njs/utils/Timer.h"
+#include "njs/utils/Tracer.h"
+#include "njs/utils/PerfCounters.h"
 #include "njs/basic_types/PrimitiveString.h"
 #include "njs/basic_types/HeapArray.h"
 #include "njs/common/common_def.h"
+#include "njs/utils/macros.h"
 
 namespace njs {
 
@@ -17,48 +23,66 @@ force_inline size_t next_multiple_of_8(size_t num) {
   return (num + 7) & ~7;
 }
 
-force_inline int size_to_index(u32 size) {
-  // 0 : [0, 64)
-  // 1 : [64, 128)
-  // 2 : [128, 192)
-  // 3 : [192, 256)
-  // 4 : [256, 512)
-  // 5 : [512, 768)
-  // 6 : [768, 4096)
-  // 7 : [4096, )
-  if (size < 256) [[likely]] {
-    return size / 64;
-  } else if (size < 768) {
-    return (size / 256) + 3;
-  } else if (size < 4096) {
-    return 6;
-  } else {
-    return 7;
-  }
-}
-
 GCHeap::GCHeap(size_t size_mb, NjsVM& vm)
     : vm(vm),
+      profiler(*this, vm),
       heap_size(size_mb * 1024 * 1024),
-      storage((byte *)malloc(size_mb * 1024 * 1024)),
       gc_thread(&GCHeap::minor_gc_task, this)
 {
+  os_page_size = sysconf(_SC_PAGESIZE);
+  size_t large_space_size = (heap_size / 2) & ~(os_page_size - 1);
+  // Reserve the address space of the heap and the large object space at once. The memory is
+  // committed when it's touched.
+  storage_size = heap_size + os_page_size + large_space_size;
+  void *mem = mmap(nullptr, storage_size, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (mem == MAP_FAILED) {
+    fprintf(stderr, "memory allocation failed\n");
+    exit(EXIT_FAILURE);
+  }
+  storage = static_cast<byte *>(mem);
+
   newgen_start = storage;
   survivor1_start = newgen_start + size_t(newgen_size_ratio * heap_size);
   survivor2_start = survivor1_start + size_t(survivor_size_ratio * heap_size);
   oldgen_start = survivor2_start + size_t(survivor_size_ratio * heap_size);
   oldgen_end = oldgen_start + size_t(oldgen_size_ratio * heap_size);
+  large_space_start = storage + ((heap_size + os_page_size - 1) & ~(os_page_size - 1));
+  large_space_end = large_space_start + large_space_size;
+  large_space.init(large_space_size / os_page_size);
+  large_space_gc_threshold = large_space_size / 8;
 
   alloc_point = newgen_start;
-  oldgen_alloc_point = oldgen_start;
   survivor_alloc_point = survivor1_start;
   survivor_from_start = survivor1_start;
   survivor_to_start = survivor2_start;
 
-  dealloc_progress = survivor1_start;
-  newgen_gc_threshold = newgen_start + size_t(newgen_gc_threshold_ratio * heap_size);
+  size_t nursery_max = size_t(nursery_max_ratio * heap_size);
+  size_policy.init(std::min(NURSERY_MIN_SIZE, nursery_max), nursery_max,
+                   survivor2_start - survivor1_start,
+                   Global::gc_pause_goal_ms, Global::gc_throughput_goal);
+  newgen_gc_threshold = newgen_start + size_policy.get_nursery_size();
+  stats.nursery_size = size_policy.get_nursery_size();
+  stats.tenure_age = tenure_age;
+  last_gc_end = std::chrono::steady_clock::now();
+
+  pages.resize((oldgen_end - oldgen_start) >> OLDGEN_PAGE_SHIFT);
+  card_table.resize((large_space_end - oldgen_start) >> CARD_SHIFT, CARD_CLEAN);
+  if (Global::heap_snapshot_path != nullptr) {
+    profiler.start_tracking();
+  }
+  init_alloc_sites(0);
 
-  record_set.reserve(1000);
+  size_t worker_cnt = Global::gc_thread_count;
+  if (worker_cnt == 0) {
+    worker_cnt = std::clamp(std::thread::hardware_concurrency(), 1u, 8u);
+  }
+  for (size_t i = 0; i < worker_cnt; i++) {
+    workers.push_back(std::make_unique<GCWorker>(i));
+  }
+  for (size_t i = 1; i < worker_cnt; i++) {
+    helper_threads.emplace_back(&GCHeap::gc_worker_task, this, i);
+  }
 }
 
 GCHeap::~GCHeap() {
@@ -70,11 +94,27 @@ GCHeap::~GCHeap() {
   gc_cond_var.notify_one();
   gc_thread.join();
 
-  newgen_dealloc_dead(newgen_start, alloc_point);
-  newgen_dealloc_dead(survivor_from_start, survivor_alloc_point);
-  oldgen_dealloc_dead(oldgen_start, oldgen_alloc_point);
+  {
+    std::lock_guard<std::mutex> lock(worker_mutex);
+    helpers_stop = true;
+  }
+  worker_cond_var.notify_all();
+  for (auto& thread : helper_threads) {
+    thread.join();
+  }
 
-  free(storage);
+  for (GCObject *obj : newgen_finalizers) {
+    obj->~GCObject();
+  }
+  for (GCObject *obj : survivor_finalizers) {
+    obj->~GCObject();
+  }
+  oldgen_dealloc_all();
+  for (GCObject *obj : large_objects) {
+    obj->~GCObject();
+  }
+
+  munmap(storage, storage_size);
 }
 
 void GCHeap::gc_if_needed() {
@@ -83,10 +123,15 @@ void GCHeap::gc_if_needed() {
     gc_requested = false;
     gc();
   }
+  // No view of a string is in use at a safepoint.
+  if (PrimitiveString::wide_view_usage > PrimitiveString::MAX_WIDE_VIEW_USAGE) [[unlikely]] {
+    PrimitiveString::release_wide_views();
+  }
 }
 
 void GCHeap::gc() {
   gc_message("************ GC triggered ************");
+  TraceScope trace("gc", "GC pause");
 
   gc_running.wait(true);
   gc_running = true;
@@ -105,36 +150,52 @@ void GCHeap::gc() {
   gc_message("************  execution continue  ************");
 }
 
-void GCHeap::write_barrier(GCObject *obj, JSValue const& field) {
-  if (not field.needs_gc()) return;
-  write_barrier(obj, field.as_GCObject);
+bool GCHeap::write_barrier(GCObject *obj, JSValue const& field) {
+  if (not field.needs_gc()) return false;
+  return write_barrier(obj, field.as_GCObject);
 }
 
-void GCHeap::write_barrier(GCObject *obj, GCObject *field) {
+bool GCHeap::write_barrier(GCObject *obj, GCObject *field) {
   field->ref_count_inc();
 
   if (obj >= reinterpret_cast<GCObject *>(oldgen_start)
-      && field < reinterpret_cast<GCObject *>(oldgen_start)
-      && not obj->gc_remembered) {
-    record_set.push_back(obj);
-    obj->gc_remembered = true;
+      && field < reinterpret_cast<GCObject *>(oldgen_start)) {
+    dirty_card(obj);
+    return true;
   }
+  return false;
+}
+
+bool GCHeap::write_barrier(GCObject *obj, void *slot, JSValue const& field) {
+  if (not field.needs_gc()) return false;
+  field.as_GCObject->ref_count_inc();
+
+  if (obj >= reinterpret_cast<GCObject *>(oldgen_start)
+      && field.as_GCObject < reinterpret_cast<GCObject *>(oldgen_start)) {
+    dirty_card(slot);
+    return true;
+  }
+  return false;
 }
 
 void GCHeap::minor_gc_task() {
+  Tracer::set_thread_name("GC");
   while (true) {
     std::unique_lock<std::mutex> lock(cond_mutex);
     gc_cond_var.wait(lock, [this] { return gc_start || stop; });
     if (stop) return;
 
+    TraceScope trace("gc", "minor GC");
+    trace.set_arg("nursery_size", size_policy.get_nursery_size());
+    PerfScope perf("GC");
     Timer timer("gc");
     gc_message("GC task start");
+    auto mutator_time = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - last_gc_end).count();
+    size_t prev_major_gc_time = stats.major_gc_time;
 
     stats.newgen_gc_count += 1;
 
-    byte *prev_survivor_start = survivor_from_start;
-    byte *prev_survivor_end = survivor_alloc_point;
-
     size_t prev_object_cnt = stats.newgen_object_cnt;
     size_t prev_usage = (alloc_point - newgen_start) + (survivor_alloc_point - survivor_from_start);
     stats.newgen_object_cnt = 0;
@@ -146,6 +207,7 @@ void GCHeap::minor_gc_task() {
 
     stats.newgen_last_gc_object_cnt = stats.newgen_object_cnt;
     stats.newgen_last_gc_usage = survivor_alloc_point - survivor_from_start;
+    survival_rate = prev_usage == 0 ? 0 : (double)stats.newgen_last_gc_usage / prev_usage;
 
     if (Global::show_gc_statistics) {
       std::cout << "GC copy done\n";
@@ -156,47 +218,140 @@ void GCHeap::minor_gc_task() {
       std::cout << "ratio: " << (double)stats.newgen_object_cnt / prev_object_cnt << '\n';
     }
 
-    Timer timer_dealloc("dealloc dead");
-    byte *prev_alloc_point = alloc_point;
+    // The dead objects that need finalizing have been destroyed by the workers, so the new
+    // generation can simply be reset.
     alloc_point = newgen_start;
-    dealloc_progress = newgen_start;
+    roots.clear();
+    stack_frames.clear();
+    size_t gc_time = timer.end(Global::show_gc_statistics);
+    stats.total_time += gc_time;
+    stats.max_pause_time = std::max(stats.max_pause_time, gc_time);
+    adapt_sizes(gc_time - (stats.major_gc_time - prev_major_gc_time), gc_time, mutator_time);
+    last_gc_end = std::chrono::steady_clock::now();
 
     // let the mutator go
     gc_start = false;
     copy_done = true;
+    gc_running = false;
     lock.unlock();
     gc_cond_var.notify_one();
-    // dealloc
-    newgen_dealloc_dead_with_progress(newgen_start, prev_alloc_point);
-    newgen_dealloc_dead(prev_survivor_start, prev_survivor_end);
-
-    stats.dealloc_time += timer_dealloc.end(Global::show_gc_statistics);
-
-    gc_message("GC dealloc done");
-    roots.clear();
-    gc_running = false;
     gc_running.notify_one();
+  }
 
-    stats.total_time += timer.end(Global::show_gc_statistics);
+}
+
+void GCHeap::gc_worker_task(size_t index) {
+  Tracer::set_thread_name("GC worker");
+  size_t seen_epoch = 0;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(worker_mutex);
+      worker_cond_var.wait(lock, [&] { return scavenge_epoch != seen_epoch || helpers_stop; });
+      if (helpers_stop) return;
+      seen_epoch = scavenge_epoch;
+    }
+    scavenge(*workers[index]);
+    {
+      std::lock_guard<std::mutex> lock(worker_mutex);
+      running_helpers -= 1;
+    }
+    worker_cond_var.notify_all();
   }
+}
+
+void GCHeap::adapt_sizes(size_t pause_time, size_t gc_time, size_t mutator_time) {
+  size_policy.update(pause_time, gc_time, mutator_time, age_table, survivor_overflowed);
+  // The new generation is empty now, so the nursery can be resized freely.
+  newgen_gc_threshold = newgen_start + size_policy.get_nursery_size();
+  tenure_age = size_policy.get_tenure_age();
 
+  stats.nursery_size = size_policy.get_nursery_size();
+  stats.tenure_age = tenure_age;
+  stats.avg_pause_time = size_policy.get_avg_pause_us();
+  stats.gc_time_ratio = size_policy.get_avg_gc_time_ratio();
+  if (Global::show_gc_statistics) {
+    std::cout << "nursery size: " << memory_usage_readable(stats.nursery_size)
+              << ", tenuring age: " << tenure_age << '\n';
+  }
 }
 
 void GCHeap::major_gc() {
+  TraceScope trace("gc", "major GC");
+  PerfScope perf("major GC");
+  Timer timer("major gc");
+  stats.major_gc_count += 1;
+  release_pages(mutator_allocator);
+  // The pages left by the last major GC must be swept before marking. This also completes the
+  // statistics of the allocation sites.
+  finish_sweeping();
+  revise_pretenuring();
   mark_phase();
-  // remove dead objects from the record set
-  for (size_t i = 0; i < record_set.size(); ) {
-    if (not record_set[i]->gc_visited) {
-      record_set[i] = record_set.back();
-      record_set.pop_back();
-    } else {
-      i += 1;
+  vm.sweep_atoms();
+  sweep_phase();
+  stats.major_gc_time += timer.end(false);
+}
+
+template <typename F>
+void GCHeap::visit_frame_roots(JSStackFrame *frame, F&& func) {
+  func(&frame->function.as_GCObject);
+  visit_frame_slots(frame, [&] (JSValue *val) {
+    if (val->needs_gc()) func(&val->as_GCObject);
+  });
+}
+
+template <typename F>
+void GCHeap::visit_frame_slots(JSStackFrame *frame, F&& func) {
+  JSFunction *function = frame->function.as_func;
+  // the buffer of a native frame is not set up.
+  if (function->is_native()) return;
+
+  auto visit = [&] (JSValue *val) {
+    func(val);
+  };
+  auto visit_or_clear = [&] (JSValue *val, bool live) {
+    if (live) {
+      func(val);
+    } else if (val->needs_gc()) {
+      val->set_undefined();
+    }
+  };
+
+  JSValue *sp = *frame->sp_ref;
+  // `pc` has moved past the instruction being executed.
+  const uint64_t *live = function->meta->root_map.find(*frame->pc_ref - 1);
+  if (live == nullptr) {
+    for (JSValue *val = frame->buffer; val <= sp; val++) {
+      visit(val);
     }
+    return;
+  }
+
+  // The arguments are in this frame only if they are copied. The ones without a parameter are
+  // not covered by the map.
+  if (frame->args_buf == frame->buffer) {
+    u32 param_cnt = function->param_count;
+    for (JSValue *val = frame->args_buf; val < frame->local_vars; val++) {
+      u32 index = val - frame->args_buf;
+      visit_or_clear(val, index >= param_cnt || RootMap::slot_live(live, index));
+    }
+  }
+  u32 slot = function->param_count;
+  for (JSValue *val = frame->local_vars; val < frame->stack; val++, slot++) {
+    visit_or_clear(val, RootMap::slot_live(live, slot));
+  }
+  for (JSValue *val = frame->stack; val <= sp; val++) {
+    visit(val);
+  }
+}
+
+void GCHeap::gather_frame_roots(vector<GCObject **>& out) {
+  for (JSStackFrame *frame : stack_frames) {
+    visit_frame_roots(frame, [&] (GCObject **root) { out.push_back(root); });
   }
-  sweep_phase();
 }
 
 void GCHeap::gather_roots() {
+  TraceScope trace("gc", "roots");
   if (const_roots.empty()) [[unlikely]] {
     const_roots.push_back(&vm.global_object.as_GCObject);
     const_roots.push_back(&vm.global_func.as_GCObject);
@@ -211,6 +366,9 @@ void GCHeap::gather_roots() {
     const_roots.push_back(&vm.regexp_prototype.as_GCObject);
     const_roots.push_back(&vm.date_prototype.as_GCObject);
     const_roots.push_back(&vm.iterator_prototype.as_GCObject);
+    const_roots.push_back(&vm.promise_prototype.as_GCObject);
+    const_roots.push_back(&vm.generator_prototype.as_GCObject);
+    const_roots.push_back(&vm.generator_function_ctor.as_GCObject);
 
     for (auto& val : vm.native_error_protos) {
       const_roots.push_back(&val.as_GCObject);
@@ -219,19 +377,15 @@ void GCHeap::gather_roots() {
     for (auto& val : vm.string_const) {
       const_roots.push_back(&val.as_GCObject);
     }
+    for (auto& val : vm.int_string_cache) {
+      const_roots.push_back(&val.as_GCObject);
+    }
   }
+  vm.num_string_cache.fill({});
 
-  // All values on the rt_stack are possible roots
-  JSStackFrame *frame = vm.curr_frame;
-  while (frame) {
-    roots.push_back(&frame->function.as_GCObject);
-    // do we need to check frame->alloc_cnt != 0 here?
-    for (JSValue *val = frame->buffer; val <= *frame->sp_ref; val++) {
-      if (val->needs_gc()) {
-        roots.push_back(&val->as_GCObject);
-      }
-    }
-    frame = frame->prev_frame;
+  // The slots of the frames are visited by the workers, according to the root maps.
+  for (JSStackFrame *frame = vm.curr_frame; frame; frame = frame->prev_frame) {
+    stack_frames.push_back(frame);
   }
 
   for (auto& task : vm.micro_task_queue) {
@@ -249,171 +403,722 @@ void GCHeap::gather_roots() {
 }
 
 void GCHeap::newgen_copy_alive() {
-  survivor_alloc_point = survivor_to_start;
   gather_roots();
 
-#define COPY_TASK                                                               \
-  if (*root < reinterpret_cast<GCObject *>(oldgen_start)) {                     \
-    *root = copy_object(*root);                                                 \
+  // The workers can not run a major GC while they are promoting objects, so make sure in advance
+  // that the old generation can hold the objects to be promoted: everything in the from-space,
+  // and the objects that are expected to overflow the to-space.
+  size_t survivor_usage = survivor_alloc_point - survivor_from_start;
+  size_t survivor_size = survivor2_start - survivor1_start;
+  size_t expected_copy = 2 * survival_rate * (alloc_point - newgen_start);
+  size_t expected_overflow = expected_copy > survivor_size ? expected_copy - survivor_size : 0;
+  size_t oldgen_needed = survivor_usage + expected_overflow + workers.size() * OLDGEN_PAGE_SIZE;
+  flush_sweep_stats(mutator_allocator);
+
+  // Only the free pages count: the free cells in the other pages may be of the wrong size classes.
+  auto oldgen_free_size = [this] () {
+    return (pages.size() - page_frontier + free_pages.size()) * OLDGEN_PAGE_SIZE;
+  };
+  bool need_major_gc = major_gc_requested;
+  if (not need_major_gc && oldgen_free_size() < oldgen_needed) {
+    // the memory of the dead objects may be in the pages that are not swept yet.
+    finish_sweeping();
+    need_major_gc = oldgen_free_size() < oldgen_needed;
+  }
+  if (need_major_gc) {
+    gc_message("major GC");
+    major_gc();
   }
 
-  for (GCObject **root : const_roots) {
-    // only copy those in the new generation area
-    COPY_TASK
+  scavenge_roots.clear();
+  scavenge_roots.insert(scavenge_roots.end(), const_roots.begin(), const_roots.end());
+  scavenge_roots.insert(scavenge_roots.end(), roots.begin(), roots.end());
+  scavenge_roots.insert(scavenge_roots.end(), vm.temp_roots.begin(), vm.temp_roots.end());
+  prepare_card_tasks();
+
+  to_space_top = survivor_to_start;
+  next_root = 0;
+  next_frame = 0;
+  next_card_task = 0;
+  next_finalizer = 0;
+  idle_workers = 0;
+
+  {
+    TraceScope trace("gc", "copy");
+    {
+      std::lock_guard<std::mutex> lock(worker_mutex);
+      running_helpers = helper_threads.size();
+      scavenge_epoch += 1;
+    }
+    worker_cond_var.notify_all();
+    scavenge(*workers[0]);
+    std::unique_lock<std::mutex> lock(worker_mutex);
+    worker_cond_var.wait(lock, [this] { return running_helpers == 0; });
   }
-  for (GCObject **root : roots) {
-    COPY_TASK
+  age_table.fill(0);
+  survivor_overflowed = false;
+
+  newgen_finalizers.clear();
+  survivor_finalizers.clear();
+
+  for (auto& worker : workers) {
+    retire_lab(*worker);
+    release_pages(worker->oldgen_allocator);
+    flush_sweep_stats(worker->oldgen_allocator);
+
+    for (GCObject *obj : worker->young_referrers) {
+      dirty_object_cards(obj);
+    }
+    worker->young_referrers.clear();
+    survivor_finalizers.insert(survivor_finalizers.end(),
+                               worker->finalizers.begin(), worker->finalizers.end());
+    worker->finalizers.clear();
+
+    stats.newgen_object_cnt += worker->copied_cnt;
+    stats.oldgen_object_cnt += worker->promoted_cnt;
+    stats.oldgen_usage += worker->promoted_size;
+    worker->copied_cnt = 0;
+    worker->promoted_cnt = 0;
+    worker->promoted_size = 0;
+
+    for (size_t age = 0; age < age_table.size(); age++) {
+      age_table[age] += worker->age_table[age];
+    }
+    worker->age_table.fill(0);
+    survivor_overflowed |= worker->overflowed;
+    worker->overflowed = false;
   }
-  for (GCObject **root : vm.temp_roots) {
-    COPY_TASK
+
+  survivor_alloc_point = to_space_top;
+  std::swap(survivor_from_start, survivor_to_start);
+
+  update_pretenuring();
+}
+
+void GCHeap::init_alloc_sites(u32 count) {
+  // site 0 is reserved for unknown sites
+  alloc_site_cnt = count + 1;
+  // The heap profiler tags the objects allocated elsewhere with the ids after these sites.
+  size_t capacity = profiler.is_tracking() ? UINT16_MAX + 1 : alloc_site_cnt;
+  alloc_sites = std::make_unique<AllocSite[]>(capacity);
+}
+
+GCObject* GCHeap::site_alloc(u32& size) {
+  AllocSite& site = alloc_sites[alloc_site];
+  if (not site.pretenure) {
+    site.alloc_cnt += 1;
+    return nullptr;
   }
 
-#undef COPY_TASK
+  GCObject *obj = oldgen_alloc(mutator_allocator, size);
+  if (obj == nullptr) return nullptr;
 
-  for (size_t i = 0; i < record_set.size(); ) {
-    // update the fields of the objects in the record_set
-    bool child_young = record_set[i]->gc_scan_children(*this);
-    if (not child_young) {
-      record_set[i]->gc_remembered = false;
-      record_set[i] = record_set.back();
-      record_set.pop_back();
-    } else {
-      i += 1;
+  size = obj->size;
+  stats.oldgen_object_cnt += 1;
+  stats.oldgen_usage += size;
+  stats.pretenured_object_cnt += 1;
+
+  // The fields of the new object are initialized without the write barrier, so dirty its cards
+  // to have it scanned in the next minor GC.
+  dirty_object_cards(obj);
+  return obj;
+}
+
+GCObject* GCHeap::large_alloc(u32& size) {
+  size_t page_cnt = (size + os_page_size - 1) / os_page_size;
+  size_t page = large_space.alloc_pages(page_cnt);
+  if (page == LargeObjectSpace::NO_PAGE) {
+    fprintf(stderr, "memory allocation failed\n");
+    exit(EXIT_FAILURE);
+  }
+
+  auto *obj = reinterpret_cast<GCObject *>(large_space_start + page * os_page_size);
+  size = page_cnt * os_page_size;
+  obj->size = size;
+  large_objects.push_back(obj);
+  stats.large_object_cnt += 1;
+  stats.large_object_usage += size;
+
+  if (stats.large_object_usage > large_space_gc_threshold) {
+    gc_requested = true;
+    major_gc_requested = true;
+  }
+  // like the pretenured objects, the fields are initialized without the write barrier.
+  dirty_object_cards(obj);
+  return obj;
+}
+
+void GCHeap::large_free(GCObject *obj) {
+  size_t size = obj->size;
+  obj->~GCObject();
+  stats.large_object_cnt -= 1;
+  stats.large_object_usage -= size;
+
+  // give the memory back to the OS, while keeping the address range reserved.
+  auto *start = reinterpret_cast<byte *>(obj);
+  madvise(start, size, MADV_DONTNEED);
+  large_space.free_pages((start - large_space_start) / os_page_size, size / os_page_size);
+}
+
+void GCHeap::update_pretenuring() {
+  for (u32 i = 1; i < alloc_site_cnt; i++) {
+    AllocSite& site = alloc_sites[i];
+    if (site.pretenure || site.alloc_cnt < PRETENURE_MIN_SAMPLE) continue;
+
+    u32 survive_cnt = site.survive_cnt.load(std::memory_order_relaxed);
+    if (survive_cnt >= PRETENURE_SURVIVAL_RATE * site.alloc_cnt) {
+      site.pretenure = true;
+      stats.pretenured_site_cnt += 1;
     }
+    site.alloc_cnt = 0;
+    site.survive_cnt.store(0, std::memory_order_relaxed);
   }
+}
 
-  std::swap(survivor_from_start, survivor_to_start);
+void GCHeap::revise_pretenuring() {
+  // Stop pretenuring the sites whose objects mostly die in the old generation.
+  for (u32 i = 1; i < alloc_site_cnt; i++) {
+    AllocSite& site = alloc_sites[i];
+    u32 live_cnt = site.oldgen_live_cnt.load(std::memory_order_relaxed);
+    u32 dead_cnt = site.oldgen_dead_cnt.load(std::memory_order_relaxed);
+    if (site.pretenure && dead_cnt > live_cnt) {
+      site.pretenure = false;
+      stats.pretenured_site_cnt -= 1;
+    }
+    site.oldgen_live_cnt.store(0, std::memory_order_relaxed);
+    site.oldgen_dead_cnt.store(0, std::memory_order_relaxed);
+  }
 }
 
-void GCHeap::newgen_dealloc_dead(byte *start, byte *end) {
-  for (byte *ptr = start; ptr < end; ) {
-    auto *obj = reinterpret_cast<GCObject *>(ptr);
-    ptr += obj->size;
-    if (obj->forward_ptr == nullptr) {
-      obj->~GCObject();
+void GCHeap::scavenge(GCWorker& worker) {
+  TraceScope trace("gc", "scavenge");
+  PerfScope perf("GC copy");
+  current_worker = &worker;
+
+  size_t root_cnt = scavenge_roots.size();
+  while (true) {
+    size_t begin = next_root.fetch_add(ROOT_BATCH);
+    if (begin >= root_cnt) break;
+    size_t end = std::min(begin + ROOT_BATCH, root_cnt);
+
+    for (size_t i = begin; i < end; i++) {
+      GCObject **root = scavenge_roots[i];
+      // only copy those in the new generation area
+      if (*root < reinterpret_cast<GCObject *>(oldgen_start)) {
+        *root = copy_object(*root);
+      }
+    }
+    drain_local(worker);
+  }
+
+  size_t frame_cnt = stack_frames.size();
+  while (true) {
+    size_t begin = next_frame.fetch_add(FRAME_BATCH);
+    if (begin >= frame_cnt) break;
+    size_t end = std::min(begin + FRAME_BATCH, frame_cnt);
+
+    for (size_t i = begin; i < end; i++) {
+      visit_frame_roots(stack_frames[i], [this] (GCObject **root) {
+        if (*root < reinterpret_cast<GCObject *>(oldgen_start)) {
+          *root = copy_object(*root);
+        }
+      });
+    }
+    drain_local(worker);
+  }
+
+  while (true) {
+    size_t index = next_card_task.fetch_add(1);
+    if (index >= card_tasks.size()) break;
+    scan_card_task(card_tasks[index]);
+    drain_local(worker);
+  }
+
+  // Termination: a worker becomes idle when it finds no grey object anywhere. Idle workers do
+  // not produce grey objects, so when all workers are idle, the queues are all empty.
+  while (true) {
+    if (GCObject *obj = pop_grey(worker)) {
+      scan_grey(worker, obj);
+      continue;
+    }
+
+    idle_workers.fetch_add(1);
+    while (true) {
+      if (idle_workers.load() == workers.size()) {
+        // all the survivors have been copied.
+        finalize_dead();
+        current_worker = nullptr;
+        return;
+      }
+      if (has_shared_work()) {
+        idle_workers.fetch_sub(1);
+        break;
+      }
+      std::this_thread::yield();
     }
   }
 }
 
-void GCHeap::oldgen_dealloc_dead(byte *start, byte *end) {
-  for (byte *ptr = start; ptr < end; ) {
-    auto *obj = reinterpret_cast<GCObject *>(ptr);
-    ptr += obj->size;
-    if (not obj->gc_free) {
-      obj->~GCObject();
+void GCHeap::finalize_dead() {
+  TraceScope trace("gc", "dealloc");
+  size_t newgen_cnt = newgen_finalizers.size();
+  size_t total_cnt = newgen_cnt + survivor_finalizers.size();
+  while (true) {
+    size_t begin = next_finalizer.fetch_add(FINALIZER_BATCH);
+    if (begin >= total_cnt) break;
+    size_t end = std::min(begin + FINALIZER_BATCH, total_cnt);
+
+    for (size_t i = begin; i < end; i++) {
+      GCObject *obj = i < newgen_cnt ? newgen_finalizers[i] : survivor_finalizers[i - newgen_cnt];
+      // the survivors have been forwarded
+      if (obj->forward_ptr == nullptr) {
+        obj->~GCObject();
+      }
     }
   }
 }
 
-void GCHeap::newgen_dealloc_dead_with_progress(byte *start, byte *end) {
-  for (byte *ptr = start; ptr < end; ) {
-    auto *obj = reinterpret_cast<GCObject *>(ptr);
-    ptr += obj->size;
-    if (obj->forward_ptr == nullptr) {
-      obj->~GCObject();
+void GCHeap::scan_grey(GCWorker& worker, GCObject *obj) {
+  bool child_young = obj->gc_scan_children(*this);
+  // The cards of the promoted objects are dirtied after all workers finish, so that it won't be
+  // overwritten by a card task.
+  if (child_young && obj >= reinterpret_cast<GCObject *>(oldgen_start)) {
+    worker.young_referrers.push_back(obj);
+  }
+}
+
+void GCHeap::push_grey(GCWorker& worker, GCObject *obj) {
+  auto& local = worker.local;
+  local.push_back(obj);
+
+  if (workers.size() > 1 && local.size() >= 2 * GREY_PUBLISH_BATCH
+      && worker.shared_size.load(std::memory_order_relaxed) == 0) {
+    std::lock_guard<std::mutex> lock(worker.shared_mutex);
+    worker.shared.insert(worker.shared.end(), local.begin(), local.begin() + GREY_PUBLISH_BATCH);
+    worker.shared_size = worker.shared.size();
+    local.erase(local.begin(), local.begin() + GREY_PUBLISH_BATCH);
+  }
+}
+
+GCObject* GCHeap::pop_grey(GCWorker& worker) {
+  if (not worker.local.empty()) {
+    GCObject *obj = worker.local.back();
+    worker.local.pop_back();
+    return obj;
+  }
+
+  // take back the published objects first, then steal from the other workers.
+  size_t worker_cnt = workers.size();
+  for (size_t i = 0; i < worker_cnt; i++) {
+    GCWorker *victim = workers[(worker.index + i) % worker_cnt].get();
+    if (victim->shared_size.load(std::memory_order_relaxed) == 0) continue;
+
+    std::lock_guard<std::mutex> lock(victim->shared_mutex);
+    if (victim->shared.empty()) continue;
+    GCObject *obj;
+    if (victim == &worker) {
+      obj = victim->shared.back();
+      victim->shared.pop_back();
+    } else {
+      obj = victim->shared.front();
+      victim->shared.pop_front();
     }
-    dealloc_progress = ptr;
+    victim->shared_size = victim->shared.size();
+    return obj;
   }
-  dealloc_progress = survivor1_start;
+  return nullptr;
 }
 
-GCObject* GCHeap::copy_object(GCObject *obj) {
-  GCObject *obj_new = obj->forward_ptr;
-  if (obj_new == nullptr) {
-    stats.newgen_object_cnt += 1;
-    if (obj->gc_age < AGE_MAX) {
-      obj_new = (GCObject *)survivor_alloc_point;
-      survivor_alloc_point += obj->size;
+void GCHeap::drain_local(GCWorker& worker) {
+  while (not worker.local.empty()) {
+    GCObject *obj = worker.local.back();
+    worker.local.pop_back();
+    scan_grey(worker, obj);
+  }
+}
 
-      memcpy((void *)obj_new, (void *)obj, obj->size);
-      obj->forward_ptr = obj_new;
+bool GCHeap::has_shared_work() {
+  for (auto& worker : workers) {
+    if (worker->shared_size.load() != 0) return true;
+  }
+  return false;
+}
 
-      obj_new->gc_age += 1;
-      obj_new->gc_scan_children(*this);
+void GCHeap::prepare_card_tasks() {
+  card_tasks.clear();
+  card_task_objects.clear();
+
+  size_t card_cnt = size_t(page_frontier) << (OLDGEN_PAGE_SHIFT - CARD_SHIFT);
+  uint8_t *cards = card_table.data();
+
+  for (size_t i = 0; i < card_cnt; ) {
+    // skip clean cards, 8 cards at a time
+    if (i + 8 <= card_cnt) {
+      uint64_t eight_cards;
+      memcpy(&eight_cards, cards + i, sizeof(uint64_t));
+      if (eight_cards == 0) {
+        i += 8;
+        continue;
+      }
     }
-    else {
-      obj_new = promote(obj);
+    if (cards[i] == CARD_DIRTY) {
+      byte *card_start = oldgen_start + (i << CARD_SHIFT);
+      u32 index = page_index(card_start);
+      OldgenPage& page = pages[index];
+      u32 obj_begin = card_task_objects.size();
+
+      if (page.kind == OldgenPage::SMALL) {
+        // the dead objects in the page may point to freed memory.
+        if (page.need_sweep) sweep_page_eagerly(index, workers[0]->oldgen_allocator);
+
+        size_t offset = card_start - page_start(index);
+        u32 first_cell = offset / page.cell_size;
+        size_t last_cell = std::min<size_t>((offset + CARD_SIZE - 1) / page.cell_size,
+                                            page.cell_cnt - 1);
+        for (size_t cell = first_cell; cell <= last_cell; cell++) {
+          if (page.cell_allocated(cell)) {
+            byte *cell_start = page_start(index) + size_t(cell) * page.cell_size;
+            card_task_objects.push_back(reinterpret_cast<GCObject *>(cell_start));
+          }
+        }
+      }
+
+      if (card_task_objects.size() == obj_begin) {
+        cards[i] = CARD_CLEAN;
+      } else {
+        card_tasks.push_back({ u32(i), obj_begin, u32(card_task_objects.size()) });
+      }
+    }
+    i += 1;
+  }
+
+  // a large object covers its cards alone.
+  for (GCObject *obj : large_objects) {
+    size_t last_card = card_index(reinterpret_cast<byte *>(obj) + obj->size - 1);
+    for (size_t card = card_index(obj); card <= last_card; card++) {
+      if (cards[card] == CARD_DIRTY) {
+        card_tasks.push_back({ u32(card), u32(card_task_objects.size()),
+                               u32(card_task_objects.size() + 1) });
+        card_task_objects.push_back(obj);
+      }
     }
   }
-  assert(obj_new >= (GCObject *)survivor1_start);
-  return obj_new;
 }
 
-GCObject* GCHeap::promote(GCObject *obj) {
-  assert(obj->forward_ptr == nullptr);
+void GCHeap::scan_card_task(const CardTask& task) {
+  byte *card_start = oldgen_start + (size_t(task.card) << CARD_SHIFT);
+  byte *card_end = card_start + CARD_SIZE;
+  bool child_young = false;
 
-  GCObject *obj_new = oldgen_alloc(obj->size);
-  size_t actual_size = obj_new->size;
+  for (u32 i = task.obj_begin; i < task.obj_end; i++) {
+    child_young |= card_task_objects[i]->gc_scan_card(*this, card_start, card_end);
+  }
+  card_table[task.card] = child_young ? CARD_DIRTY : CARD_CLEAN;
+}
 
-  stats.oldgen_object_cnt += 1;
-  stats.oldgen_usage += actual_size;
+void GCHeap::dirty_object_cards(GCObject *obj) {
+  byte *obj_start = reinterpret_cast<byte *>(obj);
+  size_t last_card = card_index(obj_start + obj->size - 1);
+  for (size_t card = card_index(obj_start); card <= last_card; card++) {
+    card_table[card] = CARD_DIRTY;
+  }
+}
+
+GCObject* GCHeap::copy_object(GCObject *obj) {
+  // The object has already been copied in this GC. This can happen when a root is
+  // gathered more than once.
+  if (obj >= (GCObject *)survivor_to_start && obj < (GCObject *)survivor_to_end()) {
+    return obj;
+  }
+  std::atomic_ref<GCObject *> forward_ptr(obj->forward_ptr);
+  GCObject *obj_new = forward_ptr.load(std::memory_order_acquire);
+  if (obj_new != nullptr) return obj_new;
+
+  GCWorker& worker = *current_worker;
+  size_t size = obj->size;
+  bool promoted = false;
+
+  if (obj->gc_age < tenure_age) {
+    obj_new = survivor_alloc(worker, size);
+    if (obj_new == nullptr) worker.overflowed = true;
+  }
+  // promote the object if it's old enough or the to-space is full.
+  if (obj_new == nullptr) {
+    obj_new = promote_alloc(worker, size);
+    promoted = true;
+  }
 
-  memcpy((void *)obj_new, (void *)obj, obj->size);
-  obj_new->size = actual_size;
-  obj_new->gc_free = false;
+  u32 block_size = obj_new->size;
+  memcpy((void *)obj_new, (void *)obj, size);
+  obj_new->size = block_size;
+  obj_new->forward_ptr = nullptr;
   obj_new->gc_visited = false;
-  obj_new->gc_remembered = false;
-  obj->forward_ptr = obj_new;
 
-  if (obj_new->gc_has_young_child(reinterpret_cast<GCObject *>(oldgen_start))) {
-    record_set.push_back(obj_new);
-    obj_new->gc_remembered = true;
+  GCObject *winner = nullptr;
+  if (not forward_ptr.compare_exchange_strong(winner, obj_new,
+                                              std::memory_order_acq_rel,
+                                              std::memory_order_acquire)) {
+    // another worker has copied this object.
+    if (promoted) {
+      oldgen_undo_alloc(worker.oldgen_allocator, obj_new);
+    } else {
+      survivor_undo_alloc(worker, obj_new, size);
+    }
+    return winner;
   }
 
+  if (promoted) {
+    worker.promoted_cnt += 1;
+    worker.promoted_size += block_size;
+  } else {
+    obj_new->gc_age += 1;
+    worker.copied_cnt += 1;
+    worker.age_table[obj_new->gc_age] += block_size;
+    if (obj_new->gc_finalize) {
+      worker.finalizers.push_back(obj_new);
+    }
+  }
+  // the object survives its first minor GC
+  if (obj->gc_age == 0 && obj->alloc_site != 0) {
+    alloc_sites[obj->alloc_site].survive_cnt.fetch_add(1, std::memory_order_relaxed);
+  }
+  push_grey(worker, obj_new);
+
   return obj_new;
 }
 
-GCObject* GCHeap::oldgen_alloc(size_t size) {
-  GCObject* obj;
-  if (oldgen_alloc_point + size <= oldgen_end) {
-    obj = reinterpret_cast<GCObject *>(oldgen_alloc_point);
-    oldgen_alloc_point += size;
-    obj->size = size;
+GCObject* GCHeap::survivor_alloc(GCWorker& worker, size_t size) {
+  if (size > LAB_OBJECT_MAX) {
+    return survivor_claim(size);
+  }
+  if (worker.lab_top + size > worker.lab_end) {
+    retire_lab(worker);
+    auto *lab = reinterpret_cast<byte *>(survivor_claim(LAB_SIZE));
+    if (lab == nullptr) {
+      return survivor_claim(size);
+    }
+    worker.lab_top = lab;
+    worker.lab_end = lab + LAB_SIZE;
   }
-  else {
-    int free_list_index = size_to_index(size);
-    int curr_index = free_list_index;
-    bool did_gc = false;
 
-    while (true) {
-      auto& list = free_list[curr_index];
-      for (GCObject *free_obj : list) {
-        if (free_obj->size >= size) {
-          obj = free_obj;
-          goto slot_found;
-        }
-      }
-      curr_index += 1;
-
-      if (curr_index > 7) {
-        if (not did_gc) {
-          major_gc();
-          // retry
-          curr_index = free_list_index;
-          did_gc = true;
-        } else {
-          fprintf(stderr, "memory allocation failed\n");
-          exit(EXIT_FAILURE);
-        }
+  auto *obj = reinterpret_cast<GCObject *>(worker.lab_top);
+  worker.lab_top += size;
+  worker.lab_prev_last = worker.lab_last;
+  worker.lab_last = obj;
+  obj->size = size;
+  return obj;
+}
+
+void GCHeap::survivor_undo_alloc(GCWorker& worker, GCObject *obj, size_t size) {
+  if (obj == worker.lab_last) {
+    worker.lab_top = reinterpret_cast<byte *>(obj);
+    worker.lab_last = worker.lab_prev_last;
+  } else {
+    make_filler(reinterpret_cast<byte *>(obj), size);
+  }
+}
+
+GCObject* GCHeap::survivor_claim(size_t size) {
+  byte *top = to_space_top.load(std::memory_order_relaxed);
+  do {
+    if (top + size > survivor_to_end()) return nullptr;
+  } while (not to_space_top.compare_exchange_weak(top, top + size, std::memory_order_relaxed));
+
+  auto *obj = reinterpret_cast<GCObject *>(top);
+  obj->size = size;
+  return obj;
+}
+
+void GCHeap::retire_lab(GCWorker& worker) {
+  size_t remain = worker.lab_end - worker.lab_top;
+  if (remain >= sizeof(GCObject)) {
+    make_filler(worker.lab_top, remain);
+  } else if (remain != 0) {
+    // too small for a filler, give it to the last object.
+    worker.lab_last->size += remain;
+  }
+  worker.lab_top = worker.lab_end = nullptr;
+  worker.lab_last = worker.lab_prev_last = nullptr;
+}
+
+GCObject* GCHeap::promote_alloc(GCWorker& worker, size_t size) {
+  GCObject *obj = oldgen_alloc(worker.oldgen_allocator, size);
+  if (obj == nullptr) {
+    fprintf(stderr, "memory allocation failed\n");
+    exit(EXIT_FAILURE);
+  }
+  return obj;
+}
+
+void GCHeap::make_filler(byte *start, size_t size) {
+  // A filler is never reachable. Its forwarding pointer points to itself so that it can be told
+  // apart from the objects when the space is walked.
+  auto *filler = reinterpret_cast<GCObject *>(start);
+  filler->size = size;
+  filler->forward_ptr = filler;
+}
+
+GCObject* GCHeap::oldgen_alloc(OldgenAllocator& allocator, size_t size) {
+  assert(size <= MAX_CELL_SIZE);
+  size_t size_class = size_class_of(size);
+  u32& curr = allocator.curr_page[size_class];
+  while (true) {
+    if (curr != NO_PAGE) {
+      OldgenPage& page = pages[curr];
+      int cell = page.alloc_cell();
+      if (cell != -1) {
+        byte *cell_start = page_start(curr) + size_t(cell) * page.cell_size;
+        auto *obj = reinterpret_cast<GCObject *>(cell_start);
+        obj->size = page.cell_size;
+        return obj;
       }
+      // the page is full. It's put in a list again after the next major GC.
+      std::lock_guard<std::mutex> lock(oldgen_mutex);
+      page.owned = false;
+    }
+    curr = acquire_page(allocator, size_class);
+    if (curr == NO_PAGE) return nullptr;
+  }
+}
+
+void GCHeap::oldgen_undo_alloc(OldgenAllocator& allocator, GCObject *obj) {
+  // the page is still owned by the allocator.
+  u32 index = page_index(obj);
+  OldgenPage& page = pages[index];
+  page.free_cell((reinterpret_cast<byte *>(obj) - page_start(index)) / page.cell_size);
+}
+
+u32 GCHeap::acquire_page(OldgenAllocator& allocator, size_t size_class) {
+  std::unique_lock<std::mutex> lock(oldgen_mutex);
+
+  auto& partial = partial_pages[size_class];
+  while (not partial.empty()) {
+    u32 index = partial.back();
+    partial.pop_back();
+    OldgenPage& page = pages[index];
+    if (not page.owned && page.kind == OldgenPage::SMALL && page.size_class == size_class
+        && not page.need_sweep && page.free_cnt != 0) {
+      page.owned = true;
+      return index;
     }
+  }
+
+  auto& unswept = unswept_pages[size_class];
+  while (not unswept.empty()) {
+    u32 index = unswept.back();
+    unswept.pop_back();
+    OldgenPage& page = pages[index];
+    if (page.owned || page.kind != OldgenPage::SMALL || not page.need_sweep) continue;
+
+    page.owned = true;
+    lock.unlock();
+    sweep_page(page, allocator);
+    lock.lock();
+    if (page.free_cnt != 0) return index;
+    page.owned = false;
+  }
 
-    slot_found:
-    if (obj->size - size >= 40) [[unlikely]] {
-      auto *divided = reinterpret_cast<GCObject *>(reinterpret_cast<byte *>(obj) + size);
-      size_t divided_size = obj->size - size;
-      divided->gc_free = true;
-      divided->size = divided_size;
-      free_list[size_to_index(divided_size)].push_back(divided);
+  u32 index = take_free_page();
+  if (index != NO_PAGE) {
+    pages[index].init_small(size_class);
+    pages[index].owned = true;
+  }
+  return index;
+}
 
-      obj->size = size;
+void GCHeap::release_pages(OldgenAllocator& allocator) {
+  std::lock_guard<std::mutex> lock(oldgen_mutex);
+  for (u32& index : allocator.curr_page) {
+    if (index == NO_PAGE) continue;
+    OldgenPage& page = pages[index];
+    page.owned = false;
+    if (page.free_cnt == page.cell_cnt) {
+      return_free_page(index);
+    } else if (page.free_cnt != 0) {
+      partial_pages[page.size_class].push_back(index);
     }
+    index = NO_PAGE;
   }
+}
 
-  return obj;
+void GCHeap::flush_sweep_stats(OldgenAllocator& allocator) {
+  stats.oldgen_object_cnt -= allocator.freed_cnt;
+  stats.oldgen_usage -= allocator.freed_size;
+  allocator.freed_cnt = 0;
+  allocator.freed_size = 0;
+}
+
+u32 GCHeap::take_free_page() {
+  while (not free_pages.empty()) {
+    u32 index = free_pages.back();
+    free_pages.pop_back();
+    if (pages[index].in_free_list && pages[index].kind == OldgenPage::FREE) {
+      pages[index].in_free_list = false;
+      return index;
+    }
+  }
+  if (page_frontier < pages.size()) {
+    return page_frontier++;
+  }
+  return NO_PAGE;
+}
+
+void GCHeap::return_free_page(u32 index) {
+  OldgenPage& page = pages[index];
+  page.kind = OldgenPage::FREE;
+  page.need_sweep = false;
+  if (not page.in_free_list) {
+    page.in_free_list = true;
+    free_pages.push_back(index);
+  }
+}
+
+void GCHeap::sweep_page(OldgenPage& page, OldgenAllocator& allocator) {
+  byte *start = page_start(&page - pages.data());
+  page.for_each_allocated([&, this] (u32 cell) {
+    auto *obj = reinterpret_cast<GCObject *>(start + size_t(cell) * page.cell_size);
+    AllocSite& site = alloc_sites[obj->alloc_site];
+    if (obj->gc_visited) {
+      obj->gc_visited = false;
+      site.oldgen_live_cnt.fetch_add(1, std::memory_order_relaxed);
+    } else {
+      site.oldgen_dead_cnt.fetch_add(1, std::memory_order_relaxed);
+      obj->~GCObject();
+      page.free_cell(cell);
+      allocator.freed_cnt += 1;
+      allocator.freed_size += page.cell_size;
+    }
+  });
+  page.need_sweep = false;
+}
+
+void GCHeap::sweep_page_eagerly(u32 index, OldgenAllocator& allocator) {
+  OldgenPage& page = pages[index];
+  sweep_page(page, allocator);
+  if (page.free_cnt == page.cell_cnt) {
+    return_free_page(index);
+  } else if (page.free_cnt != 0) {
+    partial_pages[page.size_class].push_back(index);
+  }
+}
+
+void GCHeap::finish_sweeping() {
+  TraceScope trace("gc", "finish sweeping");
+  for (auto& unswept : unswept_pages) {
+    for (u32 index : unswept) {
+      OldgenPage& page = pages[index];
+      if (page.kind == OldgenPage::SMALL && page.need_sweep && not page.owned) {
+        sweep_page_eagerly(index, mutator_allocator);
+      }
+    }
+    unswept.clear();
+  }
+  flush_sweep_stats(mutator_allocator);
 }
 
 void GCHeap::mark_phase() {
+  TraceScope trace("gc", "mark");
+  vm.atom_pool.begin_mark();
 #define MARK_TASK                                               \
   auto *gc_object = *root;                                      \
   if (not gc_object->gc_visited) {                              \
@@ -429,28 +1134,64 @@ void GCHeap::mark_phase() {
   for (GCObject **root : vm.temp_roots) {
     MARK_TASK
   }
+  for (JSStackFrame *frame : stack_frames) {
+    GCObject **root = &frame->function.as_GCObject;
+    MARK_TASK
+    // the slots may also hold atoms and symbols.
+    visit_frame_slots(frame, [] (JSValue *val) { gc_check_and_mark_object(*val); });
+  }
+  // the objects of the tasks are in `roots`, but not their atoms and symbols.
+  for (auto& task : vm.micro_task_queue) {
+    for (auto& val : task.args) {
+      if (val.holds_atom()) gc_mark_atom(val.as_atom);
+    }
+  }
 }
 
 void GCHeap::sweep_phase() {
-  byte *current = oldgen_start;
-
-  while (current != oldgen_alloc_point) {
-    auto *obj = reinterpret_cast<GCObject *>(current);
-    if (not obj->gc_visited) {
-      if (not obj->gc_free) {
-        obj->~GCObject();
-        obj->gc_free = true;
-        int index = size_to_index(obj->size);
-        free_list[index].push_back(obj);
+  TraceScope trace("gc", "sweep");
+  for (auto& partial : partial_pages) {
+    partial.clear();
+  }
 
-        stats.oldgen_object_cnt -= 1;
-        stats.oldgen_usage -= obj->size;
+  for (u32 i = 0; i < page_frontier; i++) {
+    OldgenPage& page = pages[i];
+    if (page.kind == OldgenPage::SMALL) {
+      assert(not page.owned);
+      if (page.free_cnt == page.cell_cnt) {
+        return_free_page(i);
+      } else {
+        page.need_sweep = true;
+        unswept_pages[page.size_class].push_back(i);
       }
-    } else {
+    }
+  }
+
+  // the large objects are not moved, so they can be swept right now.
+  size_t live_cnt = 0;
+  for (GCObject *obj : large_objects) {
+    if (obj->gc_visited) {
       obj->gc_visited = false;
+      large_objects[live_cnt++] = obj;
+    } else {
+      large_free(obj);
     }
+  }
+  large_objects.resize(live_cnt);
+  major_gc_requested = false;
+  size_t large_space_size = large_space_end - large_space_start;
+  large_space_gc_threshold = std::max(2 * stats.large_object_usage, large_space_size / 8);
+}
 
-    current += obj->size;
+void GCHeap::oldgen_dealloc_all() {
+  for (u32 i = 0; i < page_frontier; i++) {
+    OldgenPage& page = pages[i];
+    byte *start = page_start(i);
+    if (page.kind == OldgenPage::SMALL) {
+      page.for_each_allocated([&] (u32 cell) {
+        reinterpret_cast<GCObject *>(start + size_t(cell) * page.cell_size)->~GCObject();
+      });
+    }
   }
 }
 
@@ -458,42 +1199,106 @@ void GCHeap::check_fwd_pointer(byte *start, byte *end) {
   for (byte *ptr = start; ptr < end; ) {
     auto *obj = reinterpret_cast<GCObject *>(ptr);
     assert(obj->size % 8 == 0);
-    assert(obj->forward_ptr == nullptr);
+    // fillers point to themselves
+    assert(obj->forward_ptr == nullptr || obj->forward_ptr == obj);
     ptr += obj->size;
   }
 }
 
-PrimitiveString* GCHeap::new_prim_string_ref(u16string_view str) {
-  GCObject *ptr = newgen_alloc(sizeof(PrimitiveString));
+PrimitiveString* GCHeap::new_prim_string_ref(u16string_view str, bool latin1) {
+  u32 size = sizeof(PrimitiveString);
+  GCObject *ptr = alloc(size);
   auto *prim_str = new (ptr) PrimitiveString(0);
-  prim_str->init_with_ref(str.data(), str.size());
-  ptr->size = sizeof(PrimitiveString);
+  prim_str->init_with_ref(str.data(), str.size(), latin1);
+  ptr->size = size;
+  ptr->alloc_site = alloc_site;
+  if (profiler.is_tracking()) [[unlikely]] {
+    ptr->alloc_site = profiler.track_allocation(alloc_site, size);
+  }
 
-  stats.newgen_object_cnt += 1;
   return prim_str;
 }
 
 PrimitiveString* GCHeap::new_prim_string(const char16_t *str, size_t length) {
-  auto prim_str = new_prim_string_impl(length);
+  if (PrimitiveString::is_latin1(str, length)) {
+    auto prim_str = new_one_byte_string(length);
+    prim_str->init_latin1(str, length);
+    return prim_str;
+  }
+  auto prim_str = new_prim_string_impl(length, CHAR_SIZE);
   prim_str->init(str, length);
   return prim_str;
 }
 
 PrimitiveString* GCHeap::new_prim_string(size_t length) {
-  return new_prim_string_impl(length);
+  return new_prim_string_impl(length, CHAR_SIZE);
+}
+
+PrimitiveString* GCHeap::new_one_byte_string(size_t length) {
+  auto prim_str = new_prim_string_impl(length, 1);
+  prim_str->kind = PrimitiveString::Kind::ONE_BYTE;
+  prim_str->latin1 = true;
+  PrimitiveString::one_byte_count += 1;
+  return prim_str;
 }
 
-PrimitiveString* GCHeap::new_prim_string_impl(size_t length) {
+PrimitiveString* GCHeap::new_one_byte_string(const char *str, size_t length) {
+  auto prim_str = new_one_byte_string(length);
+  std::memcpy(prim_str->latin1_storage(), str, length);
+  prim_str->latin1_storage()[length] = 0;
+  prim_str->len = length;
+  return prim_str;
+}
+
+PrimitiveString* GCHeap::new_rope_string(PrimitiveString *left, PrimitiveString *right) {
+  u32 size = sizeof(PrimitiveString) + sizeof(PrimitiveString::RopeChildren);
+  GCObject *ptr = alloc(size);
+  auto *rope = new (ptr) PrimitiveString(0);
+  rope->init_rope(left, right);
+  ptr->size = size;
+  ptr->alloc_site = alloc_site;
+  if (profiler.is_tracking()) [[unlikely]] {
+    ptr->alloc_site = profiler.track_allocation(alloc_site, size);
+  }
+  // the buffer of a flattened rope is freed by the destructor.
+  ptr->gc_finalize = true;
+  if (object_in_newgen(ptr)) newgen_finalizers.push_back(ptr);
+  // The children can not be appended to in place any more. The rope may be pretenured.
+  write_barrier(ptr, left);
+  write_barrier(ptr, right);
+  return rope;
+}
+
+PrimitiveString* GCHeap::new_slice_string(PrimitiveString *parent, u32 offset, u32 length) {
+  u32 size = sizeof(PrimitiveString) + sizeof(PrimitiveString::SliceParent);
+  GCObject *ptr = alloc(size);
+  auto *slice = new (ptr) PrimitiveString(0);
+  slice->init_slice(parent, offset, length);
+  ptr->size = size;
+  ptr->alloc_site = alloc_site;
+  if (profiler.is_tracking()) [[unlikely]] {
+    ptr->alloc_site = profiler.track_allocation(alloc_site, size);
+  }
+  // The parent can not be appended to in place any more. The slice may be pretenured.
+  write_barrier(ptr, parent);
+  return slice;
+}
+
+PrimitiveString* GCHeap::new_prim_string_impl(size_t length, size_t char_size) {
   assert(length < UINT32_MAX);
   size_t capacity = 1.25 * (length + 1);
-  size_t payload_size = capacity * CHAR_SIZE;
+  size_t payload_size = capacity * char_size;
   size_t alloc_size = sizeof(PrimitiveString) + next_multiple_of_8(payload_size);
 
-  GCObject *ptr = newgen_alloc(alloc_size);
+  u32 size = alloc_size;
+  GCObject *ptr = alloc(size);
   auto *prim_str = new (ptr) PrimitiveString(capacity);
-  ptr->size = alloc_size;
+  ptr->size = size;
+  ptr->alloc_site = alloc_site;
+  if (profiler.is_tracking()) [[unlikely]] {
+    ptr->alloc_site = profiler.track_allocation(alloc_site, size);
+  }
 
-  stats.newgen_object_cnt += 1;
   return prim_str;
 }
 
@@ -502,20 +1307,21 @@ HeapArray<JSValue>* GCHeap::new_array(u32 length) {
   size_t payload_size = capacity * sizeof(JSValue);
   size_t alloc_size = sizeof(HeapArray<JSValue>) + next_multiple_of_8(payload_size);
 
-  GCObject *ptr = newgen_alloc(alloc_size);
+  u32 size = alloc_size;
+  GCObject *ptr = alloc(size);
   auto *array = new (ptr) HeapArray<JSValue>(length, capacity);
-  ptr->size = alloc_size;
+  ptr->size = size;
+  ptr->alloc_site = alloc_site;
+  if (profiler.is_tracking()) [[unlikely]] {
+    ptr->alloc_site = profiler.track_allocation(alloc_site, size);
+  }
 
-  stats.newgen_object_cnt += 1;
   return array;
 }
 
 // Allocate memory for a new object.
 GCObject* GCHeap::newgen_alloc(size_t size_byte) {
   byte *alloc_end = alloc_point + size_byte;
-  // wait for the dealloc process to finish
-  while (alloc_end > dealloc_progress) [[unlikely]] {}
-
   if (alloc_end > newgen_gc_threshold) [[unlikely]] {
     gc_requested = true;
     if (alloc_end > survivor1_start) [[unlikely]] {
@@ -8,9 +8,16 @@
 #include <thread>
 #include <atomic>
 #include <string>
+#include <memory>
+#include <mutex>
 #include <condition_variable>
+#include <chrono>
 
 #include "GCObject.h"
+#include "OldgenPage.h"
+#include "LargeObjectSpace.h"
+#include "AdaptiveSizePolicy.h"
+#include "HeapProfiler.h"
 #include "njs/utils/helper.h"
 #include "njs/global_var.h"
 
@@ -25,6 +32,7 @@ using u32 = uint32_t;
 
 class NjsVM;
 struct JSValue;
+struct JSStackFrame;
 struct PrimitiveString;
 template <typename T>
 struct HeapArray;
@@ -37,35 +45,80 @@ struct GCStats {
 
   size_t oldgen_object_cnt {0};
   size_t oldgen_usage {0};
+  size_t major_gc_count {0};
+  size_t pretenured_object_cnt {0};
+  size_t pretenured_site_cnt {0};
+  size_t large_object_cnt {0};
+  size_t large_object_usage {0};
 
   size_t total_time {0};
   size_t copy_time {0};
-  size_t dealloc_time {0};
+  size_t major_gc_time {0};
+  size_t max_pause_time {0};
+
+  // decided by the adaptive size policy
+  size_t nursery_size {0};
+  u32 tenure_age {0};
+  double avg_pause_time {0};
+  double gc_time_ratio {0};
 
   void print() {
     std::cout << "GC trigger count: " << newgen_gc_count << "\n";
     std::cout << "GC total time: " << total_time / 1000 << " ms\n";
     std::cout << "GC copy time: " << copy_time / 1000 << " ms\n";
-    std::cout << "GC dealloc time: " << dealloc_time / 1000 << " ms\n";
+    std::cout << "GC max pause: " << max_pause_time / 1000 << " ms\n";
+    std::cout << "GC average pause: " << avg_pause_time / 1000 << " ms\n";
+    std::cout << "GC time ratio: " << gc_time_ratio << "\n";
+    std::cout << "nursery size: " << memory_usage_readable(nursery_size) << "\n";
+    std::cout << "tenuring age: " << tenure_age << "\n";
 
     std::cout << "newgen last gc usage: " << memory_usage_readable(newgen_last_gc_usage) << "\n";
     std::cout << "newgen last gc object count: " << newgen_last_gc_object_cnt << "\n";
 
     std::cout << "oldgen usage: " << memory_usage_readable(oldgen_usage) << "\n";
     std::cout << "oldgen object count: " << oldgen_object_cnt << "\n";
+    std::cout << "major GC count: " << major_gc_count << "\n";
+    std::cout << "major GC time: " << major_gc_time / 1000 << " ms\n";
+    std::cout << "pretenured object count: " << pretenured_object_cnt << "\n";
+    std::cout << "pretenured allocation site count: " << pretenured_site_cnt << "\n";
+    std::cout << "large object usage: " << memory_usage_readable(large_object_usage) << "\n";
+    std::cout << "large object count: " << large_object_cnt << "\n";
   }
 };
 
 class GCHeap {
+friend class HeapProfiler;
 
 using byte = int8_t;
-constexpr static int AGE_MAX = 1;
 constexpr static double newgen_size_ratio = 0.4;
 constexpr static double survivor_size_ratio = 0.2;
 constexpr static double oldgen_size_ratio = 1 - newgen_size_ratio - 2 * survivor_size_ratio;
-constexpr static double newgen_gc_threshold_ratio = 0.36;
+// The nursery is resized by the adaptive size policy between these bounds. The rest of the new
+// generation area is the room for the allocations between the GC request and the safepoint.
+constexpr static double nursery_max_ratio = 0.36;
+constexpr static size_t NURSERY_MIN_SIZE = 1024 * 1024;
+// size of the local allocation buffers of the GC workers
+constexpr static size_t LAB_SIZE = 32 * 1024;
+// objects larger than this are not allocated in the local allocation buffers.
+constexpr static size_t LAB_OBJECT_MAX = LAB_SIZE / 4;
+constexpr static size_t ROOT_BATCH = 64;
+constexpr static size_t FRAME_BATCH = 4;
+// An allocation site is pretenured when at least `PRETENURE_SURVIVAL_RATE` of its objects survive
+// their first minor GC, measured over at least `PRETENURE_MIN_SAMPLE` objects.
+constexpr static u32 PRETENURE_MIN_SAMPLE = 100;
+constexpr static double PRETENURE_SURVIVAL_RATE = 0.85;
+constexpr static size_t GREY_PUBLISH_BATCH = 64;
+constexpr static size_t FINALIZER_BATCH = 256;
+constexpr static u32 NO_PAGE = UINT32_MAX;
 
  public:
+  // The old generation is divided into cards. The write barrier dirties the card of the
+  // written location, and a minor GC only scans the dirty cards.
+  constexpr static size_t CARD_SHIFT = 9;
+  constexpr static size_t CARD_SIZE = 1 << CARD_SHIFT;
+  constexpr static uint8_t CARD_CLEAN = 0;
+  constexpr static uint8_t CARD_DIRTY = 1;
+
   GCHeap(size_t size_mb, NjsVM& vm);
   ~GCHeap();
 
@@ -73,21 +126,46 @@ constexpr static double newgen_gc_threshold_ratio = 0.36;
   template <typename T, typename... Args>
   T* new_object(Args &&...args) {
     // allocate memory
-    GCObject *meta = newgen_alloc(sizeof(T));
+    u32 size = sizeof(T);
+    GCObject *meta = alloc(size);
     // initialize
     T *object = new (meta) T(std::forward<Args>(args)...);
-    meta->size = sizeof(T);
+    meta->size = size;
+    meta->alloc_site = alloc_site;
+    if (profiler.is_tracking()) [[unlikely]] {
+      meta->alloc_site = profiler.track_allocation(alloc_site, size);
+    }
+    if constexpr (T::GC_NEEDS_FINALIZER) {
+      meta->gc_finalize = true;
+      if (object_in_newgen(meta)) newgen_finalizers.push_back(meta);
+    }
 
-    stats.newgen_object_cnt += 1;
     return object;
   }
 
-  PrimitiveString* new_prim_string_ref(u16string_view str);
+  // `latin1` tells whether all the characters of `str` are Latin-1, if known.
+  PrimitiveString* new_prim_string_ref(u16string_view str, bool latin1 = false);
+  // The string is one-byte if all the characters are Latin-1.
   PrimitiveString* new_prim_string(const char16_t *str, size_t length);
+  // a two-byte string of `length` characters, to be filled by the caller.
   PrimitiveString* new_prim_string(size_t length);
+  // a one-byte string of `length` characters, to be filled by the caller.
+  PrimitiveString* new_one_byte_string(size_t length);
+  // a one-byte string of the characters, which are Latin-1.
+  PrimitiveString* new_one_byte_string(const char *str, size_t length);
+  // a rope that refers to `left` and `right` instead of copying them.
+  PrimitiveString* new_rope_string(PrimitiveString *left, PrimitiveString *right);
+  // a slice that refers to the characters of `parent` instead of copying them.
+  PrimitiveString* new_slice_string(PrimitiveString *parent, u32 offset, u32 length);
 
   HeapArray<JSValue>* new_array(u32 length);
 
+  // Allocation sites are the instructions that allocate objects (`make_obj`, `make_array`,
+  // `make_func`, `js_new` and `add`). Their ids are assigned by the codegen, and 0 means unknown.
+  void init_alloc_sites(u32 count);
+  // The allocation site of the instruction being executed. The VM sets it around the allocation.
+  u16 alloc_site {0};
+
   void gc();
   void gc_if_needed();
   void pause_gc() {gc_pause_counter += 1; }
@@ -95,9 +173,10 @@ constexpr static double newgen_gc_threshold_ratio = 0.36;
 
   // When garbage collection is performed, this method is called to copy an object
   // to a new memory area and have the pointer in JSValue, which is the handle,
-  // point to the new address. The `copy_object` method copies the child object recursively.
+  // point to the new address. The copied object is pushed to the grey queue of the current
+  // GC worker, and its children are copied when it is scanned.
   // This method will be called not only in this class, but also in the `gc_scan_children` method
-  // of the GCObject subclasses.
+  // of the GCObject subclasses. It may be called by several GC workers at the same time.
   //
   // return if this object is in the new generation area.
   template <typename T>
@@ -112,59 +191,234 @@ constexpr static double newgen_gc_threshold_ratio = 0.36;
     }
   }
 
-  void write_barrier(GCObject *obj, JSValue const& field);
-  void write_barrier(GCObject *obj, GCObject *field);
+  // return true if `obj` is in the old generation and `field` is in the new generation.
+  bool write_barrier(GCObject *obj, JSValue const& field);
+  bool write_barrier(GCObject *obj, GCObject *field);
+  // write barrier for objects that support scanning by card (like `HeapArray`), where `slot` is
+  // the address of the field being written.
+  bool write_barrier(GCObject *obj, void *slot, JSValue const& field);
   bool object_in_newgen(GCObject *obj) { return obj < reinterpret_cast<GCObject *>(oldgen_start); }
 
+  // Write a heap snapshot to `path`. Return false if the file can not be written.
+  bool write_heap_snapshot(const std::string& path) { return profiler.write_snapshot(path); }
+
   GCStats stats;
  private:
+  // State of a thread that takes part in the minor GC.
+  // Allocates in the old generation. Each allocator owns at most one page for each size class
+  // and allocates in it without locking.
+  struct OldgenAllocator {
+    OldgenAllocator() { curr_page.fill(NO_PAGE); }
+
+    array<u32, SIZE_CLASS_CNT> curr_page;
+    // objects freed when the allocator sweeps pages lazily
+    size_t freed_cnt {0};
+    size_t freed_size {0};
+  };
+
+  struct GCWorker {
+    explicit GCWorker(size_t index): index(index) {}
+
+    size_t index;
+    // local allocation buffer in the to-space
+    byte *lab_top {nullptr};
+    byte *lab_end {nullptr};
+    GCObject *lab_last {nullptr};
+    GCObject *lab_prev_last {nullptr};
+    OldgenAllocator oldgen_allocator;
+
+    // Grey objects (copied but not scanned). The owner pushes to and pops from `local` without
+    // locking. When `local` grows, its older half is moved to `shared`, where other workers
+    // can steal from.
+    vector<GCObject *> local;
+    deque<GCObject *> shared;
+    std::atomic<size_t> shared_size {0};
+    std::mutex shared_mutex;
+
+    // promoted objects that still have young children after being scanned.
+    vector<GCObject *> young_referrers;
+    // copies in the to-space that need finalizing
+    vector<GCObject *> finalizers;
+
+    size_t copied_cnt {0};
+    size_t promoted_cnt {0};
+    size_t promoted_size {0};
+    // bytes copied into the to-space by their new ages
+    AdaptiveSizePolicy::AgeTable age_table {};
+    // Some objects younger than the tenuring age were promoted because the to-space was full.
+    bool overflowed {false};
+  };
+
+  struct AllocSite {
+    // objects allocated in the new generation since the last pretenuring decision.
+    u32 alloc_cnt {0};
+    // objects that survived their first minor GC
+    std::atomic<u32> survive_cnt {0};
+    // objects from this site found alive and dead by the last major GC
+    std::atomic<u32> oldgen_live_cnt {0};
+    std::atomic<u32> oldgen_dead_cnt {0};
+    bool pretenure {false};
+  };
+
+  // The objects in `card_task_objects[obj_begin, obj_end)` overlap the dirty card `card`.
+  struct CardTask {
+    u32 card;
+    u32 obj_begin;
+    u32 obj_end;
+  };
+
   static void gc_message(string_view msg);
 
-  PrimitiveString* new_prim_string_impl(size_t length);
+  PrimitiveString* new_prim_string_impl(size_t length, size_t char_size);
 
+  // Allocate memory for a new object in the new generation, or in the old generation if the
+  // current allocation site is pretenured. `size` is updated to the size of the allocated block.
+  GCObject* alloc(u32& size) {
+    if (size > MAX_CELL_SIZE) [[unlikely]] {
+      return large_alloc(size);
+    }
+    if (alloc_site != 0) [[unlikely]] {
+      if (GCObject *obj = site_alloc(size)) return obj;
+    }
+    stats.newgen_object_cnt += 1;
+    return newgen_alloc(size);
+  }
+  // Record the allocation at the current site. Allocate in the old generation if the site is
+  // pretenured, otherwise return nullptr.
+  GCObject* site_alloc(u32& size);
+  // Allocate in the large object space. Large objects are old from birth and never copied.
+  GCObject* large_alloc(u32& size);
+  // make the pretenuring decisions according to the survival rate of the allocation sites.
+  void update_pretenuring();
+  // Pass the results of the last minor GC to the adaptive size policy, and apply its decisions.
+  void adapt_sizes(size_t pause_time, size_t gc_time, size_t mutator_time);
+  void revise_pretenuring();
   // Allocate memory for a new object.
   GCObject* newgen_alloc(size_t size_byte);
-  // Copy a single object. Recursively copy its child objects.
+  // Copy a single object and push the copy to the grey queue of the current worker. Safe to be
+  // called by several workers at the same time: the winner of the CAS on the forwarding pointer
+  // keeps its copy.
   GCObject* copy_object(GCObject *obj);
 
   void gather_roots();
+  // Call `func(GCObject **)` on the function and the live slots of a frame. The slots that are
+  // dead at the current pc are cleared, so that they never hold dangling pointers.
+  template <typename F>
+  void visit_frame_roots(JSStackFrame *frame, F&& func);
+  // Call `func(JSValue *)` on the live slots of a frame, and clear the dead ones that hold objects.
+  template <typename F>
+  void visit_frame_slots(JSStackFrame *frame, F&& func);
+  // for the heap profiler
+  void gather_frame_roots(vector<GCObject **>& out);
   void minor_gc_task();
-  GCObject* promote(GCObject *obj);
+  void gc_worker_task(size_t index);
   void newgen_copy_alive();
-  static void newgen_dealloc_dead(byte *start, byte *end);
-  void newgen_dealloc_dead_with_progress(byte *start, byte *end);
+  // The work loop of each GC worker: copy the roots, scan the dirty cards, then process the
+  // grey objects (stealing from other workers) until all workers run out of work.
+  void scavenge(GCWorker& worker);
+  void scan_grey(GCWorker& worker, GCObject *obj);
+  void push_grey(GCWorker& worker, GCObject *obj);
+  GCObject* pop_grey(GCWorker& worker);
+  void drain_local(GCWorker& worker);
+  bool has_shared_work();
+
+  byte *survivor_to_end() { return survivor_to_start + (survivor2_start - survivor1_start); }
+  // Allocate in the to-space. Return nullptr if the to-space is full.
+  GCObject* survivor_alloc(GCWorker& worker, size_t size);
+  void survivor_undo_alloc(GCWorker& worker, GCObject *obj, size_t size);
+  GCObject* survivor_claim(size_t size);
+  void retire_lab(GCWorker& worker);
+  // Allocate in the old generation for promoting an object.
+  GCObject* promote_alloc(GCWorker& worker, size_t size);
+  // fill the unused memory [start, start + size) of a local allocation buffer.
+  static void make_filler(byte *start, size_t size);
+  // Destroy the dead objects in the finalizer lists. Called by each worker after the scavenge.
+  void finalize_dead();
+
+  // Allocate from the old generation. Return nullptr if the old generation is full.
+  // The size of the returned object is set to the size of its cell.
+  GCObject* oldgen_alloc(OldgenAllocator& allocator, size_t size);
+  // free an object just allocated by `allocator`.
+  void oldgen_undo_alloc(OldgenAllocator& allocator, GCObject *obj);
+  // Get a page with free cells of the size class, sweeping the pages on the way if needed.
+  u32 acquire_page(OldgenAllocator& allocator, size_t size_class);
+  void release_pages(OldgenAllocator& allocator);
+  void flush_sweep_stats(OldgenAllocator& allocator);
+  // The caller must hold `oldgen_mutex`.
+  u32 take_free_page();
+  void return_free_page(u32 index);
+  void sweep_page(OldgenPage& page, OldgenAllocator& allocator);
+  // Sweep a page that is not owned by any allocator, and put it in the right list.
+  void sweep_page_eagerly(u32 index, OldgenAllocator& allocator);
+  void finish_sweeping();
+
+  byte *page_start(u32 index) { return oldgen_start + (size_t(index) << OLDGEN_PAGE_SHIFT); }
+  u32 page_index(void *addr) {
+    return (reinterpret_cast<byte *>(addr) - oldgen_start) >> OLDGEN_PAGE_SHIFT;
+  }
 
-  GCObject* oldgen_alloc(size_t size);
   void major_gc();
+  // Mark the objects, and the atoms (see `gc_mark_atom`), reachable from the roots.
   void mark_phase();
+  // Sweep the large objects. The pages of the old generation are swept lazily.
   void sweep_phase();
-  static void oldgen_dealloc_dead(byte *start, byte *end);
+  void oldgen_dealloc_all();
+  void large_free(GCObject *obj);
 
   static void check_fwd_pointer(byte *start, byte *end);
 
+  size_t card_index(void *addr) {
+    return (reinterpret_cast<byte *>(addr) - oldgen_start) >> CARD_SHIFT;
+  }
+  void dirty_card(void *addr) { card_table[card_index(addr)] = CARD_DIRTY; }
+  void dirty_object_cards(GCObject *obj);
+  // Collect the objects overlapping the dirty cards before the workers start to promote objects.
+  void prepare_card_tasks();
+  void scan_card_task(const CardTask& task);
+
   NjsVM& vm;
+  HeapProfiler profiler;
   vector<GCObject **> roots;
   vector<GCObject **> const_roots;
+  // the frames on the stack. Their slots are visited according to the root maps.
+  vector<JSStackFrame *> stack_frames;
+  // all the roots of the current minor GC
+  vector<GCObject **> scavenge_roots;
 
   size_t heap_size;
   byte *storage;
+  size_t storage_size;
 
   byte *newgen_start;
   byte *survivor1_start;
   byte *survivor2_start;
   byte *oldgen_start;
   byte *oldgen_end;
+  // The large object space is reserved right after the old generation, so the large objects are
+  // considered old when compared with `oldgen_start`.
+  byte *large_space_start;
+  byte *large_space_end;
+  size_t os_page_size;
 
   // Starting address of the next new object
   byte *alloc_point;
-  byte *oldgen_alloc_point;
   byte *survivor_alloc_point;
 
   byte *survivor_from_start;
   byte *survivor_to_start;
+  // allocation point of the to-space during a minor GC
+  std::atomic<byte *> to_space_top;
 
-  std::atomic<byte *> dealloc_progress;
   byte *newgen_gc_threshold;
+  // ratio of the surviving bytes in the last minor GC
+  double survival_rate {0};
+  AdaptiveSizePolicy size_policy;
+  // Objects that have survived this many minor GCs are promoted.
+  u32 tenure_age {1};
+  // collected from the workers after a minor GC
+  AdaptiveSizePolicy::AgeTable age_table {};
+  bool survivor_overflowed {false};
+  std::chrono::steady_clock::time_point last_gc_end;
 
   bool gc_requested {false};
   std::atomic<bool> gc_running {false};
@@ -175,11 +429,57 @@ constexpr static double newgen_gc_threshold_ratio = 0.36;
   std::condition_variable gc_cond_var;
   std::mutex cond_mutex;
 
-  array<deque<GCObject *>, 8> free_list;
-  vector<GCObject *> record_set;
+  vector<OldgenPage> pages;
+  // pages after this one have never been used.
+  u32 page_frontier {0};
+  vector<u32> free_pages;
+  // Pages of each size class that have free cells. May contain stale entries.
+  array<vector<u32>, SIZE_CLASS_CNT> partial_pages;
+  // Pages of each size class marked by the last major GC that are not swept yet. May contain
+  // stale entries.
+  array<vector<u32>, SIZE_CLASS_CNT> unswept_pages;
+  OldgenAllocator mutator_allocator;
+
+  // The objects in the new generation that need finalizing, i.e. their destructors must be
+  // called when they die. The other dead objects are dropped when the new generation is reset.
+  vector<GCObject *> newgen_finalizers;
+  // same as above, but for the objects in the from-space.
+  vector<GCObject *> survivor_finalizers;
+  // protects the page lists when the GC workers are running.
+  std::mutex oldgen_mutex;
+
+  LargeObjectSpace large_space;
+  vector<GCObject *> large_objects;
+  // Request a major GC in the next minor GC when the large objects use more memory than this.
+  size_t large_space_gc_threshold;
+  bool major_gc_requested {false};
+
+  // covers both the old generation and the large object space.
+  vector<uint8_t> card_table;
+  std::unique_ptr<AllocSite[]> alloc_sites;
+  u32 alloc_site_cnt {0};
+
+  vector<CardTask> card_tasks;
+  vector<GCObject *> card_task_objects;
 
   u32 gc_pause_counter {0};
 
+  // workers[0] is run by the GC thread, and the others by the helper threads.
+  vector<std::unique_ptr<GCWorker>> workers;
+  inline static thread_local GCWorker *current_worker {nullptr};
+  std::atomic<size_t> next_root {0};
+  std::atomic<size_t> next_frame {0};
+  std::atomic<size_t> next_card_task {0};
+  std::atomic<size_t> next_finalizer {0};
+  std::atomic<size_t> idle_workers {0};
+
+  std::condition_variable worker_cond_var;
+  std::mutex worker_mutex;
+  size_t scavenge_epoch {0};
+  size_t running_helpers {0};
+  bool helpers_stop {false};
+  vector<std::thread> helper_threads;
+
   // must put this at the very end to make sure every thing is initialized.
   std::thread gc_thread;
 };
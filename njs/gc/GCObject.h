@@ -6,10 +6,13 @@
 namespace njs {
 
 class GCHeap;
+class HeapProfiler;
+using u16 = uint16_t;
 using u32 = uint32_t;
 
 class GCObject {
 friend class GCHeap;
+friend class HeapProfiler;
 friend void gc_mark_object(GCObject *obj);
 
  public:
@@ -19,7 +22,20 @@ friend void gc_mark_object(GCObject *obj);
   GCObject(const GCObject& obj) = delete;
   GCObject(GCObject&& obj) = delete;
 
+  // Whether the destructor must be called when the object dies. Subclasses that own no memory
+  // outside the GC heap set this to false, and their dead objects in the new generation are
+  // dropped without being visited.
+  constexpr static bool GC_NEEDS_FINALIZER = true;
+
   virtual bool gc_scan_children(GCHeap &heap) { return false; }
+  // Scan the part of this object that lies in the card [card_start, card_end) of the old
+  // generation. By default, an object is scanned in full by the card holding its header.
+  virtual bool gc_scan_card(GCHeap &heap, void *card_start, void *card_end) {
+    if (this >= card_start && this < card_end) {
+      return gc_scan_children(heap);
+    }
+    return false;
+  }
   virtual void gc_mark_children() {}
   virtual bool gc_has_young_child(GCObject *oldgen_start) { return false; }
   virtual std::string description() = 0;
@@ -40,13 +56,27 @@ friend void gc_mark_object(GCObject *obj);
   u32 size;
   uint8_t gc_age : 4 {0};
   uint8_t ref_count : 4 {0};
-  bool gc_visited;
-  bool gc_free;
-  bool gc_remembered;
+  bool gc_visited : 1 {false};
+  bool gc_finalize : 1 {false};
+  // the allocation site (an instruction) of this object. 0 if unknown.
+  u16 alloc_site {0};
   GCObject *forward_ptr {nullptr};
 };
 
+// When set, `gc_mark_object` reports the object to this tracer instead of marking it. This is
+// used to find the children of an object through `gc_mark_children` without touching the marks.
+class GCChildTracer {
+ public:
+  virtual void trace_child(GCObject *child) = 0;
+};
+
+inline GCChildTracer *gc_child_tracer {nullptr};
+
 inline void gc_mark_object(GCObject *obj) {
+  if (gc_child_tracer != nullptr) [[unlikely]] {
+    gc_child_tracer->trace_child(obj);
+    return;
+  }
   if (not obj->gc_visited) {
     obj->gc_visited = true;
     obj->gc_mark_children();
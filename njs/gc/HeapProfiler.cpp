@@ -0,0 +1,331 @@
+#include "HeapProfiler.h"
+
+#include <fstream>
+#include <cstdio>
+
+#include "GCHeap.h"
+#include "njs/vm/NjsVM.h"
+#include "njs/vm/JSStackFrame.h"
+#include "njs/basic_types/JSObject.h"
+#include "njs/basic_types/JSFunction.h"
+#include "njs/basic_types/PrimitiveString.h"
+#include "njs/basic_types/HeapArray.h"
+
+namespace njs {
+
+namespace {
+
+// node types and edge types of the .heapsnapshot format
+enum NodeType: u32 {
+  NODE_HIDDEN = 0,
+  NODE_ARRAY = 1,
+  NODE_STRING = 2,
+  NODE_OBJECT = 3,
+  NODE_CLOSURE = 5,
+  NODE_REGEXP = 6,
+  NODE_SYNTHETIC = 9,
+};
+
+enum EdgeType: u32 {
+  EDGE_ELEMENT = 1,
+  EDGE_PROPERTY = 2,
+};
+
+constexpr u32 NODE_FIELD_CNT = 7;
+constexpr size_t MAX_STRING_NAME_LENGTH = 1024;
+
+struct ChildCollector: public GCChildTracer {
+  void trace_child(GCObject *child) override {
+    children.push_back(child);
+  }
+
+  vector<GCObject *> children;
+};
+
+void write_json_string(std::ostream& out, u16string_view str) {
+  out << '"';
+  for (char16_t ch : str) {
+    if (ch == u'"') {
+      out << "\\\"";
+    } else if (ch == u'\\') {
+      out << "\\\\";
+    } else if (ch < 0x20 || ch >= 0x7f) {
+      char buf[8];
+      snprintf(buf, sizeof(buf), "\\u%04x", (unsigned)ch);
+      out << buf;
+    } else {
+      out << (char)ch;
+    }
+  }
+  out << '"';
+}
+
+}
+
+void HeapProfiler::start_tracking() {
+  tracking = true;
+  sites.resize(UINT16_MAX + 1);
+}
+
+u16 HeapProfiler::track_allocation(u16 site, size_t size) {
+  if (site == 0) {
+    site = make_up_site();
+    if (site == 0) return 0;
+  }
+
+  SiteInfo& info = sites[site];
+  if (not info.located) [[unlikely]] {
+    locate_site(info);
+  }
+  info.alloc_cnt += 1;
+  info.alloc_size += size;
+  return site;
+}
+
+u16 HeapProfiler::make_up_site() {
+  JSStackFrame *frame = vm.curr_frame;
+  if (frame == nullptr) return 0;
+
+  JSFunction *func = frame->function.as_func;
+  // the pc of a native frame is not valid.
+  u32 pc = func->is_native() ? 0 : *frame->pc_ref;
+  auto key = std::make_pair(func->meta, pc);
+  auto iter = made_up_sites.find(key);
+  if (iter != made_up_sites.end()) return iter->second;
+
+  // the ids after the codegen sites
+  if (next_made_up_site == 0) {
+    next_made_up_site = heap.alloc_site_cnt;
+  }
+  if (next_made_up_site > UINT16_MAX) return 0;
+  u16 site = next_made_up_site++;
+  made_up_sites.emplace(key, site);
+  return site;
+}
+
+void HeapProfiler::locate_site(SiteInfo& info) {
+  info.located = true;
+  JSStackFrame *frame = vm.curr_frame;
+  if (frame == nullptr) {
+    info.func_name = u"(runtime)";
+    return;
+  }
+
+  JSFunction *func = frame->function.as_func;
+  JSFunctionMeta *meta = func->meta;
+  if (meta == &vm.global_meta) {
+    info.func_name = u"(global)";
+  } else if (meta->is_anonymous) {
+    info.func_name = u"(anonymous)";
+  } else {
+    info.func_name = func->name;
+  }
+  info.line = meta->source_line;
+  if (not func->is_native()) {
+    // `pc` has moved past the instruction being executed.
+    info.pc = *frame->pc_ref - 1 - meta->bytecode_start;
+  }
+}
+
+u32 HeapProfiler::add_string(u16string_view str) {
+  auto [iter, inserted] = string_index.emplace(u16string(str), strings.size());
+  if (inserted) {
+    strings.emplace_back(str);
+  }
+  return iter->second;
+}
+
+u32 HeapProfiler::node_of(GCObject *obj) {
+  auto [iter, inserted] = node_index.emplace(obj, nodes.size());
+  if (inserted) {
+    nodes.push_back(Node { .object = obj });
+    describe_node(nodes.back());
+  }
+  return iter->second;
+}
+
+void HeapProfiler::describe_node(Node& node) {
+  GCObject *obj = node.object;
+  if (auto *str = dynamic_cast<PrimitiveString *>(obj)) {
+    node.type = NODE_STRING;
+    node.name = add_string(str->view().substr(0, MAX_STRING_NAME_LENGTH));
+  } else if (auto *js_obj = dynamic_cast<JSObject *>(obj)) {
+    if (js_obj->is_direct_function()) {
+      auto *func = static_cast<JSFunction *>(js_obj);
+      node.type = NODE_CLOSURE;
+      node.name = add_string(func->meta->is_anonymous ? u"(anonymous)" : func->name);
+    } else {
+      node.type = js_obj->get_class() == CLS_REGEXP ? NODE_REGEXP : NODE_OBJECT;
+      node.name = add_string(js_obj->get_class_name());
+    }
+  } else if (dynamic_cast<HeapArray<JSValue> *>(obj)) {
+    node.type = NODE_ARRAY;
+    node.name = add_string(u"(captured variables)");
+  } else {
+    node.type = NODE_HIDDEN;
+    node.name = add_string(u"(heap value)");
+  }
+}
+
+void HeapProfiler::add_children(u32 index) {
+  GCObject *obj = nodes[index].object;
+
+  // name the edges to the properties
+  std::unordered_map<GCObject *, u32> prop_names;
+  if (auto *js_obj = dynamic_cast<JSObject *>(obj)) {
+    for (auto& [key, prop] : js_obj->get_storage()) {
+      u16string name = key.type == JSValue::SYMBOL ? u16string(u"<symbol>")
+                                                   : u16string(vm.atom_to_str(key.atom));
+      if (prop.flag.is_value() && prop.data.value.needs_gc()) {
+        prop_names.emplace(prop.data.value.as_GCObject, add_string(name));
+      }
+      if (prop.flag.is_getset()) {
+        if (prop.data.getset.getter.needs_gc()) {
+          prop_names.emplace(prop.data.getset.getter.as_GCObject, add_string(u"get " + name));
+        }
+        if (prop.data.getset.setter.needs_gc()) {
+          prop_names.emplace(prop.data.getset.setter.as_GCObject, add_string(u"set " + name));
+        }
+      }
+    }
+    if (js_obj->get_proto().needs_gc()) {
+      prop_names.emplace(js_obj->get_proto().as_GCObject, add_string(u"__proto__"));
+    }
+  }
+
+  ChildCollector collector;
+  gc_child_tracer = &collector;
+  obj->gc_mark_children();
+  gc_child_tracer = nullptr;
+
+  u32 element_index = 0;
+  for (GCObject *child : collector.children) {
+    auto iter = prop_names.find(child);
+    if (iter != prop_names.end()) {
+      edges.push_back({ EDGE_PROPERTY, iter->second, node_of(child) });
+    } else {
+      edges.push_back({ EDGE_ELEMENT, element_index++, node_of(child) });
+    }
+  }
+  nodes[index].edge_cnt = collector.children.size();
+}
+
+bool HeapProfiler::write_snapshot(const std::string& path) {
+  std::ofstream out(path);
+  if (not out.is_open()) return false;
+  // the objects may still be moving
+  heap.gc_running.wait(true);
+
+  nodes.clear();
+  edges.clear();
+  node_index.clear();
+  strings.clear();
+  string_index.clear();
+  add_string(u"");
+
+  // node 0 is the synthetic root, whose children are the GC roots.
+  nodes.push_back(Node { .object = nullptr, .type = NODE_SYNTHETIC,
+                         .name = add_string(u"(GC roots)") });
+  heap.gather_roots();
+  heap.gather_frame_roots(heap.roots);
+  u32 root_cnt = 0;
+  for (auto *root_list : { &heap.const_roots, &heap.roots, &vm.temp_roots }) {
+    for (GCObject **root : *root_list) {
+      edges.push_back({ EDGE_ELEMENT, root_cnt++, node_of(*root) });
+    }
+  }
+  heap.roots.clear();
+  heap.stack_frames.clear();
+  nodes[0].edge_cnt = root_cnt;
+
+  // The edges of a node must follow those of the previous node, so the nodes are expanded in
+  // the order they are found.
+  for (u32 i = 1; i < nodes.size(); i++) {
+    add_children(i);
+  }
+
+  // the allocation sites make a flat trace tree under the root (id 1).
+  vector<u32> trace_sites;
+  u32 root_func_name = add_string(u"(root)");
+  for (u32 site = 1; site < sites.size(); site++) {
+    if (sites[site].located && sites[site].alloc_cnt != 0) {
+      trace_sites.push_back(site);
+    }
+  }
+  auto trace_node_id = [&] (GCObject *obj) -> u32 {
+    if (obj == nullptr || not tracking) return 0;
+    const SiteInfo& info = sites[obj->alloc_site];
+    return info.located && info.alloc_cnt != 0 ? obj->alloc_site + 1 : 0;
+  };
+
+  out << R"({"snapshot":{"meta":{)"
+      << R"("node_fields":["type","name","id","self_size","edge_count","trace_node_id","detachedness"],)"
+      << R"("node_types":[["hidden","array","string","object","code","closure","regexp","number",)"
+      << R"("native","synthetic","concatenated string","sliced string","symbol","bigint",)"
+      << R"("object shape"],"string","number","number","number","number","number"],)"
+      << R"("edge_fields":["type","name_or_index","to_node"],)"
+      << R"("edge_types":[["context","element","property","internal","hidden","shortcut","weak"],)"
+      << R"("string_or_number","node"],)"
+      << R"("trace_function_info_fields":["function_id","name","script_name","script_id","line",)"
+      << R"("column"],)"
+      << R"("trace_node_fields":["id","function_info_index","count","size","children"],)"
+      << R"("sample_fields":["timestamp_us","last_assigned_id"],)"
+      << R"("location_fields":["object_index","script_id","line","column"]},)"
+      << R"("node_count":)" << nodes.size()
+      << R"(,"edge_count":)" << edges.size()
+      << R"(,"trace_function_count":)" << (tracking ? trace_sites.size() + 1 : 0) << "},\n";
+
+  out << "\"nodes\":[";
+  for (u32 i = 0; i < nodes.size(); i++) {
+    Node& node = nodes[i];
+    u32 self_size = node.object ? node.object->size : 0;
+    if (i != 0) out << ",\n";
+    out << node.type << ',' << node.name << ',' << (2 * i + 1) << ',' << self_size << ','
+        << node.edge_cnt << ',' << trace_node_id(node.object) << ",0";
+  }
+
+  out << "],\n\"edges\":[";
+  for (u32 i = 0; i < edges.size(); i++) {
+    Edge& edge = edges[i];
+    if (i != 0) out << ",\n";
+    out << edge.type << ',' << edge.name_or_index << ',' << edge.to_node * NODE_FIELD_CNT;
+  }
+
+  out << "],\n\"trace_function_infos\":[";
+  if (tracking) {
+    out << "0," << root_func_name << ",0,0,0,0";
+    for (u32 i = 0; i < trace_sites.size(); i++) {
+      const SiteInfo& info = sites[trace_sites[i]];
+      u16string name = info.func_name + u" @ pc " + to_u16string(std::to_string(info.pc));
+      out << ",\n" << (i + 1) << ',' << add_string(name) << ",0,0," << info.line << ",0";
+    }
+  }
+
+  out << "],\n\"trace_tree\":[";
+  if (tracking) {
+    out << "1,0,0,0,[";
+    for (u32 i = 0; i < trace_sites.size(); i++) {
+      const SiteInfo& info = sites[trace_sites[i]];
+      if (i != 0) out << ",\n";
+      out << (trace_sites[i] + 1) << ',' << (i + 1) << ',' << info.alloc_cnt << ','
+          << info.alloc_size << ",[]";
+    }
+    out << "]";
+  }
+
+  out << "],\n\"samples\":[],\n\"locations\":[],\n\"strings\":[";
+  for (u32 i = 0; i < strings.size(); i++) {
+    if (i != 0) out << ",\n";
+    write_json_string(out, strings[i]);
+  }
+  out << "]}\n";
+
+  nodes.clear();
+  edges.clear();
+  node_index.clear();
+  strings.clear();
+  string_index.clear();
+  return out.good();
+}
+
+} // namespace njs
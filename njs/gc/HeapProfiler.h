@@ -0,0 +1,92 @@
+#ifndef NJS_HEAP_PROFILER_H
+#define NJS_HEAP_PROFILER_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+
+#include "GCObject.h"
+
+namespace njs {
+
+class NjsVM;
+struct JSFunctionMeta;
+
+using std::u16string;
+using std::vector;
+using std::u16string_view;
+
+// Tracks where the objects are allocated, and writes heap snapshots in the format of Chrome
+// DevTools (.heapsnapshot).
+//
+// The allocation sites assigned by the codegen are reused as the tags of the allocations.
+// Objects allocated elsewhere (e.g. by the native functions) get a site made up from the function
+// and the pc being executed. These sites take the ids after the codegen sites and are never
+// pretenured.
+class HeapProfiler {
+ public:
+  HeapProfiler(GCHeap& heap, NjsVM& vm): heap(heap), vm(vm) {}
+
+  void start_tracking();
+  bool is_tracking() { return tracking; }
+
+  // Return the allocation site to tag a new object with. `site` is the site set by the VM.
+  u16 track_allocation(u16 site, size_t size);
+
+  // Write a snapshot of the objects reachable from the roots. Return false if the file can not
+  // be opened.
+  bool write_snapshot(const std::string& path);
+
+ private:
+  struct SiteInfo {
+    u16string func_name;
+    u32 line {0};
+    u32 pc {0};
+    bool located {false};
+    size_t alloc_cnt {0};
+    size_t alloc_size {0};
+  };
+
+  struct Node {
+    GCObject *object;
+    u32 type {0};
+    u32 name {0};
+    u32 edge_cnt {0};
+  };
+
+  struct Edge {
+    u32 type;
+    u32 name_or_index;
+    u32 to_node;
+  };
+
+  u16 make_up_site();
+  void locate_site(SiteInfo& info);
+
+  u32 add_string(u16string_view str);
+  u32 node_of(GCObject *obj);
+  void describe_node(Node& node);
+  void add_children(u32 node_index);
+
+  GCHeap& heap;
+  NjsVM& vm;
+  bool tracking {false};
+
+  vector<SiteInfo> sites;
+  // (function, pc) -> site
+  std::map<std::pair<JSFunctionMeta *, u32>, u16> made_up_sites;
+  u32 next_made_up_site {0};
+
+  // state of the snapshot being written
+  vector<Node> nodes;
+  vector<Edge> edges;
+  std::unordered_map<GCObject *, u32> node_index;
+  vector<u16string> strings;
+  std::unordered_map<u16string, u32> string_index;
+};
+
+} // namespace njs
+
+#endif // NJS_HEAP_PROFILER_H
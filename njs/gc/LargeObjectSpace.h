@@ -0,0 +1,82 @@
+#ifndef NJS_LARGE_OBJECT_SPACE_H
+#define NJS_LARGE_OBJECT_SPACE_H
+
+#include <cstdint>
+#include <cstddef>
+#include <map>
+#include <iterator>
+
+namespace njs {
+
+// Manages the pages of the large object space. Each large object takes a run of OS pages of its
+// own. This class only deals with page indexes; mapping and releasing the memory is up to the
+// heap.
+class LargeObjectSpace {
+ public:
+  constexpr static size_t NO_PAGE = SIZE_MAX;
+
+  void init(size_t page_cnt) {
+    total_pages = page_cnt;
+  }
+
+  // Return the index of the first page of a run of `cnt` free pages, or NO_PAGE.
+  size_t alloc_pages(size_t cnt) {
+    // first fit in the freed runs
+    for (auto iter = free_runs.begin(); iter != free_runs.end(); ++iter) {
+      auto [start, run_cnt] = *iter;
+      if (run_cnt < cnt) continue;
+
+      free_runs.erase(iter);
+      if (run_cnt > cnt) {
+        free_runs.emplace(start + cnt, run_cnt - cnt);
+      }
+      used_pages += cnt;
+      return start;
+    }
+
+    if (frontier + cnt > total_pages) return NO_PAGE;
+    size_t start = frontier;
+    frontier += cnt;
+    used_pages += cnt;
+    return start;
+  }
+
+  void free_pages(size_t start, size_t cnt) {
+    used_pages -= cnt;
+    // merge with the neighbouring free runs
+    auto next = free_runs.lower_bound(start);
+    if (next != free_runs.end() && next->first == start + cnt) {
+      cnt += next->second;
+      next = free_runs.erase(next);
+    }
+    if (next != free_runs.begin()) {
+      auto prev = std::prev(next);
+      if (prev->first + prev->second == start) {
+        start = prev->first;
+        cnt += prev->second;
+        free_runs.erase(prev);
+      }
+    }
+
+    if (start + cnt == frontier) {
+      frontier = start;
+    } else {
+      free_runs.emplace(start, cnt);
+    }
+  }
+
+  size_t get_used_pages() const { return used_pages; }
+  size_t get_total_pages() const { return total_pages; }
+
+ private:
+  size_t total_pages {0};
+  // pages after this one have never been used.
+  size_t frontier {0};
+  size_t used_pages {0};
+  // start page -> page count
+  std::map<size_t, size_t> free_runs;
+};
+
+} // namespace njs
+
+#endif // NJS_LARGE_OBJECT_SPACE_H
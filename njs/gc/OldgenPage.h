@@ -0,0 +1,137 @@
+#ifndef NJS_OLDGEN_PAGE_H
+#define NJS_OLDGEN_PAGE_H
+
+#include <cstdint>
+#include <cstddef>
+#include <array>
+#include <algorithm>
+#include <bit>
+
+namespace njs {
+
+using u32 = uint32_t;
+
+// The old generation is divided into pages. A page in use holds cells of one size class.
+// Objects larger than `MAX_CELL_SIZE` are allocated in the large object space.
+constexpr size_t OLDGEN_PAGE_SHIFT = 15;
+constexpr size_t OLDGEN_PAGE_SIZE = 1 << OLDGEN_PAGE_SHIFT;
+constexpr size_t MIN_CELL_SIZE = 24;
+constexpr size_t MAX_CELL_SIZE = 4096;
+constexpr size_t PAGE_BITMAP_WORDS = (OLDGEN_PAGE_SIZE / MIN_CELL_SIZE + 63) / 64;
+
+// Size classes: 8 bytes apart up to 128 bytes, then 8 classes for each doubling.
+constexpr size_t SIZE_CLASS_CNT = 14 + 5 * 8;
+
+constexpr std::array<u32, SIZE_CLASS_CNT> SIZE_CLASSES = [] {
+  std::array<u32, SIZE_CLASS_CNT> classes {};
+  size_t i = 0;
+  for (u32 size = MIN_CELL_SIZE; size <= 128; size += 8) {
+    classes[i++] = size;
+  }
+  for (u32 base = 128; base < MAX_CELL_SIZE; base *= 2) {
+    for (u32 step = 1; step <= 8; step++) {
+      classes[i++] = base + step * (base / 8);
+    }
+  }
+  return classes;
+}();
+
+static_assert(SIZE_CLASSES[SIZE_CLASS_CNT - 1] == MAX_CELL_SIZE);
+
+// index: size / 8 (rounded up). value: the smallest size class that can hold the size.
+constexpr std::array<uint8_t, MAX_CELL_SIZE / 8 + 1> SIZE_CLASS_OF = [] {
+  std::array<uint8_t, MAX_CELL_SIZE / 8 + 1> table {};
+  size_t cls = 0;
+  for (size_t i = 0; i < table.size(); i++) {
+    while (SIZE_CLASSES[cls] < i * 8) cls++;
+    table[i] = cls;
+  }
+  return table;
+}();
+
+inline size_t size_class_of(size_t size) {
+  return SIZE_CLASS_OF[(size + 7) / 8];
+}
+
+struct OldgenPage {
+  enum Kind: uint8_t {
+    FREE,
+    SMALL,
+  };
+
+  void init_small(size_t cls) {
+    kind = SMALL;
+    size_class = cls;
+    cell_size = SIZE_CLASSES[cls];
+    cell_cnt = OLDGEN_PAGE_SIZE / cell_size;
+    free_cnt = cell_cnt;
+    cursor = 0;
+    need_sweep = false;
+
+    // The bits after the last cell are set so that they never look free.
+    alloc_bits.fill(0);
+    for (u32 i = cell_cnt; i < PAGE_BITMAP_WORDS * 64; i++) {
+      alloc_bits[i / 64] |= uint64_t(1) << (i % 64);
+    }
+  }
+
+  // Return the index of a free cell and mark it allocated. Return -1 if the page is full.
+  int alloc_cell() {
+    for (u32 word = cursor; word < PAGE_BITMAP_WORDS; word++) {
+      uint64_t free_bits = ~alloc_bits[word];
+      if (free_bits != 0) {
+        int bit = std::countr_zero(free_bits);
+        alloc_bits[word] |= uint64_t(1) << bit;
+        free_cnt -= 1;
+        cursor = word;
+        return word * 64 + bit;
+      }
+    }
+    cursor = PAGE_BITMAP_WORDS;
+    return -1;
+  }
+
+  void free_cell(u32 index) {
+    alloc_bits[index / 64] &= ~(uint64_t(1) << (index % 64));
+    free_cnt += 1;
+    cursor = std::min(cursor, index / 64);
+  }
+
+  bool cell_allocated(u32 index) const {
+    return alloc_bits[index / 64] & (uint64_t(1) << (index % 64));
+  }
+
+  // Call `func(index)` for each allocated cell.
+  template <typename F>
+  void for_each_allocated(F&& func) const {
+    u32 word_cnt = (cell_cnt + 63) / 64;
+    for (u32 word = 0; word < word_cnt; word++) {
+      uint64_t bits = alloc_bits[word];
+      while (bits != 0) {
+        u32 index = word * 64 + std::countr_zero(bits);
+        bits &= bits - 1;
+        if (index >= cell_cnt) return;
+        func(index);
+      }
+    }
+  }
+
+  Kind kind {FREE};
+  uint8_t size_class {0};
+  // Only the allocator that owns a page allocates in it.
+  bool owned {false};
+  // The page is marked by the last major GC but not swept yet.
+  bool need_sweep {false};
+  bool in_free_list {false};
+
+  u32 cell_size {0};
+  u32 cell_cnt {0};
+  u32 free_cnt {0};
+  // the bitmap word to start looking for free cells.
+  u32 cursor {0};
+  std::array<uint64_t, PAGE_BITMAP_WORDS> alloc_bits {};
+};
+
+} // namespace njs
+
+#endif // NJS_OLDGEN_PAGE_H
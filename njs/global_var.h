@@ -11,6 +11,26 @@ class Global {
   inline static bool show_vm_stats {false};
   inline static bool show_vm_exec_steps {false};
   inline static bool show_log_buffer {false};
+  // count hardware events by phase with perf_event_open
+  inline static bool show_perf_counters {false};
+  // number of threads that copy objects in a minor GC. 0 means decided by the hardware.
+  inline static int gc_thread_count {0};
+  // The adaptive size policy of the new generation keeps the minor GC pauses under this goal
+  // (0 means no goal), then keeps the ratio of the time not spent in the GC above the throughput
+  // goal.
+  inline static double gc_pause_goal_ms {0};
+  inline static double gc_throughput_goal {0.95};
+  // The strings of the integers below this are preallocated by the VM and shared.
+  inline static unsigned int_string_cache_size {1024};
+  // If set, allocations are tracked and a heap snapshot is written to this path at exit.
+  inline static const char *heap_snapshot_path {nullptr};
+  // If set, events are traced and dumped to this path at exit.
+  inline static const char *trace_path {nullptr};
+  // If set, the JavaScript functions are sampled and the profile is written to this path at exit.
+  inline static const char *cpu_profile_path {nullptr};
+  inline static unsigned cpu_profile_interval_us {1000};
+  // Only in the njs_profile build: the function and line profile is also written to this path.
+  inline static const char *func_profile_path {nullptr};
 };
 
 }
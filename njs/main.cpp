@@ -7,6 +7,8 @@
 #include <sys/resource.h>
 
 #include "njs/utils/Timer.h"
+#include "njs/utils/Tracer.h"
+#include "njs/utils/PerfCounters.h"
 #include "njs/common/Defer.h"
 #include "njs/global_var.h"
 #include "njs/parser/Lexer.h"
@@ -30,6 +32,21 @@ static bool show_tokens = false;
 int main(int argc, char *argv[]) {
   set_stack_size(48);
   read_options(argc, argv);
+  if (Global::trace_path != nullptr) {
+    Tracer::start();
+    Tracer::set_thread_name("main");
+  }
+  defer {
+    if (Global::trace_path != nullptr && not Tracer::dump(Global::trace_path)) {
+      fprintf(stderr, "Cannot write the trace to %s\n", Global::trace_path);
+    }
+  };
+  if (Global::show_perf_counters) {
+    PerfCounters::start();
+  }
+  defer {
+    if (PerfCounters::is_enabled()) PerfCounters::report();
+  };
 
   try {
     u16string source_code = read_file(file_path);
@@ -40,11 +57,19 @@ int main(int argc, char *argv[]) {
     }
 
     Timer parser_timer("parsed");
+    int64_t parse_start = Tracer::now_us();
 
     Parser parser(std::move(source_code));
-    ASTNode *ast = parser.parse_program();
+    ASTNode *ast;
+    {
+      PerfScope perf("parse");
+      ast = parser.parse_program();
+    }
     defer { delete ast; };
 
+    if (Tracer::is_enabled()) {
+      Tracer::complete("compile", "parse", parse_start);
+    }
     parser_timer.end();
 
     if (parser.get_errors().size() > 0) {
@@ -66,7 +91,11 @@ int main(int argc, char *argv[]) {
     // codegen
     Timer codegen_timer("code generated");
     CodegenVisitor visitor;
-    visitor.codegen(static_cast<ProgramOrFunctionBody *>(ast));
+    {
+      TraceScope trace("compile", "codegen");
+      PerfScope perf("codegen");
+      visitor.codegen(static_cast<ProgramOrFunctionBody *>(ast));
+    }
     codegen_timer.end();
 
     if (visitor.get_errors().size() > 0) {
@@ -78,7 +107,11 @@ int main(int argc, char *argv[]) {
     Timer exec_timer("executed");
     NjsVM vm(visitor);
     vm.setup();
-    vm.run();
+    {
+      TraceScope trace("vm", "run");
+      PerfScope perf("exec");
+      vm.run();
+    }
     exec_timer.end();
 
     if (vm.terminated_with_throw()) {
@@ -95,7 +128,7 @@ int main(int argc, char *argv[]) {
 
 void read_options(int argc, char *argv[]) {
   int option;
-  while ((option = getopt(argc, argv, "bgativlos:f:")) != -1) {
+  while ((option = getopt(argc, argv, "bgativlPos:f:w:H:p:T:N:e:c:J:")) != -1) {
     switch (option) {
       case 'b':
         Global::show_codegen_result = true;
@@ -118,6 +151,9 @@ void read_options(int argc, char *argv[]) {
       case 'l':
         Global::show_log_buffer = true;
         break;
+      case 'P':
+        Global::show_perf_counters = true;
+        break;
       case 'o':
         Global::enable_optimization = true;
         break;
@@ -127,6 +163,33 @@ void read_options(int argc, char *argv[]) {
       case 'f':
         file_path = string(optarg);
         break;
+      case 'w':
+        Global::gc_thread_count = atoi(optarg);
+        break;
+      case 'H':
+        Global::heap_snapshot_path = optarg;
+        break;
+      case 'p':
+        Global::gc_pause_goal_ms = atof(optarg);
+        break;
+      case 'T':
+        Global::gc_throughput_goal = atof(optarg);
+        break;
+      case 'N':
+        Global::int_string_cache_size = atoi(optarg);
+        break;
+      case 'e':
+        Global::trace_path = optarg;
+        break;
+      case 'c':
+        Global::cpu_profile_path = optarg;
+        break;
+      case 'J':
+#ifndef FUNC_PROFILE
+        std::cerr << "-J only works in the njs_profile build\n";
+#endif
+        Global::func_profile_path = optarg;
+        break;
       case '?':
         std::cerr << "Unknown option: " << static_cast<char>(optopt) << '\n';
         break;
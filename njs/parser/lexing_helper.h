@@ -1,7 +1,11 @@
 #ifndef NJS_LEXING_HELPER_H
 #define NJS_LEXING_HELPER_H
 
+#include <bit>
+#include <charconv>
 #include <cstdint>
+#include <cstdlib>
+#include <cstring>
 #include <string>
 #include <optional>
 #include <cmath>
@@ -53,154 +57,218 @@ inline int64_t scan_index_literal(u16string_view str) {
   return idx == str.size() ? int_val : -1;
 }
 
-// Scan decimal number. Only allows decimal digits.
-inline optional<uint64_t> scan_decimal_literal(const char16_t *str, u32 str_len, u32& cursor) {
-  u32 pos = cursor;
-  char16_t ch = str[pos];
-
-  if (!character::is_decimal_digit(ch)) {
-    return std::nullopt;
-  }
-  uint64_t int_val = 0;
-  while (character::is_decimal_digit(ch)) {
-    int_val = int_val * 10 + character::u16_char_to_digit(ch);
-
-    pos += 1;
-    if (pos < str_len) ch = str[pos];
-    else break;
+// The value of a character, so that a `char` reads as Latin-1.
+template <typename CharT>
+inline char16_t char_unit(CharT ch) {
+  if constexpr (sizeof(CharT) == 1) {
+    return (uint8_t)ch;
+  } else {
+    return ch;
   }
-  cursor = pos;
-  return int_val;
 }
 
 // Scan integer. Allows decimal digits and hexadecimal digits.
+template <typename CharT>
 inline optional<uint64_t> scan_integer_literal(
-    const char16_t *str, u32 str_len, u32& cursor, int base = 10) {
+    const CharT *str, u32 str_len, u32& cursor, int base = 10) {
   u32 pos = cursor;
-  char16_t ch = str[pos];
-
-  if (!character::is_hex_digit(ch)) {
+  if (pos >= str_len || !character::is_hex_digit(char_unit(str[pos]))) {
     return std::nullopt;
   }
   uint64_t int_val = 0;
-  while (character::is_hex_digit(ch)) {
-    int_val = int_val * base + character::u16_char_to_digit(ch);
-
-    pos += 1;
-    if (pos < str_len) ch = str[pos];
-    else break;
+  for (; pos < str_len && character::is_hex_digit(char_unit(str[pos])); pos++) {
+    int_val = int_val * base + character::u16_char_to_digit(char_unit(str[pos]));
   }
   cursor = pos;
   return int_val;
 }
 
-inline double scan_fractional_part(const char16_t *str, u32 str_len, u32& cursor) {
-  u32 dec_start = cursor;
-  auto scan_res = scan_decimal_literal(str, str_len, cursor);
+// Load 8 characters as 8 bytes, the first in the lowest byte. Return false if a two-byte
+// character is not ASCII (and so not a digit).
+template <typename CharT>
+inline bool load_eight_chars(const CharT *str, uint64_t& res) {
+  if constexpr (sizeof(CharT) == 1) {
+    std::memcpy(&res, str, 8);
+    return true;
+  } else {
+    uint64_t lo, hi;
+    std::memcpy(&lo, str, 8);
+    std::memcpy(&hi, str + 4, 8);
+    if ((lo | hi) & 0xFF00FF00FF00FF00) return false;
+    lo = (lo | (lo >> 8)) & 0x0000FFFF0000FFFF;
+    lo = (lo | (lo >> 16)) & 0xFFFFFFFF;
+    hi = (hi | (hi >> 8)) & 0x0000FFFF0000FFFF;
+    hi = (hi | (hi >> 16)) & 0xFFFFFFFF;
+    res = lo | (hi << 32);
+    return true;
+  }
+}
 
-  if (scan_res.has_value()) {
-    u32 len = cursor - dec_start;
-    return scan_res.value() / std::pow(10, len);
+inline bool is_eight_digits(uint64_t chars) {
+  return (((chars + 0x4646464646464646) | (chars - 0x3030303030303030)) & 0x8080808080808080) == 0;
+}
+
+// The value of 8 digits loaded by `load_eight_chars`, computed in parallel (SWAR).
+inline uint32_t parse_eight_digits(uint64_t chars) {
+  chars -= 0x3030303030303030;
+  // now each 16 bits hold the value of 2 digits, and then each 32 bits that of 4.
+  chars = (chars * 10) + (chars >> 8);
+  chars = (((chars & 0x000000FF000000FF) * (100 + (1000000ULL << 32)))
+           + (((chars >> 16) & 0x000000FF000000FF) * (1 + (10000ULL << 32)))) >> 32;
+  return uint32_t(chars);
+}
+
+// The significant digits of a decimal literal, as many as fit in a uint64_t exactly.
+struct DecimalMantissa {
+  static constexpr u32 MAX_DIGITS = 19;
+
+  uint64_t value {0};
+  // the digits in `value`, counting the leading zeros of a chunk of 8 conservatively.
+  u32 digit_count {0};
+  // some nonzero digits did not fit.
+  bool truncated {false};
+};
+
+// Scan the decimal digits at `cursor` into `mantissa`, 8 at a time where possible. Return the
+// number of digits scanned, and set `added` to the number of them in `mantissa`.
+template <typename CharT>
+inline u32 scan_decimal_digits(const CharT *str, u32 str_len, u32& cursor,
+                               DecimalMantissa& mantissa, u32& added) {
+  u32 pos = cursor;
+  added = 0;
+  if constexpr (std::endian::native == std::endian::little) {
+    uint64_t chars;
+    while (pos + 8 <= str_len && mantissa.digit_count + 8 <= DecimalMantissa::MAX_DIGITS
+           && load_eight_chars(str + pos, chars) && is_eight_digits(chars)) {
+      mantissa.value = mantissa.value * 100000000 + parse_eight_digits(chars);
+      if (mantissa.value != 0) mantissa.digit_count += 8;
+      added += 8;
+      pos += 8;
+    }
+  }
+  for (; pos < str_len && character::is_decimal_digit(char_unit(str[pos])); pos++) {
+    u32 digit = char_unit(str[pos]) - u'0';
+    if (mantissa.digit_count < DecimalMantissa::MAX_DIGITS) {
+      mantissa.value = mantissa.value * 10 + digit;
+      if (mantissa.value != 0) mantissa.digit_count += 1;
+      added += 1;
+    } else if (digit != 0) {
+      mantissa.truncated = true;
+    }
+  }
+  u32 scanned = pos - cursor;
+  cursor = pos;
+  return scanned;
+}
+
+// The decimal literal `str` (already validated) that has no exact fast path, converted with the
+// correctly rounded `std::from_chars`.
+template <typename CharT>
+inline double decimal_to_double_slow(const CharT *str, u32 length) {
+  char stack_buf[64];
+  std::string heap_buf;
+  char *buf = stack_buf;
+  if (length > sizeof(stack_buf)) {
+    heap_buf.resize(length);
+    buf = heap_buf.data();
+  }
+  for (u32 i = 0; i < length; i++) {
+    buf[i] = char(str[i]);
   }
-  return 0;
+  double res = 0;
+  auto [ptr, ec] = std::from_chars(buf, buf + length, res);
+  if (ec == std::errc::result_out_of_range) [[unlikely]] {
+    // `from_chars` does not give the infinity or the zero that the value rounds to.
+    heap_buf.assign(buf, length);
+    res = std::strtod(heap_buf.c_str(), nullptr);
+  }
+  return res;
 }
 
 #define NEXT_CHAR do { pos += 1; if (pos < str_len) ch = str[pos]; else ch = character::EOS; } while (0);
 #define UPDATE_CHAR if (pos < str_len) ch = str[pos]; else { pos = str_len; ch = character::EOS; }
 
-inline optional<double> scan_numeric_literal(const char16_t *str, u32 str_len, u32& cursor) {
+// Scan a NumericLiteral (without the sign): a decimal or a hexadecimal one. `str` is a one-byte
+// (Latin-1) or a two-byte string.
+template <typename CharT>
+inline optional<double> scan_numeric_literal(const CharT *str, u32 str_len, u32& cursor) {
+  u32 start = cursor;
   u32 pos = cursor;
-  char16_t ch = str[pos];
+  auto char_at = [str, str_len] (u32 i) {
+    return i < str_len ? char_unit(str[i]) : character::EOS;
+  };
+  char16_t ch = char_at(pos);
   if (not (ch == u'.' || character::is_decimal_digit(ch))) {
     return std::nullopt;
   }
 
-  uint64_t int_val = 0;
-  double double_val = 0;
-
-  bool is_hex = false;
-  bool is_double = false;
-
-  switch (ch) {
-    case u'0': {
-      NEXT_CHAR
-      switch (ch) {
-        case u'x':
-        case u'X': {  // HexIntegerLiteral
-          NEXT_CHAR
-          auto scan_res = scan_integer_literal(str, str_len, pos, 16);
-          UPDATE_CHAR
-          if (!scan_res.has_value()) goto error;
-
-          int_val = scan_res.value();
-          is_hex = true;
-          break;
-        }
-        case u'.': {
-          is_double = true;
-          NEXT_CHAR
-          double_val = scan_fractional_part(str, str_len, pos);
-          UPDATE_CHAR
-          break;
-        }
-        case u'b':
-        case u'B':
-          // TODO: support for binary literal.
-          break;
-      }
-      break;
-    }
-    case u'.': {
-      is_double = true;
-      NEXT_CHAR
-      double_val = scan_fractional_part(str, str_len, pos);
-      UPDATE_CHAR
-      break;
+  double res;
+  if (ch == u'0' && (char_at(pos + 1) == u'x' || char_at(pos + 1) == u'X')) {
+    // HexIntegerLiteral
+    pos += 2;
+    auto scan_res = scan_integer_literal(str, str_len, pos, 16);
+    if (!scan_res.has_value()) goto error;
+    res = double(scan_res.value());
+  } else {
+    DecimalMantissa mantissa;
+    u32 added;
+    u32 int_digits = scan_decimal_digits(str, str_len, pos, mantissa, added);
+    // the digits of the integer part that did not fit count to the exponent.
+    int64_t exp10 = int64_t(int_digits) - added;
+    // a leading zero is only allowed on its own (`0`, `0.5`).
+    if (int_digits > 1 && ch == u'0') goto error;
+
+    u32 frac_digits = 0;
+    if (char_at(pos) == u'.') {
+      pos += 1;
+      frac_digits = scan_decimal_digits(str, str_len, pos, mantissa, added);
+      exp10 -= added;
     }
-    default:  // NonZeroDigit
-      auto scan_res = scan_decimal_literal(str, str_len, pos);
-      UPDATE_CHAR
-      if (!scan_res.has_value()) goto error;
-      int_val = scan_res.value();
-
-      if (ch == u'.') {
-        is_double = true;
-        NEXT_CHAR
-        double_val = (double)int_val + scan_fractional_part(str, str_len, pos);
-        UPDATE_CHAR
-      }
-  }
-
-  if(!is_hex) {  // ExponentPart
+    if (int_digits == 0 && frac_digits == 0) goto error;
 
-    bool neg_exp = false;
+    // ExponentPart
+    ch = char_at(pos);
     if (ch == u'e' || ch == u'E') {
-      NEXT_CHAR
-      if (ch == u'+' || ch == u'-') {
-        neg_exp = ch == u'-';
-        NEXT_CHAR
+      pos += 1;
+      bool neg_exp = false;
+      if (char_at(pos) == u'+' || char_at(pos) == u'-') {
+        neg_exp = char_at(pos) == u'-';
+        pos += 1;
       }
-      auto scan_res = scan_decimal_literal(str, str_len, pos);
-      UPDATE_CHAR
-      if (!scan_res.has_value()) goto error;
-
-      double exp = neg_exp ? -double(scan_res.value()) : double(scan_res.value());
-      if (is_double) {
-        double_val = double_val * std::pow(10, exp);
-      } else {
-        is_double = true;
-        double_val = double(int_val) * std::pow(10, exp);
+      if (!character::is_decimal_digit(char_at(pos))) goto error;
+      int64_t exp = 0;
+      for (; character::is_decimal_digit(char_at(pos)); pos++) {
+        // large enough to overflow or underflow any mantissa.
+        if (exp < 1000000) exp = exp * 10 + (char_at(pos) - u'0');
       }
+      exp10 += neg_exp ? -exp : exp;
+    }
+
+    // Both the mantissa and the power of 10 are exact doubles, so one operation rounds
+    // correctly (Clinger's fast path).
+    static constexpr double exact_powers_of_10[] = {
+      1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+      1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+    };
+    if (mantissa.value == 0 && !mantissa.truncated) {
+      res = 0;
+    } else if (!mantissa.truncated && mantissa.value <= (uint64_t(1) << 53)
+               && exp10 >= -22 && exp10 <= 22) {
+      res = exp10 >= 0 ? double(mantissa.value) * exact_powers_of_10[exp10]
+                       : double(mantissa.value) / exact_powers_of_10[-exp10];
+    } else {
+      res = decimal_to_double_slow(str + start, pos - start);
     }
   }
 
   // The source character immediately following a NumericLiteral must not
   // be an IdentifierStart or DecimalDigit.
+  ch = char_at(pos);
   if (character::is_identifier_start(ch) || character::is_decimal_digit(ch)) {
     goto error;
   }
   cursor = pos;
-  return is_double ? double_val : double(int_val);
+  return res;
 error:
   cursor = pos;
   return std::nullopt;
@@ -0,0 +1,265 @@
+#ifndef NJS_PERF_COUNTERS_H
+#define NJS_PERF_COUNTERS_H
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace njs {
+
+// Counts hardware events with Linux `perf_event_open`, and adds them up by phase.
+//
+// The counters of a thread only count the events in this thread, so each thread opens its own
+// counters the first time it measures a phase. A phase adds up the events of all the threads that
+// measure it, and the phases may be nested in each other.
+//
+// The events that can not be opened (no PMU in a virtual machine, `perf_event_paranoid`, seccomp
+// in a container) are reported as unavailable. If none can be opened, the measuring does nothing.
+class PerfCounters {
+ public:
+  enum Event {
+    CYCLES,
+    INSTRUCTIONS,
+    BRANCH_MISSES,
+    L1D_MISSES,
+    LLC_MISSES,
+    DTLB_MISSES,
+    EVENT_COUNT,
+  };
+
+  struct Counts {
+    uint64_t value[EVENT_COUNT] {};
+
+    Counts& operator += (const Counts& other) {
+      for (int i = 0; i < EVENT_COUNT; i++) value[i] += other.value[i];
+      return *this;
+    }
+  };
+
+  static void start() {
+    enabled = true;
+    phases.clear();
+    // Open the counters of this thread now, so that an error is reported early.
+    if (thread_counters().available_cnt() == 0) {
+      fprintf(stderr, "perf counters are not available: %s\n",
+              open_error.empty() ? "not supported on this platform" : open_error.c_str());
+      enabled = false;
+    }
+  }
+
+  static bool is_enabled() { return enabled; }
+
+  // Read the counters of the current thread.
+  static Counts read() {
+    return thread_counters().read();
+  }
+
+  static void add(const char *phase, const Counts& delta) {
+    std::lock_guard<std::mutex> lock(phase_mutex);
+    for (auto& p : phases) {
+      if (p.name == phase) {
+        p.counts += delta;
+        p.times += 1;
+        return;
+      }
+    }
+    phases.push_back(Phase { phase, delta, 1 });
+  }
+
+  static void report() {
+    static const char *event_names[EVENT_COUNT] = {
+      "cycles", "instructions", "branch-misses", "L1d-misses", "LLC-misses", "dTLB-misses",
+    };
+
+    std::lock_guard<std::mutex> lock(phase_mutex);
+    printf("\nPerf counters\n");
+    printf("%-20s %8s", "phase", "times");
+    for (int i = 0; i < EVENT_COUNT; i++) printf(" %14s", event_names[i]);
+    printf(" %6s %10s %10s\n", "IPC", "L1d-MPKI", "LLC-MPKI");
+
+    for (auto& p : phases) {
+      printf("%-20s %8lu", p.name, p.times);
+      for (int i = 0; i < EVENT_COUNT; i++) {
+        if (event_available[i]) {
+          printf(" %14lu", p.counts.value[i]);
+        } else {
+          printf(" %14s", "n/a");
+        }
+      }
+
+      double kilo_inst = p.counts.value[INSTRUCTIONS] / 1000.0;
+      print_ratio(CYCLES, INSTRUCTIONS, 6, p.counts.value[CYCLES] == 0 ? 0 :
+                  (double)p.counts.value[INSTRUCTIONS] / p.counts.value[CYCLES]);
+      print_ratio(L1D_MISSES, INSTRUCTIONS, 10, kilo_inst == 0 ? 0 :
+                  p.counts.value[L1D_MISSES] / kilo_inst);
+      print_ratio(LLC_MISSES, INSTRUCTIONS, 10, kilo_inst == 0 ? 0 :
+                  p.counts.value[LLC_MISSES] / kilo_inst);
+      printf("\n");
+    }
+  }
+
+ private:
+  struct Phase {
+    const char *name;
+    Counts counts;
+    uint64_t times;
+  };
+
+  class ThreadCounters {
+   public:
+    ThreadCounters() {
+#ifdef __linux__
+      for (int i = 0; i < EVENT_COUNT; i++) {
+        fds[i] = open_event(Event(i));
+      }
+#endif
+    }
+
+    ~ThreadCounters() {
+#ifdef __linux__
+      for (int fd : fds) {
+        if (fd >= 0) close(fd);
+      }
+#endif
+    }
+
+    int available_cnt() {
+      int cnt = 0;
+      for (int fd : fds) cnt += fd >= 0;
+      return cnt;
+    }
+
+    Counts read() {
+      Counts counts;
+#ifdef __linux__
+      for (int i = 0; i < EVENT_COUNT; i++) {
+        if (fds[i] < 0) continue;
+        // value, time enabled, time running
+        uint64_t data[3];
+        if (::read(fds[i], data, sizeof(data)) != sizeof(data)) continue;
+        // scale the value if the counter has been multiplexed with others.
+        counts.value[i] = data[2] == 0 || data[2] == data[1]
+                            ? data[0] : uint64_t((double)data[0] * data[1] / data[2]);
+      }
+#endif
+      return counts;
+    }
+
+   private:
+    int fds[EVENT_COUNT] {-1, -1, -1, -1, -1, -1};
+  };
+
+#ifdef __linux__
+  static int open_event(Event event) {
+    auto cache_miss = [] (uint64_t cache) {
+      return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    };
+
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    switch (event) {
+      case CYCLES:
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = PERF_COUNT_HW_CPU_CYCLES;
+        break;
+      case INSTRUCTIONS:
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+        break;
+      case BRANCH_MISSES:
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+        break;
+      case L1D_MISSES:
+        attr.type = PERF_TYPE_HW_CACHE;
+        attr.config = cache_miss(PERF_COUNT_HW_CACHE_L1D);
+        break;
+      case LLC_MISSES:
+        attr.type = PERF_TYPE_HW_CACHE;
+        attr.config = cache_miss(PERF_COUNT_HW_CACHE_LL);
+        break;
+      case DTLB_MISSES:
+        attr.type = PERF_TYPE_HW_CACHE;
+        attr.config = cache_miss(PERF_COUNT_HW_CACHE_DTLB);
+        break;
+      default:
+        return -1;
+    }
+
+    // this thread, any CPU
+    int fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    int error = errno;
+    std::lock_guard<std::mutex> lock(phase_mutex);
+    if (fd >= 0) {
+      event_available[event] = true;
+    } else if (open_error.empty()) {
+      open_error = strerror(error);
+    }
+    return fd;
+  }
+#endif
+
+  static ThreadCounters& thread_counters() {
+    thread_local ThreadCounters counters;
+    return counters;
+  }
+
+  static void print_ratio(Event a, Event b, int width, double ratio) {
+    if (event_available[a] && event_available[b]) {
+      printf(" %*.2f", width, ratio);
+    } else {
+      printf(" %*s", width, "n/a");
+    }
+  }
+
+  inline static bool enabled {false};
+  inline static bool event_available[EVENT_COUNT] {};
+  inline static std::string open_error;
+
+  inline static std::mutex phase_mutex;
+  inline static std::vector<Phase> phases;
+};
+
+// Adds the events counted in the current thread during the lifetime of this object to a phase.
+// `phase` must be a string literal.
+class PerfScope {
+ public:
+  explicit PerfScope(const char *phase): phase(phase) {
+    if (PerfCounters::is_enabled()) [[unlikely]] {
+      start = PerfCounters::read();
+    }
+  }
+
+  ~PerfScope() {
+    if (PerfCounters::is_enabled()) [[unlikely]] {
+      PerfCounters::Counts delta = PerfCounters::read();
+      for (int i = 0; i < PerfCounters::EVENT_COUNT; i++) {
+        delta.value[i] -= start.value[i];
+      }
+      PerfCounters::add(phase, delta);
+    }
+  }
+
+ private:
+  const char *phase;
+  PerfCounters::Counts start;
+};
+
+} // namespace njs
+
+#endif // NJS_PERF_COUNTERS_H
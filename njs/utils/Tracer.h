@@ -0,0 +1,176 @@
+#ifndef NJS_TRACER_H
+#define NJS_TRACER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace njs {
+
+// Records timestamped events into a ring buffer, and dumps them in the Chrome trace event format
+// (JSON), which can be opened with Perfetto or chrome://tracing. When the buffer is full, the
+// oldest events are overwritten.
+//
+// Recording is lock-free and can be done from any thread. The names and categories of the events
+// must be string literals, since only the pointers are stored.
+class Tracer {
+ public:
+  constexpr static size_t DEFAULT_CAPACITY = 1 << 18;
+
+  static void start(size_t capacity = DEFAULT_CAPACITY) {
+    buffer_capacity = capacity;
+    buffer = std::make_unique<Event[]>(capacity);
+    start_time = std::chrono::steady_clock::now();
+    enabled = true;
+  }
+
+  static bool is_enabled() { return enabled; }
+
+  static int64_t now_us() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start_time).count();
+  }
+
+  // an event with a duration
+  static void complete(const char *cat, const char *name, int64_t start_us,
+                       const char *arg_name = nullptr, int64_t arg = 0) {
+    record('X', cat, name, start_us, now_us() - start_us, arg_name, arg);
+  }
+
+  static void instant(const char *cat, const char *name,
+                      const char *arg_name = nullptr, int64_t arg = 0) {
+    record('i', cat, name, now_us(), 0, arg_name, arg);
+  }
+
+  // Name the current thread in the trace. Only the first name of a thread is kept.
+  static void set_thread_name(const char *name) {
+    if (not enabled) return;
+    uint32_t tid = thread_id();
+    std::lock_guard<std::mutex> lock(thread_name_mutex);
+    for (auto& [named_tid, _] : thread_names) {
+      if (named_tid == tid) return;
+    }
+    thread_names.emplace_back(tid, name);
+  }
+
+  static bool dump(const std::string& path) {
+    std::ofstream out(path);
+    if (not out.is_open()) return false;
+
+    out << "{\"traceEvents\":[\n";
+    out << R"({"name":"process_name","ph":"M","pid":1,"tid":0,"args":{"name":"njs"}})";
+    {
+      std::lock_guard<std::mutex> lock(thread_name_mutex);
+      for (auto& [tid, name] : thread_names) {
+        out << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << tid
+            << ",\"args\":{\"name\":\"" << name << "\"}}";
+      }
+    }
+
+    size_t end = next_event.load();
+    size_t begin = end > buffer_capacity ? end - buffer_capacity : 0;
+    for (size_t i = begin; i < end; i++) {
+      Event& event = buffer[i % buffer_capacity];
+      // not completely written, or already overwritten
+      if (event.seq.load(std::memory_order_acquire) != i + 1) continue;
+
+      out << ",\n{\"name\":\"" << event.name << "\",\"cat\":\"" << event.cat
+          << "\",\"ph\":\"" << event.phase << "\",\"ts\":" << event.ts
+          << ",\"pid\":1,\"tid\":" << event.tid;
+      if (event.phase == 'X') {
+        out << ",\"dur\":" << event.dur;
+      } else {
+        out << ",\"s\":\"t\"";
+      }
+      if (event.arg_name) {
+        out << ",\"args\":{\"" << event.arg_name << "\":" << event.arg << '}';
+      }
+      out << '}';
+    }
+    out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+    return out.good();
+  }
+
+ private:
+  struct Event {
+    // index + 1 of the event stored here, set after the other fields are written.
+    std::atomic<size_t> seq {0};
+    const char *cat;
+    const char *name;
+    const char *arg_name;
+    int64_t arg;
+    int64_t ts;
+    int64_t dur;
+    uint32_t tid;
+    char phase;
+  };
+
+  static void record(char phase, const char *cat, const char *name, int64_t ts, int64_t dur,
+                     const char *arg_name, int64_t arg) {
+    size_t index = next_event.fetch_add(1, std::memory_order_relaxed);
+    Event& event = buffer[index % buffer_capacity];
+    event.seq.store(0, std::memory_order_relaxed);
+    event.cat = cat;
+    event.name = name;
+    event.arg_name = arg_name;
+    event.arg = arg;
+    event.ts = ts;
+    event.dur = dur;
+    event.tid = thread_id();
+    event.phase = phase;
+    event.seq.store(index + 1, std::memory_order_release);
+  }
+
+  static uint32_t thread_id() {
+    thread_local uint32_t tid = next_thread_id.fetch_add(1);
+    return tid;
+  }
+
+  inline static bool enabled {false};
+  inline static std::unique_ptr<Event[]> buffer;
+  inline static size_t buffer_capacity {0};
+  inline static std::atomic<size_t> next_event {0};
+  inline static std::atomic<uint32_t> next_thread_id {1};
+  inline static std::chrono::steady_clock::time_point start_time;
+
+  inline static std::mutex thread_name_mutex;
+  inline static std::vector<std::pair<uint32_t, const char *>> thread_names;
+};
+
+// Records an event covering the lifetime of this object if the tracer is enabled.
+class TraceScope {
+ public:
+  TraceScope(const char *cat, const char *name): cat(cat), name(name) {
+    if (Tracer::is_enabled()) [[unlikely]] {
+      start_us = Tracer::now_us();
+    }
+  }
+
+  ~TraceScope() {
+    if (Tracer::is_enabled()) [[unlikely]] {
+      Tracer::complete(cat, name, start_us, arg_name, arg);
+    }
+  }
+
+  // attach a number to the event
+  void set_arg(const char *arg_name, int64_t arg) {
+    this->arg_name = arg_name;
+    this->arg = arg;
+  }
+
+ private:
+  const char *cat;
+  const char *name;
+  const char *arg_name {nullptr};
+  int64_t arg {0};
+  int64_t start_us {0};
+};
+
+} // namespace njs
+
+#endif // NJS_TRACER_H
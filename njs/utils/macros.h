@@ -22,7 +22,8 @@ using u32 = uint32_t;
 #define gc_write_barrier(x) vm.heap.write_barrier(this, x);
 
 #define gc_check_and_visit_object(res, o) if ((o).needs_gc()) { (res) |= heap.gc_visit_object((o).as_GCObject); }
-#define gc_check_and_mark_object(o) if ((o).needs_gc()) { gc_mark_object((o).as_GCObject); }
+#define gc_check_and_mark_object(o) if ((o).needs_gc()) { gc_mark_object((o).as_GCObject); } \
+                                    else if ((o).holds_atom()) { gc_mark_atom((o).as_atom); }
 #define gc_check_object_young(o) if ((o).needs_gc() && (o).as_GCObject < oldgen_start) { return true; }
 
 #define NOGC NoGC nogc(vm);
@@ -0,0 +1,344 @@
+#ifndef NJS_UTILS_STRING_KERNELS_H
+#define NJS_UTILS_STRING_KERNELS_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define NJS_STRING_KERNELS_X86
+#endif
+
+// Searching, comparing and converting the characters of strings, vectorized.
+//
+// The characters of a one-byte string are `char` (compared as unsigned), and those of a two-byte
+// string are `char16_t`. On x86-64, the kernels are compiled twice from the same source
+// (`string_kernels_impl.h`): once for SSE2, which every x86-64 CPU has, and once for AVX2, which
+// is used if the CPU supports it. Elsewhere they are plain loops.
+//
+// The kernels that the C library already vectorizes (`memchr`, `memcmp`) are left to it.
+
+namespace njs::string_kernels {
+
+constexpr size_t npos = std::string_view::npos;
+
+namespace scalar {
+
+// The value of a character, so that a `char` compares as Latin-1.
+template <typename CharT>
+inline auto unit(CharT ch) {
+  if constexpr (sizeof(CharT) == 1) {
+    return (uint8_t)ch;
+  } else {
+    return (char16_t)ch;
+  }
+}
+
+template <typename CharT>
+inline size_t find_char(const CharT *str, size_t length, CharT ch) {
+  for (size_t i = 0; i < length; i++) {
+    if (str[i] == ch) return i;
+  }
+  return npos;
+}
+
+template <typename CharT>
+inline size_t rfind_char(const CharT *str, size_t length, CharT ch) {
+  for (size_t i = length; i != 0; i--) {
+    if (str[i - 1] == ch) return i - 1;
+  }
+  return npos;
+}
+
+template <typename CharT>
+inline size_t find(const CharT *str, size_t length, const CharT *pattern, size_t pattern_length) {
+  return std::basic_string_view<CharT>(str, length).find(pattern, 0, pattern_length);
+}
+
+template <typename CharT>
+inline size_t rfind(const CharT *str, size_t length, const CharT *pattern, size_t pattern_length) {
+  return std::basic_string_view<CharT>(str, length).rfind(pattern, npos, pattern_length);
+}
+
+template <typename CharA, typename CharB>
+inline size_t mismatch(const CharA *a, const CharB *b, size_t length) {
+  for (size_t i = 0; i < length; i++) {
+    if (unit(a[i]) != unit(b[i])) return i;
+  }
+  return length;
+}
+
+inline bool is_latin1(const char16_t *str, size_t length) {
+  char16_t bits = 0;
+  for (size_t i = 0; i < length; i++) {
+    bits |= str[i];
+  }
+  return bits <= 0xFF;
+}
+
+// The characters must be Latin-1.
+inline void narrow(const char16_t *str, size_t length, char *dest) {
+  for (size_t i = 0; i < length; i++) {
+    dest[i] = char(str[i]);
+  }
+}
+
+inline void widen(const char *str, size_t length, char16_t *dest) {
+  for (size_t i = 0; i < length; i++) {
+    dest[i] = (uint8_t)str[i];
+  }
+}
+
+template <bool UPPER, typename CharT, typename MapChar>
+inline void map_case(const CharT *str, size_t length, CharT *dest, MapChar map_char) {
+  for (size_t i = 0; i < length; i++) {
+    dest[i] = map_char(str[i]);
+  }
+}
+
+} // namespace scalar
+
+#ifdef NJS_STRING_KERNELS_X86
+
+// The operations on 128-bit vectors.
+namespace sse2 {
+
+struct V {
+  using Reg = __m128i;
+  static constexpr size_t BYTES = 16;
+
+  static Reg load(const void *p) { return _mm_loadu_si128((const Reg *)p); }
+  static void store(void *p, Reg v) { _mm_storeu_si128((Reg *)p, v); }
+  static Reg zero() { return _mm_setzero_si128(); }
+  static Reg and_(Reg a, Reg b) { return _mm_and_si128(a, b); }
+  static Reg or_(Reg a, Reg b) { return _mm_or_si128(a, b); }
+  static Reg xor_(Reg a, Reg b) { return _mm_xor_si128(a, b); }
+  // one bit for each byte
+  static uint32_t mask(Reg v) { return (uint32_t)_mm_movemask_epi8(v); }
+
+  template <typename CharT>
+  static Reg splat(CharT ch) {
+    if constexpr (sizeof(CharT) == 1) {
+      return _mm_set1_epi8((char)ch);
+    } else {
+      return _mm_set1_epi16((short)ch);
+    }
+  }
+
+  template <typename CharT>
+  static Reg eq(Reg a, Reg b) {
+    if constexpr (sizeof(CharT) == 1) {
+      return _mm_cmpeq_epi8(a, b);
+    } else {
+      return _mm_cmpeq_epi16(a, b);
+    }
+  }
+
+  // signed
+  template <typename CharT>
+  static Reg gt(Reg a, Reg b) {
+    if constexpr (sizeof(CharT) == 1) {
+      return _mm_cmpgt_epi8(a, b);
+    } else {
+      return _mm_cmpgt_epi16(a, b);
+    }
+  }
+
+  // Load `BYTES / 2` one-byte characters as two-byte ones.
+  static Reg load_widened(const char *p) {
+    return _mm_unpacklo_epi8(_mm_loadl_epi64((const Reg *)p), zero());
+  }
+
+  // Pack two vectors of Latin-1 two-byte characters into one of one-byte characters.
+  static Reg pack(Reg a, Reg b) { return _mm_packus_epi16(a, b); }
+};
+
+#include "njs/utils/string_kernels_impl.h"
+
+} // namespace sse2
+
+// The operations on 256-bit vectors. Everything in this namespace is compiled for AVX2, and must
+// only be called if the CPU supports it.
+#if defined(__clang__)
+#pragma clang attribute push (__attribute__((target("avx2"))), apply_to = function)
+#else
+#pragma GCC push_options
+#pragma GCC target("avx2")
+#endif
+
+namespace avx2 {
+
+struct V {
+  using Reg = __m256i;
+  static constexpr size_t BYTES = 32;
+
+  static Reg load(const void *p) { return _mm256_loadu_si256((const Reg *)p); }
+  static void store(void *p, Reg v) { _mm256_storeu_si256((Reg *)p, v); }
+  static Reg zero() { return _mm256_setzero_si256(); }
+  static Reg and_(Reg a, Reg b) { return _mm256_and_si256(a, b); }
+  static Reg or_(Reg a, Reg b) { return _mm256_or_si256(a, b); }
+  static Reg xor_(Reg a, Reg b) { return _mm256_xor_si256(a, b); }
+  static uint32_t mask(Reg v) { return (uint32_t)_mm256_movemask_epi8(v); }
+
+  template <typename CharT>
+  static Reg splat(CharT ch) {
+    if constexpr (sizeof(CharT) == 1) {
+      return _mm256_set1_epi8((char)ch);
+    } else {
+      return _mm256_set1_epi16((short)ch);
+    }
+  }
+
+  template <typename CharT>
+  static Reg eq(Reg a, Reg b) {
+    if constexpr (sizeof(CharT) == 1) {
+      return _mm256_cmpeq_epi8(a, b);
+    } else {
+      return _mm256_cmpeq_epi16(a, b);
+    }
+  }
+
+  template <typename CharT>
+  static Reg gt(Reg a, Reg b) {
+    if constexpr (sizeof(CharT) == 1) {
+      return _mm256_cmpgt_epi8(a, b);
+    } else {
+      return _mm256_cmpgt_epi16(a, b);
+    }
+  }
+
+  static Reg load_widened(const char *p) {
+    return _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)p));
+  }
+
+  // `packus` packs each 128-bit half separately, so the middle quarters are swapped back.
+  static Reg pack(Reg a, Reg b) {
+    return _mm256_permute4x64_epi64(_mm256_packus_epi16(a, b), 0b11'01'10'00);
+  }
+};
+
+#include "njs/utils/string_kernels_impl.h"
+
+} // namespace avx2
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#else
+#pragma GCC pop_options
+#endif
+
+// Checked once at startup. A kernel that runs before this is initialized uses SSE2.
+inline const bool cpu_has_avx2 = [] {
+  __builtin_cpu_init();
+  return (bool)__builtin_cpu_supports("avx2");
+}();
+
+#define NJS_STRING_KERNEL(call) (cpu_has_avx2 ? avx2::call : sse2::call)
+
+#else
+
+#define NJS_STRING_KERNEL(call) (scalar::call)
+
+#endif // NJS_STRING_KERNELS_X86
+
+// Return the index of the first `ch` in `str`, or `npos`.
+template <typename CharT>
+inline size_t find_char(const CharT *str, size_t length, CharT ch) {
+  if constexpr (sizeof(CharT) == 1) {
+    auto *res = (const CharT *)std::memchr(str, ch, length);
+    return res ? res - str : npos;
+  } else {
+    return NJS_STRING_KERNEL(find_char(str, length, ch));
+  }
+}
+
+// Return the index of the last `ch` in `str`, or `npos`.
+template <typename CharT>
+inline size_t rfind_char(const CharT *str, size_t length, CharT ch) {
+  return NJS_STRING_KERNEL(rfind_char(str, length, ch));
+}
+
+// Return the index of the first occurrence of `pattern` in `str`, or `npos`.
+template <typename CharT>
+inline size_t find(const CharT *str, size_t length, const CharT *pattern, size_t pattern_length) {
+  if (pattern_length > length) return npos;
+  if (pattern_length == 0) return 0;
+  if (pattern_length == 1) return find_char(str, length, pattern[0]);
+  return NJS_STRING_KERNEL(find(str, length, pattern, pattern_length));
+}
+
+// Return the index of the last occurrence of `pattern` in `str`, or `npos`.
+template <typename CharT>
+inline size_t rfind(const CharT *str, size_t length, const CharT *pattern, size_t pattern_length) {
+  if (pattern_length > length) return npos;
+  if (pattern_length == 0) return length;
+  if (pattern_length == 1) return rfind_char(str, length, pattern[0]);
+  return NJS_STRING_KERNEL(rfind(str, length, pattern, pattern_length));
+}
+
+// Return the index of the first character that differs in `a` and `b`, or `length`.
+template <typename CharA, typename CharB>
+inline size_t mismatch(const CharA *a, const CharB *b, size_t length) {
+  if constexpr (sizeof(CharA) > sizeof(CharB)) {
+    return mismatch(b, a, length);
+  } else {
+    return NJS_STRING_KERNEL(mismatch(a, b, length));
+  }
+}
+
+template <typename CharA, typename CharB>
+inline bool equals(const CharA *a, size_t a_length, const CharB *b, size_t b_length) {
+  if (a_length != b_length) return false;
+  if constexpr (sizeof(CharA) == sizeof(CharB)) {
+    return std::memcmp(a, b, a_length * sizeof(CharA)) == 0;
+  } else {
+    return mismatch(a, b, a_length) == a_length;
+  }
+}
+
+// Compare the characters of `a` and `b` lexicographically (as UTF-16 code units).
+template <typename CharA, typename CharB>
+inline int compare(const CharA *a, size_t a_length, const CharB *b, size_t b_length) {
+  size_t length = std::min(a_length, b_length);
+  if constexpr (sizeof(CharA) == 1 && sizeof(CharB) == 1) {
+    // `memcmp` compares the bytes as unsigned.
+    int res = std::memcmp(a, b, length);
+    if (res != 0) return res < 0 ? -1 : 1;
+  } else {
+    size_t i = mismatch(a, b, length);
+    if (i != length) {
+      return scalar::unit(a[i]) < scalar::unit(b[i]) ? -1 : 1;
+    }
+  }
+  return a_length < b_length ? -1 : (a_length > b_length ? 1 : 0);
+}
+
+// Return true if all the characters are Latin-1.
+inline bool is_latin1(const char16_t *str, size_t length) {
+  return NJS_STRING_KERNEL(is_latin1(str, length));
+}
+
+// Copy the characters, which must be Latin-1, to `dest` one byte each.
+inline void narrow(const char16_t *str, size_t length, char *dest) {
+  NJS_STRING_KERNEL(narrow(str, length, dest));
+}
+
+inline void widen(const char *str, size_t length, char16_t *dest) {
+  NJS_STRING_KERNEL(widen(str, length, dest));
+}
+
+// Write the upper (or lower) case of the characters to `dest`. The ASCII characters are mapped
+// by the kernel, and the others by `map_char`, which must also map the ASCII characters.
+template <bool UPPER, typename CharT, typename MapChar>
+inline void map_case(const CharT *str, size_t length, CharT *dest, MapChar map_char) {
+  NJS_STRING_KERNEL(map_case<UPPER>(str, length, dest, map_char));
+}
+
+#undef NJS_STRING_KERNEL
+
+} // namespace njs::string_kernels
+
+#endif // NJS_UTILS_STRING_KERNELS_H
@@ -0,0 +1,190 @@
+// The string kernels for one vector width. This file is included by `string_kernels.h` once for
+// each instruction set, in a namespace that defines `V`, the operations on the vectors of that
+// width. So it has no include guard.
+//
+// The kernels do the whole vectors, and leave the rest to the scalar code, or do it by loading
+// the last vector of the string again (overlapping the previous one) where that is harmless.
+
+// For the two-byte characters, each character sets two bits of `V::mask`. Keep one.
+template <typename CharT>
+inline uint32_t char_bits(uint32_t mask) {
+  if constexpr (sizeof(CharT) == 1) {
+    return mask;
+  } else {
+    return mask & 0x55555555u;
+  }
+}
+
+constexpr uint32_t ALL_BITS = uint32_t((uint64_t(1) << V::BYTES) - 1);
+
+template <typename CharT>
+inline size_t find_char(const CharT *str, size_t length, CharT ch) {
+  constexpr size_t LANES = V::BYTES / sizeof(CharT);
+  if (length < LANES) return scalar::find_char(str, length, ch);
+
+  auto needle = V::template splat<CharT>(ch);
+  auto find_in = [&] (size_t i) {
+    return V::mask(V::template eq<CharT>(V::load(str + i), needle));
+  };
+  for (size_t i = 0; i + LANES <= length; i += LANES) {
+    uint32_t mask = find_in(i);
+    if (mask != 0) return i + __builtin_ctz(mask) / sizeof(CharT);
+  }
+  size_t last = length - LANES;
+  uint32_t mask = find_in(last);
+  return mask != 0 ? last + __builtin_ctz(mask) / sizeof(CharT) : npos;
+}
+
+template <typename CharT>
+inline size_t rfind_char(const CharT *str, size_t length, CharT ch) {
+  constexpr size_t LANES = V::BYTES / sizeof(CharT);
+  if (length < LANES) return scalar::rfind_char(str, length, ch);
+
+  auto needle = V::template splat<CharT>(ch);
+  auto find_in = [&] (size_t i) {
+    return V::mask(V::template eq<CharT>(V::load(str + i), needle));
+  };
+  size_t i = length;
+  for (; i >= LANES; i -= LANES) {
+    uint32_t mask = find_in(i - LANES);
+    if (mask != 0) return i - LANES + (31 - __builtin_clz(mask)) / sizeof(CharT);
+  }
+  uint32_t mask = find_in(0);
+  return mask != 0 ? (31 - __builtin_clz(mask)) / sizeof(CharT) : npos;
+}
+
+// Look for the first and the last character of the pattern `LANES` positions at a time, and
+// compare the rest only where both match. `pattern_length` is at least 2.
+template <typename CharT>
+inline size_t find(const CharT *str, size_t length, const CharT *pattern, size_t pattern_length) {
+  constexpr size_t LANES = V::BYTES / sizeof(CharT);
+  auto first = V::template splat<CharT>(pattern[0]);
+  auto last = V::template splat<CharT>(pattern[pattern_length - 1]);
+  size_t middle_size = (pattern_length - 2) * sizeof(CharT);
+
+  size_t i = 0;
+  for (; i + pattern_length - 1 + LANES <= length; i += LANES) {
+    auto first_eq = V::template eq<CharT>(V::load(str + i), first);
+    auto last_eq = V::template eq<CharT>(V::load(str + i + pattern_length - 1), last);
+    uint32_t mask = char_bits<CharT>(V::mask(V::and_(first_eq, last_eq)));
+    while (mask != 0) {
+      size_t pos = i + __builtin_ctz(mask) / sizeof(CharT);
+      if (std::memcmp(str + pos + 1, pattern + 1, middle_size) == 0) return pos;
+      mask &= mask - 1;
+    }
+  }
+  size_t res = scalar::find(str + i, length - i, pattern, pattern_length);
+  return res == npos ? npos : i + res;
+}
+
+template <typename CharT>
+inline size_t rfind(const CharT *str, size_t length, const CharT *pattern, size_t pattern_length) {
+  constexpr size_t LANES = V::BYTES / sizeof(CharT);
+  auto first = V::template splat<CharT>(pattern[0]);
+  auto last = V::template splat<CharT>(pattern[pattern_length - 1]);
+  size_t middle_size = (pattern_length - 2) * sizeof(CharT);
+
+  // the number of positions where the pattern may start, that are not searched yet.
+  size_t i = length - pattern_length + 1;
+  for (; i >= LANES; i -= LANES) {
+    size_t start = i - LANES;
+    auto first_eq = V::template eq<CharT>(V::load(str + start), first);
+    auto last_eq = V::template eq<CharT>(V::load(str + start + pattern_length - 1), last);
+    uint32_t mask = char_bits<CharT>(V::mask(V::and_(first_eq, last_eq)));
+    while (mask != 0) {
+      uint32_t bit = 31 - __builtin_clz(mask);
+      size_t pos = start + bit / sizeof(CharT);
+      if (std::memcmp(str + pos + 1, pattern + 1, middle_size) == 0) return pos;
+      mask &= ~(uint32_t(1) << bit);
+    }
+  }
+  return scalar::rfind(str, i + pattern_length - 1, pattern, pattern_length);
+}
+
+// `a` may be one-byte when `b` is two-byte, not the other way round.
+template <typename CharA, typename CharB>
+inline size_t mismatch(const CharA *a, const CharB *b, size_t length) {
+  constexpr size_t LANES = V::BYTES / sizeof(CharB);
+  if (length < LANES) return scalar::mismatch(a, b, length);
+
+  auto eq_mask = [&] (size_t i) {
+    if constexpr (sizeof(CharA) == sizeof(CharB)) {
+      return V::mask(V::template eq<CharB>(V::load(a + i), V::load(b + i)));
+    } else {
+      return V::mask(V::template eq<CharB>(V::load_widened(a + i), V::load(b + i)));
+    }
+  };
+  for (size_t i = 0; i + LANES <= length; i += LANES) {
+    uint32_t mask = eq_mask(i);
+    if (mask != ALL_BITS) return i + __builtin_ctz(~mask) / sizeof(CharB);
+  }
+  size_t last = length - LANES;
+  uint32_t mask = eq_mask(last);
+  return mask != ALL_BITS ? last + __builtin_ctz(~mask) / sizeof(CharB) : length;
+}
+
+inline bool is_latin1(const char16_t *str, size_t length) {
+  constexpr size_t LANES = V::BYTES / sizeof(char16_t);
+  if (length < LANES) return scalar::is_latin1(str, length);
+
+  auto bits = V::zero();
+  for (size_t i = 0; i + LANES <= length; i += LANES) {
+    bits = V::or_(bits, V::load(str + i));
+  }
+  bits = V::or_(bits, V::load(str + length - LANES));
+  auto high_bytes = V::and_(bits, V::template splat<char16_t>(0xFF00));
+  return V::mask(V::template eq<char16_t>(high_bytes, V::zero())) == ALL_BITS;
+}
+
+inline void narrow(const char16_t *str, size_t length, char *dest) {
+  constexpr size_t LANES = V::BYTES;
+  if (length < LANES) return scalar::narrow(str, length, dest);
+
+  auto narrow_at = [&] (size_t i) {
+    V::store(dest + i, V::pack(V::load(str + i), V::load(str + i + LANES / 2)));
+  };
+  for (size_t i = 0; i + LANES <= length; i += LANES) {
+    narrow_at(i);
+  }
+  narrow_at(length - LANES);
+}
+
+inline void widen(const char *str, size_t length, char16_t *dest) {
+  constexpr size_t LANES = V::BYTES / sizeof(char16_t);
+  if (length < LANES) return scalar::widen(str, length, dest);
+
+  for (size_t i = 0; i + LANES <= length; i += LANES) {
+    V::store(dest + i, V::load_widened(str + i));
+  }
+  V::store(dest + length - LANES, V::load_widened(str + length - LANES));
+}
+
+// A vector of ASCII characters is mapped by flipping the case bit of the letters, and any other
+// vector by `map_char`. `str` and `dest` may be the same.
+template <bool UPPER, typename CharT, typename MapChar>
+inline void map_case(const CharT *str, size_t length, CharT *dest, MapChar map_char) {
+  constexpr size_t LANES = V::BYTES / sizeof(CharT);
+  // the values of the ASCII characters are positive when compared as signed.
+  auto above = V::template splat<CharT>(UPPER ? 'a' - 1 : 'A' - 1);
+  auto below = V::template splat<CharT>(UPPER ? 'z' + 1 : 'Z' + 1);
+  auto case_bit = V::template splat<CharT>(0x20);
+  auto non_ascii_bits = V::template splat<CharT>(sizeof(CharT) == 1 ? 0x80 : 0xFF80);
+
+  size_t i = 0;
+  for (; i + LANES <= length; i += LANES) {
+    auto chars = V::load(str + i);
+    auto non_ascii = V::and_(chars, non_ascii_bits);
+    if (V::mask(V::template eq<CharT>(non_ascii, V::zero())) != ALL_BITS) {
+      for (size_t j = i; j < i + LANES; j++) {
+        dest[j] = map_char(str[j]);
+      }
+      continue;
+    }
+    auto is_letter = V::and_(V::template gt<CharT>(chars, above),
+                             V::template gt<CharT>(below, chars));
+    V::store(dest + i, V::xor_(chars, V::and_(is_letter, case_bit)));
+  }
+  for (; i < length; i++) {
+    dest[i] = map_char(str[i]);
+  }
+}
@@ -0,0 +1,181 @@
+#include "CpuProfiler.h"
+
+#include <csignal>
+#include <chrono>
+#include <fstream>
+#include <sys/time.h>
+
+#include "NjsVM.h"
+#include "JSStackFrame.h"
+#include "njs/basic_types/JSFunction.h"
+#include "njs/common/conversion_helper.h"
+
+namespace njs {
+
+namespace {
+
+int64_t now_us() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+}
+
+void CpuProfiler::on_signal(int) {
+  pending.store(true, std::memory_order_relaxed);
+}
+
+void CpuProfiler::start(u32 interval_us) {
+  nodes.clear();
+  node_index.clear();
+  samples.clear();
+  time_deltas.clear();
+  nodes.push_back(Node { .meta = nullptr, .name = u"(root)", .line = 0, .is_native = false,
+                         .parent = 0 });
+  start_time = last_sample_time = now_us();
+
+  struct sigaction action {};
+  action.sa_handler = on_signal;
+  action.sa_flags = SA_RESTART;
+  sigemptyset(&action.sa_mask);
+  sigaction(SIGPROF, &action, nullptr);
+
+  // ITIMER_PROF counts the CPU time of the process, so no samples are taken while waiting in the
+  // run loop. The kernel checks it on the scheduler ticks, so the interval is at least one tick.
+  struct itimerval timer {};
+  timer.it_interval.tv_sec = interval_us / 1000000;
+  timer.it_interval.tv_usec = interval_us % 1000000;
+  timer.it_value = timer.it_interval;
+  setitimer(ITIMER_PROF, &timer, nullptr);
+  running = true;
+}
+
+void CpuProfiler::stop() {
+  if (not running) return;
+  struct itimerval timer {};
+  setitimer(ITIMER_PROF, &timer, nullptr);
+  signal(SIGPROF, SIG_IGN);
+  pending.store(false, std::memory_order_relaxed);
+  end_time = now_us();
+  running = false;
+}
+
+u32 CpuProfiler::child_of(u32 parent, JSFunctionMeta *meta) {
+  auto [iter, inserted] = node_index.emplace(std::make_pair(parent, meta), nodes.size());
+  if (inserted) {
+    nodes[parent].children.push_back(nodes.size());
+    nodes.push_back(Node { .meta = meta, .line = meta->source_line,
+                           .is_native = (bool)meta->is_native, .parent = parent });
+  }
+  return iter->second;
+}
+
+void CpuProfiler::take_sample() {
+  pending.store(false, std::memory_order_relaxed);
+
+  stack.clear();
+  for (JSStackFrame *frame = vm.curr_frame; frame != nullptr; frame = frame->prev_frame) {
+    JSFunction *func = frame->function.as_func;
+    stack.emplace_back(func->meta, func->name);
+  }
+
+  u32 node = 0;
+  for (auto iter = stack.rbegin(); iter != stack.rend(); ++iter) {
+    auto [meta, name] = *iter;
+    node = child_of(node, meta);
+    if (nodes[node].name.empty()) {
+      if (meta == &vm.global_meta) {
+        nodes[node].name = u"(global)";
+      } else if (meta->is_anonymous || name.empty()) {
+        nodes[node].name = u"(anonymous)";
+      } else {
+        nodes[node].name = name;
+      }
+    }
+  }
+
+  nodes[node].hit_cnt += 1;
+  int64_t time = now_us();
+  samples.push_back(node);
+  time_deltas.push_back(time - last_sample_time);
+  last_sample_time = time;
+}
+
+std::string CpuProfiler::frame_name(const Node& node) {
+  std::string name = to_u8string(node.name);
+  if (node.is_native) {
+    name += " (native)";
+  } else if (node.meta != &vm.global_meta) {
+    name += ':' + std::to_string(node.line);
+  }
+  return name;
+}
+
+bool CpuProfiler::write(const std::string& path) {
+  std::string_view suffix = ".cpuprofile";
+  if (path.size() >= suffix.size() && path.ends_with(suffix)) {
+    return write_cpuprofile(path);
+  } else {
+    return write_folded(path);
+  }
+}
+
+bool CpuProfiler::write_folded(const std::string& path) {
+  std::ofstream out(path);
+  if (not out.is_open()) return false;
+
+  // one line for each node that has hits: the names from the root, then the count.
+  vector<std::string> prefix(nodes.size());
+  for (u32 i = 1; i < nodes.size(); i++) {
+    // a parent is always added before its children.
+    u32 parent = nodes[i].parent;
+    prefix[i] = parent == 0 ? frame_name(nodes[i]) : prefix[parent] + ';' + frame_name(nodes[i]);
+    if (nodes[i].hit_cnt != 0) {
+      out << prefix[i] << ' ' << nodes[i].hit_cnt << '\n';
+    }
+  }
+  return out.good();
+}
+
+bool CpuProfiler::write_cpuprofile(const std::string& path) {
+  std::ofstream out(path);
+  if (not out.is_open()) return false;
+
+  // The ids of the nodes start from 1. The line numbers of the call frames start from 0.
+  out << "{\"nodes\":[";
+  for (u32 i = 0; i < nodes.size(); i++) {
+    Node& node = nodes[i];
+    std::string name = to_u8string(to_escaped_u16string(node.name));
+    if (node.is_native) name += " (native)";
+    int line = i == 0 || node.meta == &vm.global_meta ? -1 : int(node.line) - 1;
+
+    if (i != 0) out << ",\n";
+    out << "{\"id\":" << (i + 1) << ",\"callFrame\":{\"functionName\":\"" << name
+        << "\",\"scriptId\":\"0\",\"url\":\"\",\"lineNumber\":" << line
+        << ",\"columnNumber\":-1},\"hitCount\":" << node.hit_cnt;
+    if (not node.children.empty()) {
+      out << ",\"children\":[";
+      for (u32 j = 0; j < node.children.size(); j++) {
+        if (j != 0) out << ',';
+        out << (node.children[j] + 1);
+      }
+      out << ']';
+    }
+    out << '}';
+  }
+
+  out << "],\n\"startTime\":" << start_time << ",\"endTime\":" << end_time << ",\n\"samples\":[";
+  for (u32 i = 0; i < samples.size(); i++) {
+    if (i != 0) out << ',';
+    out << (samples[i] + 1);
+  }
+  out << "],\n\"timeDeltas\":[";
+  for (u32 i = 0; i < time_deltas.size(); i++) {
+    if (i != 0) out << ',';
+    out << time_deltas[i];
+  }
+  out << "]}\n";
+  return out.good();
+}
+
+} // namespace njs
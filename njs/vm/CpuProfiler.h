@@ -0,0 +1,83 @@
+#ifndef NJS_CPU_PROFILER_H
+#define NJS_CPU_PROFILER_H
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace njs {
+
+class NjsVM;
+struct JSFunctionMeta;
+
+using u32 = uint32_t;
+using std::u16string;
+using std::u16string_view;
+using std::vector;
+
+// A sampling profiler for the JavaScript functions.
+//
+// A `SIGPROF` timer only sets a flag, and the interpreter takes the sample the next time it
+// checks the flag: when a function is called or a native function returns, and when a loop jumps
+// back. So nothing is done in the signal handler, and the cost of a check is a load and a branch.
+//
+// A sample walks the stack frames like `NjsVM::capture_stack_trace`, and counts a hit at the
+// leaf of the call tree. The tree is written as folded stacks (for flamegraph.pl), or in the
+// .cpuprofile format of Chrome DevTools if the file name ends with ".cpuprofile".
+class CpuProfiler {
+ public:
+  explicit CpuProfiler(NjsVM& vm): vm(vm) {}
+
+  void start(u32 interval_us);
+  void stop();
+
+  static bool sample_pending() { return pending.load(std::memory_order_relaxed); }
+  void take_sample();
+
+  // Return false if the file can not be written.
+  bool write(const std::string& path);
+
+ private:
+  struct Node {
+    JSFunctionMeta *meta;
+    u16string name;
+    u32 line;
+    bool is_native;
+    u32 parent;
+    u32 hit_cnt {0};
+    vector<u32> children;
+  };
+
+  static void on_signal(int);
+
+  u32 child_of(u32 parent, JSFunctionMeta *meta);
+  std::string frame_name(const Node& node);
+  bool write_folded(const std::string& path);
+  bool write_cpuprofile(const std::string& path);
+
+  inline static std::atomic<bool> pending {false};
+
+  NjsVM& vm;
+  bool running {false};
+
+  // node 0 is the root
+  vector<Node> nodes;
+  // (parent, function) -> node
+  std::map<std::pair<u32, JSFunctionMeta *>, u32> node_index;
+  // the functions on the stack of the current sample, from the innermost one.
+  vector<std::pair<JSFunctionMeta *, u16string_view>> stack;
+
+  // the leaf node of each sample, and the time since the previous sample.
+  vector<u32> samples;
+  vector<int64_t> time_deltas;
+  int64_t start_time {0};
+  int64_t last_sample_time {0};
+  int64_t end_time {0};
+};
+
+} // namespace njs
+
+#endif // NJS_CPU_PROFILER_H
@@ -0,0 +1,164 @@
+#include "FuncProfiler.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <map>
+
+#include "NjsVM.h"
+#include "njs/basic_types/JSFunction.h"
+#include "njs/common/conversion_helper.h"
+
+namespace njs {
+
+namespace {
+
+constexpr size_t REPORT_ENTRY_CNT = 20;
+
+}
+
+void FuncProfiler::start() {
+  inst_counts.assign(vm.bytecode.size(), 0);
+  funcs.clear();
+  call_stack.clear();
+  lines.clear();
+}
+
+FuncProfiler::FuncStats& FuncProfiler::stats_of(JSFunctionMeta *meta, JSFunction *func) {
+  auto [iter, inserted] = funcs.try_emplace(meta);
+  FuncStats& stats = iter->second;
+  if (inserted) {
+    if (meta == &vm.global_meta) {
+      stats.name = u"(global)";
+    } else if (meta->is_anonymous) {
+      stats.name = u"(anonymous)";
+    } else if (func != nullptr) {
+      stats.name = func->name;
+    } else {
+      stats.name = vm.atom_to_str(meta->name_index);
+    }
+    stats.line = meta->source_line;
+    stats.is_native = meta->is_native;
+  }
+  return stats;
+}
+
+void FuncProfiler::enter(JSFunction *func) {
+  FuncStats& stats = stats_of(func->meta, func);
+  stats.call_cnt += 1;
+  stats.active_cnt += 1;
+  call_stack.push_back(Activation { .stats = &stats, .start_ns = now_ns(), .callee_ns = 0 });
+}
+
+void FuncProfiler::exit() {
+  Activation act = call_stack.back();
+  call_stack.pop_back();
+
+  int64_t elapsed = now_ns() - act.start_ns;
+  act.stats->self_ns += elapsed - act.callee_ns;
+  act.stats->active_cnt -= 1;
+  if (act.stats->active_cnt == 0) {
+    act.stats->total_ns += elapsed;
+  }
+  if (not call_stack.empty()) {
+    call_stack.back().callee_ns += elapsed;
+  }
+}
+
+void FuncProfiler::aggregate() {
+  if (not lines.empty()) return;
+
+  // The bytecode of the inner functions is nested in that of the outer ones, so the narrower
+  // ranges overwrite the wider ones.
+  vector<JSFunctionMeta *> metas;
+  for (auto& meta : vm.func_meta) {
+    if (not meta->is_native) metas.push_back(meta.get());
+  }
+  std::sort(metas.begin(), metas.end(), [] (JSFunctionMeta *a, JSFunctionMeta *b) {
+    return a->bytecode_end - a->bytecode_start > b->bytecode_end - b->bytecode_start;
+  });
+  vector<JSFunctionMeta *> owner(inst_counts.size(), &vm.global_meta);
+  for (JSFunctionMeta *meta : metas) {
+    std::fill(owner.begin() + meta->bytecode_start, owner.begin() + meta->bytecode_end, meta);
+  }
+
+  std::map<std::pair<JSFunctionMeta *, u32>, u64> line_counts;
+  for (u32 pc = 0; pc < inst_counts.size(); pc++) {
+    if (inst_counts[pc] == 0) continue;
+    stats_of(owner[pc], nullptr).inst_cnt += inst_counts[pc];
+    line_counts[{owner[pc], vm.bytecode_line[pc]}] += inst_counts[pc];
+  }
+
+  for (auto& [key, count] : line_counts) {
+    lines.push_back(LineStats { .meta = key.first, .line = key.second, .inst_cnt = count });
+  }
+  std::sort(lines.begin(), lines.end(), [] (const LineStats& a, const LineStats& b) {
+    return a.inst_cnt > b.inst_cnt;
+  });
+}
+
+void FuncProfiler::report() {
+  aggregate();
+
+  vector<FuncStats *> sorted;
+  u64 total_inst = 0;
+  for (auto& [_, stats] : funcs) {
+    sorted.push_back(&stats);
+    total_inst += stats.inst_cnt;
+  }
+  std::sort(sorted.begin(), sorted.end(), [] (FuncStats *a, FuncStats *b) {
+    return a->self_ns > b->self_ns;
+  });
+
+  printf("\nFunction profile (by self time)\n");
+  printf("%30s %6s %12s %14s %12s %12s\n",
+         "function", "line", "calls", "instructions", "self ms", "total ms");
+  for (size_t i = 0; i < std::min(sorted.size(), REPORT_ENTRY_CNT); i++) {
+    FuncStats& stats = *sorted[i];
+    std::string name = to_u8string(stats.name) + (stats.is_native ? " (native)" : "");
+    printf("%30s %6u %12lu %14lu %12.3f %12.3f\n", name.c_str(), stats.line, stats.call_cnt,
+           stats.inst_cnt, stats.self_ns / 1e6, stats.total_ns / 1e6);
+  }
+
+  printf("\nLine profile (by instructions)\n");
+  printf("%30s %6s %14s %10s\n", "function", "line", "instructions", "percent");
+  for (size_t i = 0; i < std::min(lines.size(), REPORT_ENTRY_CNT); i++) {
+    LineStats& line = lines[i];
+    std::string name = to_u8string(funcs[line.meta].name);
+    printf("%30s %6u %14lu %9.2f%%\n", name.c_str(), line.line, line.inst_cnt,
+           100 * (double)line.inst_cnt / total_inst);
+  }
+}
+
+bool FuncProfiler::write_json(const std::string& path) {
+  std::ofstream out(path);
+  if (not out.is_open()) return false;
+  aggregate();
+
+  auto json_str = [] (const u16string& str) {
+    return '"' + to_u8string(to_escaped_u16string(str)) + '"';
+  };
+
+  out << "{\"functions\":[";
+  bool first = true;
+  for (auto& [_, stats] : funcs) {
+    if (not first) out << ",\n";
+    first = false;
+    out << "{\"name\":" << json_str(stats.name) << ",\"line\":" << stats.line
+        << ",\"native\":" << (stats.is_native ? "true" : "false")
+        << ",\"calls\":" << stats.call_cnt << ",\"instructions\":" << stats.inst_cnt
+        << ",\"self_ns\":" << stats.self_ns << ",\"total_ns\":" << stats.total_ns << '}';
+  }
+
+  out << "],\n\"lines\":[";
+  for (size_t i = 0; i < lines.size(); i++) {
+    if (i != 0) out << ",\n";
+    out << "{\"function\":" << json_str(funcs[lines[i].meta].name)
+        << ",\"function_line\":" << lines[i].meta->source_line
+        << ",\"line\":" << lines[i].line << ",\"instructions\":" << lines[i].inst_cnt << '}';
+  }
+  out << "]}\n";
+  return out.good();
+}
+
+} // namespace njs
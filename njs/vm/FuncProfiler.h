@@ -0,0 +1,100 @@
+#ifndef NJS_FUNC_PROFILER_H
+#define NJS_FUNC_PROFILER_H
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace njs {
+
+class NjsVM;
+class JSFunction;
+struct JSFunctionMeta;
+
+using u32 = uint32_t;
+using u64 = uint64_t;
+using std::u16string;
+using std::vector;
+
+// Counts the instructions executed at each pc, and the calls and the time spent in each function.
+// Only the `njs_profile` build (with `FUNC_PROFILE` defined) calls it from the interpreter loop.
+//
+// The instructions are attributed to the innermost function whose bytecode contains them, and to
+// their source lines. The total time of a recursive function is only counted for the outermost
+// call. Each resumption of a generator or an async function counts as a call.
+class FuncProfiler {
+ public:
+  explicit FuncProfiler(NjsVM& vm): vm(vm) {}
+
+  void start();
+
+  void count_inst(u32 pc) { inst_counts[pc] += 1; }
+
+  void enter(JSFunction *func);
+  void exit();
+
+  // Records a call for its lifetime.
+  class CallScope {
+   public:
+    CallScope(FuncProfiler& profiler, JSFunction *func): profiler(profiler) {
+      profiler.enter(func);
+    }
+    ~CallScope() { profiler.exit(); }
+
+   private:
+    FuncProfiler& profiler;
+  };
+
+  // Print the hottest functions and lines to stdout.
+  void report();
+  // Return false if the file can not be written.
+  bool write_json(const std::string& path);
+
+ private:
+  struct FuncStats {
+    u16string name;
+    u32 line;
+    bool is_native;
+    u64 call_cnt {0};
+    u64 inst_cnt {0};
+    int64_t self_ns {0};
+    int64_t total_ns {0};
+    // number of the calls of this function on the stack
+    u32 active_cnt {0};
+  };
+
+  struct LineStats {
+    JSFunctionMeta *meta;
+    u32 line;
+    u64 inst_cnt;
+  };
+
+  struct Activation {
+    FuncStats *stats;
+    int64_t start_ns;
+    int64_t callee_ns;
+  };
+
+  static int64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
+  FuncStats& stats_of(JSFunctionMeta *meta, JSFunction *func);
+  // Add the instruction counts to the functions and the lines.
+  void aggregate();
+
+  NjsVM& vm;
+
+  vector<u64> inst_counts;
+  std::unordered_map<JSFunctionMeta *, FuncStats> funcs;
+  vector<Activation> call_stack;
+  vector<LineStats> lines;
+};
+
+} // namespace njs
+
+#endif // NJS_FUNC_PROFILER_H
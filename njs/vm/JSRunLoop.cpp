@@ -12,6 +12,7 @@
 #include <vector>
 #include <thread>
 #include "NjsVM.h"
+#include "njs/utils/Tracer.h"
 
 namespace njs {
 
@@ -54,7 +55,11 @@ void JSRunLoop::loop() {
     // the task is canceled.
     if (task == nullptr) continue;
 
-    if (!task->canceled) vm.execute_task(*task);
+    if (!task->canceled) {
+      TraceScope trace("runloop", task->is_timer ? "timer task" : "macrotask");
+      trace.set_arg("task_id", task->task_id);
+      vm.execute_task(*task);
+    }
     if (!task->repeat) task_pool.erase(task->task_id);
   }
 }
@@ -104,6 +109,7 @@ void JSRunLoop::setup_pipe() {
 }
 
 void JSRunLoop::timer_loop() {
+  Tracer::set_thread_name("timer");
   const int MAX_EVENTS = 20;
 
 #ifdef __APPLE__
@@ -124,6 +130,9 @@ void JSRunLoop::timer_loop() {
           EV_SET(&event, task->task_id, EVFILT_TIMER, EV_DELETE, 0, 0, nullptr);
           kevent(mux_fd, &event, 1, nullptr, 0, nullptr);
         }
+        if (Tracer::is_enabled()) {
+          Tracer::instant("runloop", "timer fired", "task_id", task->task_id);
+        }
         exec_task(task);
       }
       else if (event_slot[i].filter == EVFILT_READ && event_slot[i].ident == pipe_read_fd) {
@@ -155,6 +164,9 @@ void JSRunLoop::timer_loop() {
           if (!task->repeat) {
             epoll_ctl(mux_fd, EPOLL_CTL_DEL, timer_fd, NULL);
           }
+          if (Tracer::is_enabled()) {
+            Tracer::instant("runloop", "timer fired", "task_id", task->task_id);
+          }
         }
         exec_task(task);
       }
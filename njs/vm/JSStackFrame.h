@@ -38,7 +38,11 @@ struct JSStackFrame {
     frame.args_buf += addr_diff;
     frame.local_vars += addr_diff;
     frame.stack += addr_diff;
-    frame.sp += addr_diff;
+    // The frame lives on after the function returns, so keep `sp` and `pc` in the frame itself.
+    frame.sp = *sp_ref + addr_diff;
+    frame.pc = *pc_ref;
+    frame.sp_ref = &frame.sp;
+    frame.pc_ref = &frame.pc;
     
     return &frame;
   }
@@ -1,5 +1,6 @@
 #include "NjsVM.h"
 
+#include <bit>
 #include <iostream>
 #include <iterator>
 #include <random>
@@ -7,6 +8,7 @@
 #include "njs/common/Completion.h"
 #include "njs/basic_types/JSValue.h"
 #include "njs/utils/helper.h"
+#include "njs/utils/Tracer.h"
 #include "njs/include/libregexp/cutils.h"
 #include "njs/global_var.h"
 #include "njs/common/common_def.h"
@@ -79,12 +81,14 @@ JSValue prepare_arguments_array(NjsVM& vm, ArgRef args) {
 NjsVM::NjsVM(CodegenVisitor& visitor)
   : heap(1600, *this)
   , bytecode(std::move(visitor.bytecode))
+  , bytecode_line(std::move(visitor.bytecode_line))
   , runloop(*this)
   , atom_pool(std::move(visitor.atom_pool))
   , num_list(std::move(visitor.num_list))
   , func_meta(std::move(visitor.func_meta))
   , random_engine(std::random_device{}())
 {
+  heap.init_alloc_sites(visitor.alloc_site_count);
   init_prototypes();
   JSObject *global_obj = new_object();
   global_object.set_val(global_obj);
@@ -98,7 +102,7 @@ NjsVM::NjsVM(CodegenVisitor& visitor)
     }
   }
 
-  global_meta.name_index = atom_pool.atomize(u"(global)");
+  global_meta.name_index = AtomPool::k_global_code;
   global_meta.is_strict = global_scope.is_strict;
   global_meta.local_var_count = global_scope.get_var_count();
   global_meta.stack_size = global_scope.get_max_stack_size() + 1;
@@ -169,15 +173,74 @@ JSValue NjsVM::new_primitive_string(char16_t ch) {
 }
 
 JSValue NjsVM::new_primitive_string_ref(u16string_view str) {
-  return JSValue(heap.new_prim_string_ref(str));
+  bool latin1 = PrimitiveString::is_latin1(str.data(), str.size());
+  return JSValue(heap.new_prim_string_ref(str, latin1));
+}
+
+JSValue NjsVM::number_to_string(double num) {
+  if (num >= 0 && num < int_string_cache.size() && num == u32(num)) {
+    return int_string_cache[u32(num)];
+  }
+  auto bits = std::bit_cast<uint64_t>(num);
+  auto& entry = num_string_cache[(bits * 0x9E3779B97F4A7C15u) >> 58];
+  static_assert(NUM_STRING_CACHE_SIZE == 64);
+  if (entry.bits == bits && entry.str.is_prim_string()) {
+    return entry.str;
+  }
+
+  char buf[DOUBLE_TO_CHARS_MAX];
+  size_t len = double_to_chars(num, buf);
+  PrimitiveString *str = heap.new_one_byte_string(buf, len);
+  str->disallow_reuse();
+  entry = {bits, JSValue(str)};
+  return entry.str;
+}
+
+u32 NjsVM::str_to_atom(PrimitiveString *str) {
+  if (str->get_atom() != PrimitiveString::NO_ATOM) [[likely]] {
+    PrimitiveString::atom_hit_count += 1;
+    return str->get_atom();
+  }
+  u32 atom = str->is_one_byte() ? atom_pool.atomize_latin1(str->latin1_view())
+                                : atom_pool.atomize(str->view());
+  str->set_atom(atom);
+  return atom;
+}
+
+void NjsVM::sweep_atoms() {
+  atom_pool.sweep([this] (u32 atom) {
+    if (not regexp_bytecode.empty()) regexp_bytecode.erase(atom);
+  });
 }
 
 void NjsVM::run() {
   memset(inst_counter, 0, sizeof(inst_counter));
+  if (Global::cpu_profile_path != nullptr) {
+    cpu_profiler.start(Global::cpu_profile_interval_us);
+  }
+#ifdef FUNC_PROFILE
+  func_profiler.start();
+#endif
   execute_global();
   execute_pending_task();
   runloop.loop();
 
+  if (Global::cpu_profile_path != nullptr) {
+    cpu_profiler.stop();
+    if (not cpu_profiler.write(Global::cpu_profile_path)) {
+      fprintf(stderr, "failed to write the CPU profile to %s\n", Global::cpu_profile_path);
+    }
+  }
+
+#ifdef FUNC_PROFILE
+  func_profiler.report();
+  if (Global::func_profile_path != nullptr) {
+    if (not func_profiler.write_json(Global::func_profile_path)) {
+      fprintf(stderr, "failed to write the function profile to %s\n", Global::func_profile_path);
+    }
+  }
+#endif
+
   if (Global::show_log_buffer && !log_buffer.empty()) {
     std::cout << "------------------------------" << '\n';
     std::cout << "log:" << '\n';
@@ -186,6 +249,12 @@ void NjsVM::run() {
     }
   }
 
+  if (Global::heap_snapshot_path != nullptr) {
+    if (not heap.write_heap_snapshot(Global::heap_snapshot_path)) {
+      fprintf(stderr, "failed to write the heap snapshot to %s\n", Global::heap_snapshot_path);
+    }
+  }
+
   show_stats();
 }
 
@@ -209,7 +278,14 @@ Completion NjsVM::call_internal(JSValueRef callee, JSValueRef This, JSValueRef n
       &&case_default,
   };
 
+#ifdef FUNC_PROFILE
+#define COUNT_INST(pc) func_profiler.count_inst(pc)
+#else
+#define COUNT_INST(pc)
+#endif
+
 #define Switch(pc) {                                                                      \
+  COUNT_INST(pc);                                                                         \
   inst = bytecode[(pc)++];                                                                \
   int op_index = static_cast<int>(inst.op_type);                                          \
   goto *dispatch_table[op_index];                                                         \
@@ -226,6 +302,7 @@ Completion NjsVM::call_internal(JSValueRef callee, JSValueRef This, JSValueRef n
 // }
 
 #define Break {                                                                           \
+  COUNT_INST(pc);                                                                         \
   inst = bytecode[(pc)++];                                                                \
   int op_index = static_cast<int>(inst.op_type);                                          \
   goto *dispatch_table[op_index];                                                         \
@@ -260,6 +337,10 @@ Completion NjsVM::call_internal(JSValueRef callee, JSValueRef This, JSValueRef n
     printf("*** call function: %s\n", to_u8string(this_func->name).c_str());
   }
 
+#ifdef FUNC_PROFILE
+  FuncProfiler::CallScope profile_scope(func_profiler, function);
+#endif
+
   // setup call stack
   JSStackFrame _frame;
   JSStackFrame& frame = likely(state == nullptr) ? _frame : state->stack_frame;
@@ -273,6 +354,7 @@ Completion NjsVM::call_internal(JSValueRef callee, JSValueRef This, JSValueRef n
     JSValueRef this_arg = unlikely(has_new_target) ? new_target : This;
     Completion comp = function->native_func(*this, callee, this_arg, argv, flags);
 
+    if (CpuProfiler::sample_pending()) [[unlikely]] cpu_profiler.take_sample();
     curr_frame = frame.prev_frame;
     return comp;
   }
@@ -345,6 +427,8 @@ Completion NjsVM::call_internal(JSValueRef callee, JSValueRef This, JSValueRef n
     }
   }
 
+  if (CpuProfiler::sample_pending()) [[unlikely]] cpu_profiler.take_sample();
+
   auto get_value = [&, this](ScopeType scope, int index) -> JSValue& {
     switch (scope) {
       case ScopeType::GLOBAL: {
@@ -417,12 +501,14 @@ Completion NjsVM::call_internal(JSValueRef callee, JSValueRef This, JSValueRef n
           l.as_f64 += r.as_f64;
         }
         else if (l.is_prim_string() && r.is_prim_string()) {
+          heap.alloc_site = opr1;
           auto *res = l.as_prim_string->concat(heap, r.as_prim_string);
+          heap.alloc_site = 0;
           l.set_val(res);
         }
         else {
           bool succeeded;
-          exec_add_common(sp, l, l, r, succeeded);
+          exec_add_common(sp, l, l, r, succeeded, opr1);
         }
         Break;
       }
@@ -599,7 +685,10 @@ Completion NjsVM::call_internal(JSValueRef callee, JSValueRef This, JSValueRef n
       Case(push_str):
         sp += 1;
         if (atom_is_str_sym(opr1)) [[likely]] {
-          sp[0].set_val(heap.new_prim_string_ref(atom_pool.get_string(opr1)));
+          PrimitiveString *str = heap.new_prim_string_ref(atom_pool.get_string(opr1),
+                                                          atom_pool.is_latin1(opr1));
+          str->set_atom(opr1);
+          sp[0].set_val(str);
         } else {
           sp[0] = new_primitive_string(atom_to_str(opr1));
         }
@@ -708,6 +797,8 @@ Completion NjsVM::call_internal(JSValueRef callee, JSValueRef This, JSValueRef n
         }
         Break;
       Case(jmp):
+        // the back-edges of the loops are `jmp`s, so a long loop is sampled too.
+        if (CpuProfiler::sample_pending()) [[unlikely]] cpu_profiler.take_sample();
         pc = opr1;
         Break;
       Case(jmp_true):
@@ -829,17 +920,20 @@ Completion NjsVM::call_internal(JSValueRef callee, JSValueRef This, JSValueRef n
         sp -= 1;
         Break;
       Case(js_new):
-        exec_js_new(sp, opr1);
+        exec_js_new(sp, opr1, opr2);
         Break;
       Case(make_func): {
+        heap.alloc_site = opr2;
         exec_make_func(sp, opr1, This);
+        heap.alloc_site = 0;
         // capture
         int i = 0;
         for (auto& [var_scope, var_idx] : sp[0].as_func->meta->capture_list) {
           if (var_scope == ScopeType::CLOSURE) [[unlikely]] {
             JSValue& closure_val = this_func->get_captured_var()[var_idx];
-            vm_write_barrier(sp[0].as_func->captured_var.as_heap_array, closure_val);
-            sp[0].as_func->get_captured_var()[i] = closure_val;
+            JSValue& slot = sp[0].as_func->get_captured_var()[i];
+            heap.write_barrier(sp[0].as_func->captured_var.as_heap_array, &slot, closure_val);
+            slot = closure_val;
           }
           else {
             JSValue* stack_val;
@@ -856,8 +950,9 @@ Completion NjsVM::call_internal(JSValueRef callee, JSValueRef This, JSValueRef n
             if (stack_val->tag != JSValue::HEAP_VAL) {
               stack_val->move_to_heap(*this);
             }
-            vm_write_barrier(sp[0].as_func->captured_var.as_heap_array, *stack_val);
-            sp[0].as_func->get_captured_var()[i] = *stack_val;
+            JSValue& slot = sp[0].as_func->get_captured_var()[i];
+            heap.write_barrier(sp[0].as_func->captured_var.as_heap_array, &slot, *stack_val);
+            slot = *stack_val;
           }
           i += 1;
         }
@@ -865,11 +960,15 @@ Completion NjsVM::call_internal(JSValueRef callee, JSValueRef This, JSValueRef n
       }
       Case(make_obj):
         sp += 1;
+        heap.alloc_site = opr1;
         sp[0].set_val(new_object());
+        heap.alloc_site = 0;
         Break;
       Case(make_array):
         sp += 1;
+        heap.alloc_site = opr2;
         sp[0].set_val(heap.new_object<JSArray>(*this, opr1));
+        heap.alloc_site = 0;
         Break;
       Case(add_props):
         exec_add_props(sp, opr1);
@@ -1183,7 +1282,10 @@ void NjsVM::execute_single_task(JSTask& task) {
 void NjsVM::execute_pending_task() {
   while (!micro_task_queue.empty()) {
     JSTask& micro_task = micro_task_queue.front();
-    if (!micro_task.canceled) execute_single_task(micro_task);
+    if (!micro_task.canceled) {
+      TraceScope trace("runloop", "microtask");
+      execute_single_task(micro_task);
+    }
     micro_task_queue.pop_front();
   }
 }
@@ -1254,10 +1356,10 @@ u16string NjsVM::build_trace_str(bool remove_top) {
 
 JSValue NjsVM::build_error(JSErrorType type, u16string_view msg) {
   auto *err_obj = new_object(CLS_ERROR, native_error_protos[type]);
-  err_obj->set_prop(*this, u"message", new_primitive_string(msg));
+  err_obj->set_prop(*this, JSAtom(AtomPool::k_message), new_primitive_string(msg));
 
   u16string trace_str = build_trace_str();
-  err_obj->set_prop(*this, u"stack", new_primitive_string(trace_str));
+  err_obj->set_prop(*this, JSAtom(AtomPool::k_stack), new_primitive_string(trace_str));
 
   return JSValue(err_obj);
 }
@@ -1347,7 +1449,8 @@ void NjsVM::exec_regexp_build(SPRef sp, u32 atom, int reflags) {
   }
 }
 
-void NjsVM::exec_add_common(SPRef sp, JSValue& dest, JSValue& l, JSValue& r, bool& succeeded) {
+void NjsVM::exec_add_common(SPRef sp, JSValue& dest, JSValue& l, JSValue& r, bool& succeeded,
+                             u16 alloc_site) {
   succeeded = false;
   JSValue lhs = VM_TRY_COMP(js_to_primitive(*this, l));
   JSValue rhs = VM_TRY_COMP(js_to_primitive(*this, r));
@@ -1355,7 +1458,9 @@ void NjsVM::exec_add_common(SPRef sp, JSValue& dest, JSValue& l, JSValue& r, boo
   if (lhs.is_prim_string() || rhs.is_prim_string()) {
     JSValue lhs_s = VM_TRY_COMP(js_to_string(*this, lhs));
     JSValue rhs_s = VM_TRY_COMP(js_to_string(*this, rhs));
+    heap.alloc_site = alloc_site;
     auto *new_str = lhs_s.as_prim_string->concat(heap, rhs_s.as_prim_string);
+    heap.alloc_site = 0;
     dest.set_val(new_str);
   } else {
     double lhs_n = VM_TRY_ERR(js_to_number(*this, lhs));
@@ -1542,7 +1647,7 @@ void NjsVM::exec_make_func(SPRef sp, int meta_idx, JSValue env_this) {
   sp[0].set_val(func);
 }
 
-void NjsVM::exec_js_new(SPRef sp, int argc) {
+void NjsVM::exec_js_new(SPRef sp, int argc, u16 alloc_site) {
 
   if (not sp[-argc].is_function()) [[unlikely]] {
     u16string msg(js_op_typeof(*this, sp[-argc]).as_prim_string->view());
@@ -1574,7 +1679,9 @@ void NjsVM::exec_js_new(SPRef sp, int argc) {
   } else {
     JSValue proto = VM_TRY_COMP(ctor.as_func->get_prop(*this, AtomPool::k_prototype));
     proto = proto.is_object() ? proto : object_prototype;
+    heap.alloc_site = alloc_site;
     auto *this_obj = heap.new_object<JSObject>(*this, CLS_OBJECT, proto);
+    heap.alloc_site = 0;
 
     This.set_val(this_obj);
   }
@@ -1925,8 +2032,8 @@ void NjsVM::print_unhandled_error(JSValue err) {
   if (err.is_object() && object_class(err) == CLS_ERROR) {
     auto err_obj = err.as_object;
     // TODO: should not use `get_prop_trivial` here
-    std::string err_msg = err_obj->get_prop_trivial(str_to_atom(u"message")).to_string(*this);
-    std::string stack = err_obj->get_prop_trivial(str_to_atom(u"stack")).to_string(*this);
+    std::string err_msg = err_obj->get_prop_trivial(AtomPool::k_message).to_string(*this);
+    std::string stack = err_obj->get_prop_trivial(AtomPool::k_stack).to_string(*this);
     printf("\033[31mUnhandled error: %s, at\n", err_msg.c_str());
     printf("%s\033[0m\n", stack.c_str());
   }
@@ -1945,9 +2052,16 @@ void NjsVM::show_stats() {
     std::cout << "After concat length total: " << PrimitiveString::concat_length << '\n';
     std::cout << "String append count: " << PrimitiveString::append_count << '\n';
     std::cout << "String fast append count: " << PrimitiveString::fast_append_count << '\n';
+    std::cout << "String rope count: " << PrimitiveString::rope_count << '\n';
+    std::cout << "String rope flatten count: " << PrimitiveString::flatten_count << '\n';
+    std::cout << "String slice count: " << PrimitiveString::slice_count << '\n';
+    std::cout << "String one-byte count: " << PrimitiveString::one_byte_count << '\n';
+    std::cout << "String widen count: " << PrimitiveString::widen_count << '\n';
+    std::cout << "String atom hit count: " << PrimitiveString::atom_hit_count << '\n';
 
     std::cout << "string atomize count: " << atom_pool.stats.atomize_str_count << '\n';
     std::cout << "string static atomize count: " << atom_pool.stats.static_atomize_str_count << '\n';
+    std::cout << "freed atom count: " << atom_pool.stats.freed_atom_count << '\n';
   }
 
   if (Global::show_vm_stats) {
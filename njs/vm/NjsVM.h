@@ -1,12 +1,15 @@
 #ifndef NJS_NJSVM_H
 #define NJS_NJSVM_H
 
+#include <array>
 #include <cstdint>
 #include <memory>
 #include <deque>
 #include <vector>
 
 #include "JSRunLoop.h"
+#include "CpuProfiler.h"
+#include "FuncProfiler.h"
 #include "native.h"
 #include "Instruction.h"
 #include "njs/gc/GCHeap.h"
@@ -47,6 +50,9 @@ class NjsVM {
 friend struct JSValue;
 friend class JSRunLoop;
 friend class GCHeap;
+friend class HeapProfiler;
+friend class CpuProfiler;
+friend class FuncProfiler;
 friend class JSBoolean;
 friend class JSNumber;
 friend class JSString;
@@ -78,8 +84,9 @@ friend struct native::Math;
   ~NjsVM();
 
   JSFunction* add_native_func_impl(u16string_view name, NativeFuncType func);
-  JSObject* add_builtin_object(const u16string& name);
-  void add_builtin_global_var(const u16string& name, JSValue val);
+  JSFunction* add_native_func_impl(u32 name_atom, NativeFuncType func);
+  JSObject* add_builtin_object(u32 name_atom);
+  void add_builtin_global_var(u32 name_atom, JSValue val);
 
   void setup();
   void run();
@@ -125,6 +132,10 @@ friend struct native::Math;
     return atom_pool.atomize(str_view);
   }
 
+  u32 str_to_atom(PrimitiveString *str);
+  // Free the atoms left unmarked by the major GC, and the regexp bytecode compiled for them.
+  void sweep_atoms();
+
   u32 str_to_atom_no_uint(u16string_view str_view) {
     return atom_pool.atomize_no_uint(str_view);
   }
@@ -144,7 +155,9 @@ friend struct native::Math;
   /// warning: do NOT keep the returned view for long. It will be invalidated at the next call.
   u16string_view atom_to_str(u32 atom) {
     if (atom_is_int(atom)) [[unlikely]] {
-      temp_int_atom_string = to_u16string(atom_get_int(atom));
+      u32 num = atom_get_int(atom);
+      if (num < int_string_cache.size()) return int_string_view(num);
+      temp_int_atom_string = to_u16string(num);
       return temp_int_atom_string;
     } else {
       return atom_pool.get_string(atom);
@@ -155,6 +168,17 @@ friend struct native::Math;
     return string_const[index];
   }
 
+  // Number::toString. The strings of the small integers are preallocated, and those of the
+  // recently converted numbers are reused until the next GC. Either may be shared.
+  JSValue u32_to_string(u32 num) {
+    if (num < int_string_cache.size()) [[likely]] {
+      return int_string_cache[num];
+    }
+    return number_to_string(num);
+  }
+
+  JSValue number_to_string(double num);
+
   bool terminated_with_throw() {
     return last_task_threw;
   }
@@ -165,9 +189,10 @@ friend struct native::Math;
 
   template<JSErrorType type>
   void add_error_ctor() {
+    static_assert(AtomPool::k_AggregateError - AtomPool::k_Error == JS_AGGREGATE_ERROR - JS_ERROR);
     JSFunction *func = add_native_func_impl(
         // name
-        native_error_name[type],
+        AtomPool::k_Error + (type - JS_ERROR),
         // function
         [] (vm_func_This_args_flags) {
           return native::ctor::error_ctor_internal(vm, args, type);
@@ -193,7 +218,7 @@ friend struct native::Math;
 
   // function operation
   void exec_make_func(SPRef sp, int meta_idx, JSValue env_this);
-  void exec_js_new(SPRef sp, int arg_count);
+  void exec_js_new(SPRef sp, int arg_count, u16 alloc_site);
   // object operation
   void exec_add_props(SPRef sp, int props_cnt);
   void exec_get_prop_atom(SPRef sp, u32 key_atom, int keep_obj);
@@ -207,7 +232,8 @@ friend struct native::Math;
   // binary operation
   void exec_comparison(SPRef sp, OpType type);
 
-  void exec_add_common(SPRef sp, JSValue& dest, JSValue& lhs, JSValue& rhs, bool& succeeded);
+  void exec_add_common(SPRef sp, JSValue& dest, JSValue& lhs, JSValue& rhs, bool& succeeded,
+                       u16 alloc_site = 0);
   void exec_add_assign(SPRef sp, JSValue& target, bool keep_value);
   void exec_binary(SPRef sp, OpType op_type);
   void exec_bits(SPRef sp, OpType op_type);
@@ -234,6 +260,11 @@ friend struct native::Math;
   void print_unhandled_error(JSValue err);
 
   void init_prototypes();
+  void init_int_string_cache();
+  u16string_view int_string_view(u32 num) {
+    u32 offset = int_string_offsets[num];
+    return u16string_view(int_string_chars).substr(offset, int_string_offsets[num + 1] - offset);
+  }
   void show_stats();
 
   // currently see the global scope as a big, outermost function.
@@ -245,7 +276,12 @@ friend struct native::Math;
   JSStackFrame *curr_frame {nullptr};
   JSStackFrame *global_frame {nullptr};
 
+  CpuProfiler cpu_profiler {*this};
+  FuncProfiler func_profiler {*this};
+
   vector<Instruction> bytecode;
+  // the source line of each instruction
+  vector<u32> bytecode_line;
   JSRunLoop runloop;
   deque<JSTask> micro_task_queue;
 
@@ -280,6 +316,19 @@ friend struct native::Math;
   JSValue generator_function_ctor;
 
   vector<JSValue> string_const;
+  // the strings of the integers below `Global::int_string_cache_size`, which refer to their
+  // characters in `int_string_chars`.
+  vector<JSValue> int_string_cache;
+  u16string int_string_chars;
+  vector<u32> int_string_offsets;
+  // A direct-mapped cache from the bits of a number to its string. It is cleared at each GC, so
+  // that it neither keeps the strings alive nor refers to the moved ones.
+  struct NumStringCacheEntry {
+    uint64_t bits;
+    JSValue str;
+  };
+  static constexpr size_t NUM_STRING_CACHE_SIZE = 64;
+  std::array<NumStringCacheEntry, NUM_STRING_CACHE_SIZE> num_string_cache {};
   unordered_flat_map<u32, REByteCode> regexp_bytecode;
   u16string temp_int_atom_string;
   std::mt19937 random_engine;
@@ -2,6 +2,7 @@
 
 #include "native.h"
 #include "njs/common/common_def.h"
+#include "njs/global_var.h"
 #include "njs/basic_types/JSNumberPrototype.h"
 #include "njs/basic_types/JSBooleanPrototype.h"
 #include "njs/basic_types/JSStringPrototype.h"
@@ -64,19 +65,20 @@ void NjsVM::init_prototypes() {
 
 
 void NjsVM::setup() {
-  add_native_func_impl(u"log", native::misc::debug_log);
-  add_native_func_impl(u"___trap", native::misc::debug_trap);
-  add_native_func_impl(u"___dummy", native::misc::dummy);
-  add_native_func_impl(u"___test", native::misc::_test);
-  add_native_func_impl(u"$gc", native::misc::js_gc);
-  add_native_func_impl(u"setTimeout", native::misc::setTimeout);
-  add_native_func_impl(u"setInterval", native::misc::setInterval);
-  add_native_func_impl(u"clearTimeout", native::misc::clearTimeout);
-  add_native_func_impl(u"clearInterval", native::misc::clearInterval);
-  add_native_func_impl(u"fetch", native::misc::fetch);
-  add_native_func_impl(u"isFinite", native::misc::isFinite);
-  add_native_func_impl(u"parseFloat", native::misc::parseFloat);
-  add_native_func_impl(u"parseInt", native::misc::parseInt);
+  add_native_func_impl(AtomPool::k_log, native::misc::debug_log);
+  add_native_func_impl(AtomPool::k____trap, native::misc::debug_trap);
+  add_native_func_impl(AtomPool::k____dummy, native::misc::dummy);
+  add_native_func_impl(AtomPool::k____test, native::misc::_test);
+  add_native_func_impl(AtomPool::k__gc, native::misc::js_gc);
+  add_native_func_impl(AtomPool::k__heapSnapshot, native::misc::heap_snapshot);
+  add_native_func_impl(AtomPool::k_setTimeout, native::misc::setTimeout);
+  add_native_func_impl(AtomPool::k_setInterval, native::misc::setInterval);
+  add_native_func_impl(AtomPool::k_clearTimeout, native::misc::clearTimeout);
+  add_native_func_impl(AtomPool::k_clearInterval, native::misc::clearInterval);
+  add_native_func_impl(AtomPool::k_fetch, native::misc::fetch);
+  add_native_func_impl(AtomPool::k_isFinite, native::misc::isFinite);
+  add_native_func_impl(AtomPool::k_parseFloat, native::misc::parseFloat);
+  add_native_func_impl(AtomPool::k_parseInt, native::misc::parseInt);
 
   add_error_ctor<JS_ERROR>();
   add_error_ctor<JS_EVAL_ERROR>();
@@ -89,31 +91,31 @@ void NjsVM::setup() {
   add_error_ctor<JS_AGGREGATE_ERROR>();
 
   {
-    JSFunction *func = add_native_func_impl(u"Object", native::ctor::Object);
+    JSFunction *func = add_native_func_impl(AtomPool::k_Object, native::ctor::Object);
     object_prototype.as_object->add_prop_trivial(*this, AtomPool::k_constructor, JSValue(func));
     func->add_prop_trivial(*this, AtomPool::k_prototype, object_prototype);
-    func->add_method(*this, u"defineProperty", native::Object::defineProperty);
-    func->add_method(*this, u"hasOwn", native::Object::hasOwn);
-    func->add_method(*this, u"getPrototypeOf", native::Object::getPrototypeOf);
-    func->add_method(*this, u"setPrototypeOf", native::Object::setPrototypeOf);
-    func->add_method(*this, u"preventExtensions", native::Object::preventExtensions);
-    func->add_method(*this, u"isExtensible", native::Object::isExtensible);
-    func->add_method(*this, u"create", native::Object::create);
-    func->add_method(*this, u"assign", native::Object::assign);
+    func->add_method(*this, AtomPool::k_defineProperty, native::Object::defineProperty);
+    func->add_method(*this, AtomPool::k_hasOwn, native::Object::hasOwn);
+    func->add_method(*this, AtomPool::k_getPrototypeOf, native::Object::getPrototypeOf);
+    func->add_method(*this, AtomPool::k_setPrototypeOf, native::Object::setPrototypeOf);
+    func->add_method(*this, AtomPool::k_preventExtensions, native::Object::preventExtensions);
+    func->add_method(*this, AtomPool::k_isExtensible, native::Object::isExtensible);
+    func->add_method(*this, AtomPool::k_create, native::Object::create);
+    func->add_method(*this, AtomPool::k_assign, native::Object::assign);
   }
 
   {
-    JSFunction *func = add_native_func_impl(u"Number", native::ctor::Number);
+    JSFunction *func = add_native_func_impl(AtomPool::k_Number, native::ctor::Number);
     number_prototype.as_object->add_prop_trivial(*this, AtomPool::k_constructor, JSValue(func));
     func->add_prop_trivial(*this, AtomPool::k_prototype, number_prototype);
-    func->add_method(*this, u"isFinite", native::misc::isFinite);
+    func->add_method(*this, AtomPool::k_isFinite, native::misc::isFinite);
   }
 
   {
-    JSFunction *func = add_native_func_impl(u"String", native::ctor::String);
+    JSFunction *func = add_native_func_impl(AtomPool::k_String, native::ctor::String);
     string_prototype.as_object->add_prop_trivial(*this, AtomPool::k_constructor, JSValue(func));
     func->add_prop_trivial(*this, AtomPool::k_prototype, string_prototype);
-    func->add_method(*this, u"fromCharCode", [] (vm_func_This_args_flags) -> Completion {
+    func->add_method(*this, AtomPool::k_fromCharCode, [] (vm_func_This_args_flags) -> Completion {
       assert(args.size() == 1);
       char16_t code = TRY_COMP(js_to_uint16(vm, args[0]));
       return JSValue(vm.new_primitive_string(code));
@@ -121,25 +123,25 @@ void NjsVM::setup() {
   }
 
   {
-    JSFunction *func = add_native_func_impl(u"Array", native::ctor::Array);
+    JSFunction *func = add_native_func_impl(AtomPool::k_Array, native::ctor::Array);
     array_prototype.as_object->add_prop_trivial(*this, AtomPool::k_constructor, JSValue(func));
     func->add_prop_trivial(*this, AtomPool::k_prototype, array_prototype);
   }
 
   {
-    JSFunction *func = add_native_func_impl(u"Date", native::ctor::Date);
+    JSFunction *func = add_native_func_impl(AtomPool::k_Date, native::ctor::Date);
     date_prototype.as_object->add_prop_trivial(*this, AtomPool::k_constructor, JSValue(func));
     func->add_prop_trivial(*this, AtomPool::k_prototype, date_prototype);
   }
 
   {
-    JSFunction *func = add_native_func_impl(u"RegExp", native::ctor::RegExp);
+    JSFunction *func = add_native_func_impl(AtomPool::k_RegExp, native::ctor::RegExp);
     regexp_prototype.as_object->add_prop_trivial(*this, AtomPool::k_constructor, JSValue(func));
     func->add_prop_trivial(*this, AtomPool::k_prototype, regexp_prototype);
   }
 
   {
-    JSFunction *func = add_native_func_impl(u"Symbol", native::ctor::Symbol);
+    JSFunction *func = add_native_func_impl(AtomPool::k_Symbol, native::ctor::Symbol);
     func->add_prop_trivial(*this, AtomPool::k_iterator, JSSymbol(AtomPool::k_sym_iterator));
     func->add_prop_trivial(*this, AtomPool::k_match, JSSymbol(AtomPool::k_sym_match));
     func->add_prop_trivial(*this, AtomPool::k_matchAll, JSSymbol(AtomPool::k_sym_matchAll));
@@ -149,13 +151,13 @@ void NjsVM::setup() {
   }
 
   {
-    JSFunction *func = add_native_func_impl(u"Function", native::ctor::Function);
+    JSFunction *func = add_native_func_impl(AtomPool::k_Function, native::ctor::Function);
     function_prototype.as_object->add_prop_trivial(*this, AtomPool::k_constructor, JSValue(func));
     func->add_prop_trivial(*this, AtomPool::k_prototype, function_prototype);
   }
 
   {
-    JSFunction *func = add_native_func_impl(u"Promise", native::ctor::Promise);
+    JSFunction *func = add_native_func_impl(AtomPool::k_Promise, native::ctor::Promise);
     promise_prototype.as_object->add_prop_trivial(*this, AtomPool::k_constructor, JSValue(func));
     func->add_prop_trivial(*this, AtomPool::k_prototype, promise_prototype);
   }
@@ -172,32 +174,32 @@ void NjsVM::setup() {
   }
 
   {
-    JSObject *obj = add_builtin_object(u"console");
-    obj->add_method(*this, u"log", native::misc::log);
+    JSObject *obj = add_builtin_object(AtomPool::k_console);
+    obj->add_method(*this, AtomPool::k_log, native::misc::log);
   }
 
   {
-    JSObject *obj = add_builtin_object(u"Math");
-    obj->add_method(*this, u"min", native::Math::min);
-    obj->add_method(*this, u"max", native::Math::max);
-    obj->add_method(*this, u"floor", native::Math::floor);
-    obj->add_method(*this, u"random", native::Math::random);
+    JSObject *obj = add_builtin_object(AtomPool::k_Math);
+    obj->add_method(*this, AtomPool::k_min, native::Math::min);
+    obj->add_method(*this, AtomPool::k_max, native::Math::max);
+    obj->add_method(*this, AtomPool::k_floor, native::Math::floor);
+    obj->add_method(*this, AtomPool::k_random, native::Math::random);
   }
 
   {
-    JSObject *obj = add_builtin_object(u"JSON");
-    obj->add_method(*this, u"stringify", native::misc::json_stringify);
-    obj->add_method(*this, u"parse", native::misc::json_parse);
+    JSObject *obj = add_builtin_object(AtomPool::k_JSON);
+    obj->add_method(*this, AtomPool::k_stringify, native::misc::json_stringify);
+    obj->add_method(*this, AtomPool::k_parse, native::misc::json_parse);
   }
 
-  add_builtin_global_var(u"undefined", JSValue());
-  add_builtin_global_var(u"NaN", JSValue(NAN));
-  add_builtin_global_var(u"Infinity", JSValue(1.0 / 0.0));
+  add_builtin_global_var(AtomPool::k_undefined, JSValue());
+  add_builtin_global_var(AtomPool::k_NaN, JSValue(NAN));
+  add_builtin_global_var(AtomPool::k_Infinity, JSValue(1.0 / 0.0));
 
   JSPromise::add_internal_function_meta(*this);
   JSFunction::add_internal_function_meta(*this);
 
-  string_const.resize(11);
+  string_const.resize(AtomPool::k_function + 1);
   string_const[AtomPool::k_] = new_primitive_string_ref(atom_to_str(AtomPool::k_));
   string_const[AtomPool::k_undefined] = new_primitive_string_ref(atom_to_str(AtomPool::k_undefined));
   string_const[AtomPool::k_null] = new_primitive_string_ref(atom_to_str(AtomPool::k_null));
@@ -209,11 +211,37 @@ void NjsVM::setup() {
   string_const[AtomPool::k_object] = new_primitive_string_ref(atom_to_str(AtomPool::k_object));
   string_const[AtomPool::k_symbol] = new_primitive_string_ref(atom_to_str(AtomPool::k_symbol));
   string_const[AtomPool::k_function] = new_primitive_string_ref(atom_to_str(AtomPool::k_function));
+  init_int_string_cache();
+
+  // the names of the builtins are held by their function metas, so they are never freed.
+  atom_pool.record_static_atom_count();
+}
+
+void NjsVM::init_int_string_cache() {
+  u32 count = std::min<u32>(Global::int_string_cache_size, ATOM_INT_MAX);
+  int_string_offsets.reserve(count + 1);
+  for (u32 i = 0; i < count; i++) {
+    int_string_offsets.push_back(int_string_chars.size());
+    int_string_chars += to_u16string(i);
+  }
+  int_string_offsets.push_back(int_string_chars.size());
+
+  // the strings refer to `int_string_chars`, which is not changed from here on.
+  int_string_cache.reserve(count);
+  for (u32 i = 0; i < count; i++) {
+    JSValue str = new_primitive_string_ref(int_string_view(i));
+    str.as_prim_string->set_atom(ATOM_INT_TAG | i);
+    int_string_cache.push_back(str);
+  }
 }
 
 JSFunction* NjsVM::add_native_func_impl(u16string_view name, NativeFuncType native_func) {
+  return add_native_func_impl(str_to_atom(name), native_func);
+}
+
+JSFunction* NjsVM::add_native_func_impl(u32 name_atom, NativeFuncType native_func) {
   auto *meta = new JSFunctionMeta {
-      .name_index = str_to_atom(name),
+      .name_index = name_atom,
       .is_native = true,
       .param_count = 0,
       .local_var_count = 0,
@@ -221,22 +249,20 @@ JSFunction* NjsVM::add_native_func_impl(u16string_view name, NativeFuncType nati
   };
   func_meta.emplace_back(meta);
 
-  auto *func = heap.new_object<JSFunction>(*this, name, meta);
+  auto *func = heap.new_object<JSFunction>(*this, atom_to_str(name_atom), meta);
   func->set_proto(*this, function_prototype);
   global_object.as_object->add_prop_trivial(*this, meta->name_index, JSValue(func));
   return func;
 }
 
-JSObject* NjsVM::add_builtin_object(const u16string& name) {
-  u32 atom = str_to_atom(name);
+JSObject* NjsVM::add_builtin_object(u32 name_atom) {
   JSObject *obj = new_object();
-  global_object.as_object->add_prop_trivial(*this, atom, JSValue(obj));
+  global_object.as_object->add_prop_trivial(*this, name_atom, JSValue(obj));
   return obj;
 }
 
-void NjsVM::add_builtin_global_var(const u16string& name, JSValue val) {
-  u32 atom = str_to_atom(name);
-  global_object.as_object->add_prop_trivial(*this, atom, val);
+void NjsVM::add_builtin_global_var(u32 name_atom, JSValue val) {
+  global_object.as_object->add_prop_trivial(*this, name_atom, val);
 }
 
 
@@ -106,7 +106,7 @@ Completion ctor::Date(vm_func_This_args_flags) {
 }
 
 Completion ctor::Function(vm_func_This_args_flags) {
-  u32 key = vm.str_to_atom(u"___dummy");
+  u32 key = AtomPool::k____dummy;
   return vm.global_object.as_object->get_prop_trivial(key);
 }
 
@@ -132,11 +132,11 @@ Completion ctor::error_ctor_internal(NjsVM& vm, ArgRef args, JSErrorType type) {
   if (!args.empty() && args[0].is_string_type()) {
     // only supports primitive string now.
     assert(args[0].is_prim_string());
-    err_obj->set_prop(vm, u"message", args[0]);
+    err_obj->set_prop(vm, JSAtom(AtomPool::k_message), args[0]);
   }
 
   u16string trace_str = vm.build_trace_str(true);
-  err_obj->set_prop(vm, u"stack", vm.new_primitive_string(trace_str));
+  err_obj->set_prop(vm, JSAtom(AtomPool::k_stack), vm.new_primitive_string(trace_str));
 
   return JSValue(err_obj);
 }
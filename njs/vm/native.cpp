@@ -5,6 +5,7 @@
 #include "JSONParser.h"
 #include "njs/basic_types/conversion.h"
 #include "njs/include/httplib.h"
+#include "njs/utils/Tracer.h"
 
 namespace njs::native {
 
@@ -63,6 +64,17 @@ Completion misc::js_gc(vm_func_This_args_flags) {
   return undefined;
 }
 
+Completion misc::heap_snapshot(vm_func_This_args_flags) {
+  if (args.empty() || not args[0].is_prim_string()) {
+    return vm.throw_error(JS_TYPE_ERROR, u"The first argument must be a file path");
+  }
+  string path = to_u8string(args[0].as_prim_string->view());
+  if (not vm.heap.write_heap_snapshot(path)) {
+    return vm.throw_error(JS_ERROR, u"Failed to write the heap snapshot");
+  }
+  return undefined;
+}
+
 Completion misc::set_timer(NjsVM&vm, ArgRef args, bool repeat) {
   if (args.empty() || not args[0].is_function()) {
     return vm.throw_error(JS_TYPE_ERROR, u"The first argument must be a function");
@@ -128,6 +140,9 @@ Completion misc::fetch(vm_func_This_args_flags) {
   JSTask *task = vm.runloop.register_task(args[1].as_func);
 
   vm.runloop.get_thread_pool().push_task([&vm, task] (const std::string& url) {
+    Tracer::set_thread_name("fetch");
+    TraceScope trace("io", "fetch");
+    trace.set_arg("task_id", task->task_id);
     std::string host, path;
     separate_host_and_path(url, host, path);
 
@@ -185,7 +200,7 @@ Completion misc::isFinite(vm_func_This_args_flags) {
 Completion misc::parseFloat(vm_func_This_args_flags) {
   if (args.empty()) return JSValue(NAN);
   PrimitiveString *str = TRYCC(js_to_string(vm, args[0])).as_prim_string;
-  double val = parse_double(str->view());
+  double val = str->to_number();
 
   return JSValue(val);
 }
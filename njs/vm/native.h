@@ -20,6 +20,7 @@ struct misc {
   static Completion dummy(vm_func_This_args_flags);
   static Completion _test(vm_func_This_args_flags);
   static Completion js_gc(vm_func_This_args_flags);
+  static Completion heap_snapshot(vm_func_This_args_flags);
   static Completion setTimeout(vm_func_This_args_flags);
   static Completion setInterval(vm_func_This_args_flags);
   static Completion clearInterval(vm_func_This_args_flags);